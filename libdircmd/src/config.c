@@ -52,12 +52,66 @@ typedef struct _configEntry
 	char *configName;
 	char *configValue;
 	bool saveInFile;
+	bool haveInt;
+	bool boolValue;
+	int intValue;
 }
 CONFIG_ENTRY;
 
 static void *configQueue = NULL;
+static void *configHash = NULL;
 static bool fileLoaded = false;
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C O N F I G  C R E A T E                                                                                          *
+ *  ========================                                                                                          *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Create the queue that keeps the entries in order and the hash to find them by name.
+ *  \result True if both were created.
+ */
+static bool configCreate (void)
+{
+	if ((configQueue = queueCreate ()) == NULL)
+		return false;
+
+	if ((configHash = hashCreate ()) == NULL)
+	{
+		queueDelete (configQueue);
+		configQueue = NULL;
+		return false;
+	}
+	return true;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C O N F I G  P A R S E                                                                                            *
+ *  ======================                                                                                            *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Work out the number and true or false a value stands for when it is set, so they are not read each get.
+ *  \param configEntry Entry with a new value.
+ *  \result None.
+ */
+static void configParse (CONFIG_ENTRY *configEntry)
+{
+	int intValue = 0;
+
+	configEntry -> haveInt = (sscanf (configEntry -> configValue, "%i", &intValue) == 1);
+	configEntry -> intValue = intValue;
+
+	if (strcasecmp (configEntry -> configValue, "true") == 0)
+		configEntry -> boolValue = true;
+	else if (strcasecmp (configEntry -> configValue, "false") == 0)
+		configEntry -> boolValue = false;
+	else
+		configEntry -> boolValue = (intValue != 0);
+}
+
 /**********************************************************************************************************************
  *                                                                                                                    *
  *  C O N F I G  L O A D                                                                                              *
@@ -75,11 +129,8 @@ int configLoad (const char *configFile)
 	char readBuff[512], configName[81], configValue[256];
 	int i, j, quote;
 
-	if (configQueue == NULL)
-	{
-		if ((configQueue = queueCreate ()) == NULL)
-			return 0;
-	}
+	if (configQueue == NULL && !configCreate ())
+		return 0;
 
 	if (configFile[0] == 0)
 		return 0;
@@ -170,13 +221,13 @@ int configLoad (const char *configFile)
  */
 int configSave (const char *configFile)
 {
-	int i = 0;
+	void *current = NULL;
 	FILE *outFile = NULL;
 	CONFIG_ENTRY *foundEntry = NULL;
 
 	if (configQueue != NULL)
 	{
-		while ((foundEntry = queueRead (configQueue, i++)) != NULL)
+		while ((foundEntry = queueReadNext (configQueue, &current)) != NULL)
 		{
 			if (foundEntry -> saveInFile)
 			{
@@ -224,7 +275,8 @@ void configFree ()
 			free (foundEntry);
 		}
 		queueDelete (configQueue);
-		configQueue = NULL;
+		hashDelete (configHash);
+		configQueue = configHash = NULL;
 	}
 }
 
@@ -241,19 +293,7 @@ void configFree ()
  */
 static CONFIG_ENTRY *configFindEntry (const char *configName)
 {
-	int rec = 0;
-	CONFIG_ENTRY *foundEntry = NULL;
-
-	if (configQueue != NULL)
-	{
-		while ((foundEntry = queueRead (configQueue, rec)) != NULL)
-		{
-			if (strcmp (configName, foundEntry -> configName) == 0)
-				break;
-			rec ++;
-		}
-	}
-	return foundEntry;
+	return (CONFIG_ENTRY *)hashGetString (configHash, configName);
 }
 
 /**********************************************************************************************************************
@@ -272,11 +312,8 @@ int configSetValue (const char *configName, char *configValue)
 {
 	CONFIG_ENTRY *newEntry = NULL;
 
-	if (configQueue == NULL)
-	{
-		if ((configQueue = queueCreate ()) == NULL)
-			return 0;
-	}
+	if (configQueue == NULL && !configCreate ())
+		return 0;
 
 	if ((newEntry = configFindEntry (configName)) == NULL)
 	{
@@ -299,6 +336,13 @@ int configSetValue (const char *configName, char *configValue)
 		strcpy (newEntry -> configValue, configValue);
 		newEntry -> saveInFile = fileLoaded;
 
+		if (!hashPutString (configHash, newEntry -> configName, newEntry))
+		{
+			free (newEntry -> configValue);
+			free (newEntry -> configName);
+			free (newEntry);
+			return 0;
+		}
 		queuePut (configQueue, newEntry);
 	}
 	else
@@ -312,6 +356,7 @@ int configSetValue (const char *configName, char *configValue)
 		newEntry -> configValue = tempPtr;
 		newEntry -> saveInFile = fileLoaded;
 	}
+	configParse (newEntry);
 	return 1;
 }
 
@@ -397,7 +442,10 @@ int configGetIntValue (const char *configName, int *value)
 
 	if (foundEntry != NULL)
 	{
-		sscanf (foundEntry -> configValue, "%i", value);
+		if (foundEntry -> haveInt)
+		{
+			*value = foundEntry -> intValue;
+		}
 		return 1;
 	}
 	return 0;
@@ -421,20 +469,7 @@ int configGetBoolValue (const char *configName, bool *value)
 
 	if (foundEntry != NULL)
 	{
-		if (strcasecmp(foundEntry -> configValue, "true") == 0)
-		{
-			*value = true;
-		}
-		else if (strcasecmp(foundEntry -> configValue, "false") == 0)
-		{
-			*value = false;
-		}
-		else
-		{
-			int temp;
-			sscanf (foundEntry -> configValue, "%i", &temp);
-			*value = (temp != 0);
-		}
+		*value = foundEntry -> boolValue;
 		return 1;
 	}
 	return 0;
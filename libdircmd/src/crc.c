@@ -23,6 +23,18 @@
  */
 #include <config.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 #ifdef HAVE_OPENSSL_EVP_H
 #include <openssl/evp.h>
@@ -35,8 +47,233 @@
 #endif
 #endif
 
+#include "dircmd.h"
+
+/*----------------------------------------------------------------------------*
+ * Files are read a megabyte at a time, big files can be mapped instead       *
+ *----------------------------------------------------------------------------*/
+#define CRC_READ_SIZE		(1024 * 1024)
+#define CRC_PAGE_SIZE		4096
+#define CRC_DIGEST_MAX		64
+
+typedef void (crcUpdate)(void *context, const void *data, size_t size);
+
+static int crcReadFlags = 0;
+
+/*----------------------------------------------------------------------------*
+ * Size of each digest in the order of the CRC_DIGEST flags                   *
+ *----------------------------------------------------------------------------*/
+static const int crcDigestSize[CRC_DIGEST_COUNT] = { 16, 20, 32, 64 };
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C R C  S E T  R E A D  F L A G S                                                                                  *
+ *  ================================                                                                                  *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Set how files are read when making check sums.
+ *  \param flags CRC_READ_MMAP, CRC_READ_NOATIME and CRC_READ_DONTNEED or zero.
+ *  \result None.
+ */
+void crcSetReadFlags (int flags)
+{
+	crcReadFlags = flags;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C R C  F I L E  A D V I C E                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Tell the kernel how part of the file is being used.
+ *  \param inFile Open file handle.
+ *  \param offset Start of the part of the file.
+ *  \param length Length of the part, zero for the rest of the file.
+ *  \param advice One of the POSIX_FADV values.
+ *  \result None.
+ */
+static void crcFileAdvice (int inFile, off_t offset, off_t length, int advice)
+{
+#ifdef HAVE_POSIX_FADVISE
+	posix_fadvise (inFile, offset, length, advice);
+#endif
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C R C  R E A D  M A P                                                                                             *
+ *  =====================                                                                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Map a file and pass it to the check sum a block at a time.
+ *  \param inFile Open file handle.
+ *  \param fileSize Size of the file.
+ *  \param Update Function to add each block to the check sum.
+ *  \param context Check sum context to pass to the function.
+ *  \result 1 if the file was read, -1 if it could not be mapped and nothing was read.
+ */
+static int crcReadMap (int inFile, off_t fileSize, crcUpdate Update, void *context)
+{
+#if defined (HAVE_SYS_MMAN_H) && defined (MADV_SEQUENTIAL)
+	unsigned char *mapStart;
+	off_t offset, blockSize;
+
+	if ((mapStart = mmap (NULL, fileSize, PROT_READ, MAP_PRIVATE, inFile, 0)) == MAP_FAILED)
+		return -1;
+
+	madvise (mapStart, fileSize, MADV_SEQUENTIAL);
+	for (offset = 0; offset < fileSize; offset += blockSize)
+	{
+		blockSize = fileSize - offset < CRC_READ_SIZE ? fileSize - offset : CRC_READ_SIZE;
+		Update (context, &mapStart[offset], blockSize);
+	}
+	munmap (mapStart, fileSize);
+	return 1;
+#else
+	return -1;
+#endif
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C R C  R E A D  B U F F E R                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Read a file in large blocks and pass them to the check sum.
+ *  \param inFile Open file handle.
+ *  \param fileSize Size of the file if known, it is used to size the buffer.
+ *  \param Update Function to add each block to the check sum.
+ *  \param context Check sum context to pass to the function.
+ *  \result 1 if the whole file was read, 0 on a read error.
+ */
+static int crcReadBuffer (int inFile, off_t fileSize, crcUpdate Update, void *context)
+{
+	void *readBuff = NULL;
+	size_t buffSize = CRC_READ_SIZE;
+	off_t offset = 0;
+	ssize_t readSize;
+
+	/*------------------------------------------------------------------------*
+     * Small files do not need a whole megabyte, one read should get them     *
+     *------------------------------------------------------------------------*/
+	if (fileSize > 0 && fileSize < CRC_READ_SIZE)
+	{
+		buffSize = ((fileSize / CRC_PAGE_SIZE) + 1) * CRC_PAGE_SIZE;
+	}
+#ifdef HAVE_POSIX_MEMALIGN
+	if (posix_memalign (&readBuff, CRC_PAGE_SIZE, buffSize) != 0)
+		return 0;
+#else
+	if ((readBuff = malloc (buffSize)) == NULL)
+		return 0;
+#endif
+
+	while ((readSize = read (inFile, readBuff, buffSize)) != 0)
+	{
+		if (readSize < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		Update (context, readBuff, readSize);
+#ifdef POSIX_FADV_DONTNEED
+		if (crcReadFlags & CRC_READ_DONTNEED)
+		{
+			crcFileAdvice (inFile, offset, readSize, POSIX_FADV_DONTNEED);
+		}
+#endif
+		offset += readSize;
+	}
+	free (readBuff);
+	return readSize == 0;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C R C  R E A D  F I L E                                                                                           *
+ *  =======================                                                                                           *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Read a whole file passing it to a check sum, as set by crcSetReadFlags.
+ *  \param filename File to read.
+ *  \param Update Function to add each block to the check sum.
+ *  \param context Check sum context to pass to the function.
+ *  \result 1 if the whole file was read.
+ */
+static int crcReadFile (char *filename, crcUpdate Update, void *context)
+{
+	int inFile, openFlags = O_RDONLY, retn = -1;
+	struct stat fileStat;
+	off_t fileSize = 0;
+
+#ifdef O_NOATIME
+	if (crcReadFlags & CRC_READ_NOATIME)
+	{
+		openFlags |= O_NOATIME;
+	}
+#endif
+	if ((inFile = open (filename, openFlags)) < 0)
+	{
+		/*--------------------------------------------------------------------*
+         * Only the owner can ask for no access time, try again without it    *
+         *--------------------------------------------------------------------*/
+		if (errno != EPERM || openFlags == O_RDONLY || (inFile = open (filename, O_RDONLY)) < 0)
+			return 0;
+	}
+	if (fstat (inFile, &fileStat) == 0 && S_ISREG (fileStat.st_mode))
+	{
+		fileSize = fileStat.st_size;
+	}
+#ifdef POSIX_FADV_SEQUENTIAL
+	crcFileAdvice (inFile, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	if ((crcReadFlags & CRC_READ_MMAP) && fileSize >= CRC_READ_SIZE)
+	{
+		retn = crcReadMap (inFile, fileSize, Update, context);
+#ifdef POSIX_FADV_DONTNEED
+		if (retn == 1 && (crcReadFlags & CRC_READ_DONTNEED))
+		{
+			crcFileAdvice (inFile, 0, 0, POSIX_FADV_DONTNEED);
+		}
+#endif
+	}
+	if (retn == -1)
+	{
+		retn = crcReadBuffer (inFile, fileSize, Update, context);
+	}
+	close (inFile);
+	return retn;
+}
+
 #ifdef HAVE_OPENSSL_EVP_H
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C R C  U P D A T E  D I G E S T                                                                                   *
+ *  ===============================                                                                                   *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Add a block of the file to a digest.
+ *  \param context Digest context.
+ *  \param data Block of the file.
+ *  \param size Size of the block.
+ *  \result None.
+ */
+static void crcUpdateDigest (void *context, const void *data, size_t size)
+{
+	EVP_DigestUpdate ((EVP_MD_CTX *)context, data, size);
+}
+
 /**********************************************************************************************************************
  *                                                                                                                    *
  *  M D  C H E C K  S U M                                                                                             *
@@ -58,29 +295,108 @@ int mdCheckSum (char *digestname, char *filename, unsigned char *outBuffer)
 
 	if (filename != NULL && outBuffer != NULL)
 	{
-		FILE *inFile = NULL;
-		if ((inFile = fopen (filename, "rb")) != NULL)
+		unsigned int mdLen;
+
+		OpenSSL_add_all_digests();
+		if ((md = EVP_get_digestbyname(digestname)) != NULL)
 		{
-			unsigned int mdLen;
-			char readBuff[4100];
-			int readSize;
-			
-			OpenSSL_add_all_digests();
-			if ((md = EVP_get_digestbyname(digestname)) != NULL)
+			mdctx = EVP_MD_CTX_create();
+			EVP_DigestInit_ex(mdctx, md, NULL);
+
+			if ((retn = crcReadFile (filename, crcUpdateDigest, mdctx)) == 1)
 			{
-				mdctx = EVP_MD_CTX_create();
-				EVP_DigestInit_ex(mdctx, md, NULL);
+				EVP_DigestFinal_ex(mdctx, outBuffer, &mdLen);
+			}
+			EVP_MD_CTX_destroy(mdctx);
+		}
+		EVP_cleanup();
+	}
+	return retn;
+}
+
+/*----------------------------------------------------------------------------*
+ * Digests in the order of the CRC_DIGEST flags                               *
+ *----------------------------------------------------------------------------*/
+static const EVP_MD *(*crcDigestType[CRC_DIGEST_COUNT])(void) = { EVP_md5, EVP_sha1, EVP_sha256, EVP_sha512 };
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C R C  U P D A T E  D I G E S T S                                                                                 *
+ *  =================================                                                                                 *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Add a block of the file to each of the digests being made.
+ *  \param context Array of digest contexts, NULL for those not being made.
+ *  \param data Block of the file.
+ *  \param size Size of the block.
+ *  \result None.
+ */
+static void crcUpdateDigests (void *context, const void *data, size_t size)
+{
+	EVP_MD_CTX **mdContext = (EVP_MD_CTX **)context;
+	int i;
+
+	for (i = 0; i < CRC_DIGEST_COUNT; ++i)
+	{
+		if (mdContext[i] != NULL)
+		{
+			EVP_DigestUpdate (mdContext[i], data, size);
+		}
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C R C  D I G E S T  F I L E                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Make several digests of a file reading it only once.
+ *  \param filename File to check sum.
+ *  \param digests CRC_DIGEST flags of the digests to make.
+ *  \param outBuffers Output buffers in the order of the flags, only those asked for are used.
+ *  \result 1 if all OK.
+ */
+int crcDigestFile (char *filename, int digests, unsigned char *outBuffers[])
+{
+	EVP_MD_CTX *mdContext[CRC_DIGEST_COUNT];
+	unsigned int mdLen;
+	int i, retn = 0;
 
-				retn = 1;
-				while ((readSize = fread (readBuff, 1, 4096, inFile)) > 0)
+	if (filename != NULL && outBuffers != NULL && digests != 0)
+	{
+		retn = 1;
+		for (i = 0; i < CRC_DIGEST_COUNT; ++i)
+		{
+			mdContext[i] = NULL;
+			if (retn && (digests & (1 << i)))
+			{
+				if (outBuffers[i] == NULL || (mdContext[i] = EVP_MD_CTX_create ()) == NULL)
 				{
-					EVP_DigestUpdate(mdctx, readBuff, readSize);
-				}	
-				fclose (inFile);
-				EVP_DigestFinal_ex(mdctx, outBuffer, &mdLen);
-				EVP_MD_CTX_destroy(mdctx);
+					retn = 0;
+				}
+				else
+				{
+					EVP_DigestInit_ex (mdContext[i], crcDigestType[i] (), NULL);
+				}
+			}
+		}
+		if (retn)
+		{
+			retn = crcReadFile (filename, crcUpdateDigests, mdContext);
+		}
+		for (i = 0; i < CRC_DIGEST_COUNT; ++i)
+		{
+			if (mdContext[i] != NULL)
+			{
+				if (retn == 1)
+				{
+					EVP_DigestFinal_ex (mdContext[i], outBuffers[i], &mdLen);
+				}
+				EVP_MD_CTX_destroy (mdContext[i]);
 			}
-			EVP_cleanup();
 		}
 	}
 	return retn;
@@ -121,6 +437,61 @@ int SHA256File (char *filename, unsigned char *shaBuffer)
 }
 
 #else
+/*----------------------------------------------------------------------------*
+ * Without EVP only the MD5 and SHA256 check sums can be made                 *
+ *----------------------------------------------------------------------------*/
+typedef struct _crcContexts
+{
+	int digests;
+#ifdef HAVE_OPENSSL_MD5_H
+	MD5_CTX md5c;
+#endif
+#ifdef HAVE_OPENSSL_SHA_H
+	SHA256_CTX sha256c;
+#endif
+}
+CRC_CONTEXTS;
+
+#ifdef HAVE_OPENSSL_MD5_H
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C R C  U P D A T E  M D 5                                                                                         *
+ *  =========================                                                                                         *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Add a block of the file to an MD5.
+ *  \param context MD5 context.
+ *  \param data Block of the file.
+ *  \param size Size of the block.
+ *  \result None.
+ */
+static void crcUpdateMD5 (void *context, const void *data, size_t size)
+{
+	MD5_Update ((MD5_CTX *)context, data, size);
+}
+#endif
+
+#ifdef HAVE_OPENSSL_SHA_H
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C R C  U P D A T E  S H A 2 5 6                                                                                   *
+ *  ===============================                                                                                   *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Add a block of the file to an SHA256.
+ *  \param context SHA256 context.
+ *  \param data Block of the file.
+ *  \param size Size of the block.
+ *  \result None.
+ */
+static void crcUpdateSHA256 (void *context, const void *data, size_t size)
+{
+	SHA256_Update ((SHA256_CTX *)context, data, size);
+}
+#endif
+
 /**********************************************************************************************************************
  *                                                                                                                    *
  *  M D 5 F I L E                                                                                                     *
@@ -141,19 +512,9 @@ int MD5File (char *filename, unsigned char *md5Buffer)
 
 	if (filename != NULL && md5Buffer != NULL)
 	{
-		FILE *inFile;
-		if ((inFile = fopen (filename, "rb")) != NULL)
+		MD5_Init (&md5c);
+		if ((retn = crcReadFile (filename, crcUpdateMD5, &md5c)) == 1)
 		{
-			int readSize;
-			char readBuff[4100];
-			
-			MD5_Init (&md5c);
-			retn = 1;
-			while ((readSize = fread (readBuff, 1, 4096, inFile)) > 0)
-			{
-				MD5_Update (&md5c, readBuff, readSize);
-			}
-			fclose (inFile);
 			MD5_Final (md5Buffer, &md5c);
 		}
 	}
@@ -183,19 +544,9 @@ int SHA256File (char *filename, unsigned char *shaBuffer)
 
 	if (filename != NULL && shaBuffer != NULL)
 	{
-		FILE *inFile;
-		if ((inFile = fopen (filename, "rb")) != NULL)
+		SHA256_Init (&sha256c);
+		if ((retn = crcReadFile (filename, crcUpdateSHA256, &sha256c)) == 1)
 		{
-			int readSize;
-			char readBuff[4100];
-			
-			SHA256_Init (&sha256c);
-			retn = 1;
-			while ((readSize = fread (readBuff, 1, 4096, inFile)) != 0)
-			{
-				SHA256_Update (&sha256c, readBuff, readSize);
-			}
-			fclose (inFile);
 			SHA256_Final (shaBuffer, &sha256c);
 		}
 	}
@@ -205,4 +556,165 @@ int SHA256File (char *filename, unsigned char *shaBuffer)
 	return retn;
 }
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C R C  U P D A T E  C O N T E X T S                                                                               *
+ *  ===================================                                                                               *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Add a block of the file to each of the check sums being made.
+ *  \param context Check sum contexts.
+ *  \param data Block of the file.
+ *  \param size Size of the block.
+ *  \result None.
+ */
+static void crcUpdateContexts (void *context, const void *data, size_t size)
+{
+	CRC_CONTEXTS *contexts = (CRC_CONTEXTS *)context;
+
+#ifdef HAVE_OPENSSL_MD5_H
+	if (contexts -> digests & CRC_DIGEST_MD5)
+	{
+		MD5_Update (&contexts -> md5c, data, size);
+	}
 #endif
+#ifdef HAVE_OPENSSL_SHA_H
+	if (contexts -> digests & CRC_DIGEST_SHA256)
+	{
+		SHA256_Update (&contexts -> sha256c, data, size);
+	}
+#endif
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C R C  D I G E S T  F I L E                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Make several check sums of a file reading it only once.
+ *  \param filename File to check sum.
+ *  \param digests CRC_DIGEST flags of the check sums to make.
+ *  \param outBuffers Output buffers in the order of the flags, only those asked for are used.
+ *  \result 1 if all OK.
+ */
+int crcDigestFile (char *filename, int digests, unsigned char *outBuffers[])
+{
+	CRC_CONTEXTS contexts;
+	int canDigest = 0, retn = 0;
+
+#ifdef HAVE_OPENSSL_MD5_H
+	canDigest |= CRC_DIGEST_MD5;
+#endif
+#ifdef HAVE_OPENSSL_SHA_H
+	canDigest |= CRC_DIGEST_SHA256;
+#endif
+	if (filename != NULL && outBuffers != NULL && digests != 0 && (digests & ~canDigest) == 0)
+	{
+		contexts.digests = digests;
+#ifdef HAVE_OPENSSL_MD5_H
+		if (digests & CRC_DIGEST_MD5)
+		{
+			MD5_Init (&contexts.md5c);
+		}
+#endif
+#ifdef HAVE_OPENSSL_SHA_H
+		if (digests & CRC_DIGEST_SHA256)
+		{
+			SHA256_Init (&contexts.sha256c);
+		}
+#endif
+		if ((retn = crcReadFile (filename, crcUpdateContexts, &contexts)) == 1)
+		{
+#ifdef HAVE_OPENSSL_MD5_H
+			if (digests & CRC_DIGEST_MD5)
+			{
+				MD5_Final (outBuffers[0], &contexts.md5c);
+			}
+#endif
+#ifdef HAVE_OPENSSL_SHA_H
+			if (digests & CRC_DIGEST_SHA256)
+			{
+				SHA256_Final (outBuffers[2], &contexts.sha256c);
+			}
+#endif
+		}
+	}
+	return retn;
+}
+
+#endif
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C R C  F I L E  D I G E S T S                                                                                     *
+ *  =============================                                                                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Fill in the check sums of a directory entry that have not been done, from one read of the file.
+ *  \param file Directory entry to check sum.
+ *  \param digests CRC_DIGEST flags of the check sums wanted, only MD5 and SHA256 are kept in an entry.
+ *  \result 1 if all the check sums wanted are now in the entry.
+ */
+int crcFileDigests (DIR_ENTRY *file, int digests)
+{
+	unsigned char **fileSums[CRC_DIGEST_COUNT] = { &file -> md5Sum, NULL, &file -> sha256Sum, NULL };
+	unsigned char digestBuff[CRC_DIGEST_COUNT][CRC_DIGEST_MAX], *outBuffers[CRC_DIGEST_COUNT];
+	char fullName[PATH_SIZE];
+	int i, retn = 1, needed = 0;
+
+	/*------------------------------------------------------------------------*
+     * Each check sum is only tried once, a file that could not be read       *
+     * would be read again every time it is compared                          *
+     *------------------------------------------------------------------------*/
+	for (i = 0; i < CRC_DIGEST_COUNT; ++i)
+	{
+		outBuffers[i] = digestBuff[i];
+		if ((digests & (1 << i)) && fileSums[i] != NULL && *fileSums[i] == NULL)
+		{
+			if (file -> digestsTried & (1 << i))
+			{
+				retn = 0;
+			}
+			else
+			{
+				needed |= (1 << i);
+			}
+		}
+	}
+	if (needed)
+	{
+		file -> digestsTried |= needed;
+		strcpy (fullName, file -> fullPath);
+		strcat (fullName, file -> fileName);
+
+		/*--------------------------------------------------------------------*
+         * Only sums that were made are added to the entry                    *
+         *--------------------------------------------------------------------*/
+		if (crcDigestFile (fullName, needed, outBuffers) == 1)
+		{
+			for (i = 0; i < CRC_DIGEST_COUNT; ++i)
+			{
+				if (needed & (1 << i))
+				{
+					if ((*fileSums[i] = directoryAlloc (file, crcDigestSize[i])) != NULL)
+					{
+						memcpy (*fileSums[i], digestBuff[i], crcDigestSize[i]);
+					}
+					else
+					{
+						retn = 0;
+					}
+				}
+			}
+		}
+		else
+		{
+			retn = 0;
+		}
+	}
+	return retn;
+}
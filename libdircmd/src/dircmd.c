@@ -32,13 +32,18 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 #include <unistd.h>
 #include <ctype.h>
 #include <errno.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
-#include <linux/fcntl.h>
+#include <sys/sysmacros.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
 #ifdef HAVE_VALUES_H
 #include <values.h>
 #else
@@ -47,17 +52,488 @@
 
 #include "dircmd.h"
 
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#include <poll.h>
+#define USE_INOTIFY
+#endif
+
+#if defined (HAVE_LINUX_IO_URING_H) && defined (USE_STATX) && defined (SYS_io_uring_setup)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#ifdef IO_URING_OP_SUPPORTED
+#define USE_URING
+#endif
+#endif
+
+#define MAX_LOAD_THREADS	256
+#define MAX_LOAD_LEVEL		4096
+#define MIN_LOAD_LEVEL		40
+#define VISITED_MIN			1024
+#define DIR_BATCH_SIZE		32768
+#define DIR_BATCH_ITEMS		(DIR_BATCH_SIZE / 24)
+
+#define STAT_RING_SIZE		256
+#define STAT_RING_MIN		8
+#define STAT_RING_BUSY		100
+#define RING_SLOT_SHIFT		32
+#define RING_ITEM_MASK		0xFFFFFFFFULL
+
+#define ITEM_RECURSE		0x0001
+#define ITEM_NEED_STAT		0x0002
+#define ITEM_HAVE_STAT		0x0004
+#define ITEM_CHECK_EXCLUDE	0x0008
+#define ITEM_RING_DONE		0x0010
+
+#define EXCLUDE_NEGATE		0x0001
+#define EXCLUDE_DIRONLY		0x0002
+#define EXCLUDE_ANCHORED	0x0004
+#define EXCLUDE_GLOB		0
+#define EXCLUDE_LITERAL		1
+#define EXCLUDE_SUFFIX		2
+#define EXCLUDE_NO_MATCH	-1
+
+#define CACHE_MAGIC			"LDIRCACH"
+#define CACHE_VERSION		1
+#define CACHE_HASH_MIN		1024
+
+#define WATCH_HASH_MIN		256
+#define WATCH_BUFFER_SIZE	65536
+#define WATCH_EVENTS		(IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_MODIFY | \
+							IN_ONLYDIR | IN_EXCL_UNLINK)
+
+#define SORT_KEY_SIZE		(PATH_SIZE * 4)
+
+#ifdef USE_STATX
+#define COMPACT_STAT_SIZE	(offsetof (struct statx, stx_mtime) + sizeof (struct statx_timestamp))
+#define COMPACT_STAT_MASK	(STATX_BASIC_STATS | STATX_BTIME)
+#else
+#define COMPACT_STAT_SIZE	(offsetof (struct stat, st_ctim) + sizeof (struct timespec))
+#endif
+#define COMPACT_ENTRY_SIZE	(offsetof (DIR_ENTRY, fileStat) + COMPACT_STAT_SIZE)
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold the settings used while loading a directory                                                      *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirLoadInfo
+{
+	int findFlags;
+	compareFile *Compare;
+	char *filePattern;
+	void *fileMatch;
+	unsigned int statMask;
+	struct _dirStatRing *statRing;
+	int (*StreamFile)(DIR_ENTRY *dirEntry);
+	struct _dirStreamBuffer *streamBuffer;
+	struct _dirWatch *dirWatch;
+	struct _dirTopHeap *topHeap;
+	struct _dirVisited *visitedDirs;
+	int maxLevel;
+	int maxDepth;
+	dev_t loadDev;
+}
+DIR_LOAD_INFO;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold the device and inode of each directory read, so none is read twice                               *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirVisited
+{
+	unsigned long long *visitKeys;
+	unsigned int visitSize;
+	unsigned int visitCount;
+	int prunedCount;
+	pthread_mutex_t visitMutex;
+}
+DIR_VISITED;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold one exclude rule, in the form used by .gitignore                                                 *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirExcludeRule
+{
+	int ruleFlags;
+	int ruleType;
+	int textLen;
+	char *ruleText;
+}
+DIR_EXCLUDE_RULE;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold the exclude rules read from a directory, they also apply to those below it                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirExcludeList
+{
+	struct _dirExcludeList *parentList;
+	int refCount;
+	char *basePath;
+	int baseLen;
+	int ruleCount;
+	int ruleSize;
+	DIR_EXCLUDE_RULE *excludeRules;
+}
+DIR_EXCLUDE_LIST;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold a directory being watched and the entries that were found in it                                  *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirWatchDir
+{
+	struct _dirWatchDir *nextDir;
+	struct _dirWatchDir *prevDir;
+	struct _dirWatchDir *nextHash;
+	int watchDesc;
+	int dirLevel;
+	bool dirChanged;
+	long long mtimeSec;
+	long long ctimeSec;
+	long mtimeNsec;
+	long ctimeNsec;
+	char *dirPath;
+	char *partPath;
+	struct _dirExcludeList *excludeList;
+	DIR_ENTRY **dirEntries;
+	int entryCount;
+	int entrySize;
+}
+DIR_WATCH_DIR;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold a directory tree that is kept up to date from inotify events                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirWatch
+{
+	DIR_LOAD_INFO loadInfo;
+	char *rootPath;
+	int watchFd;
+	DIR_WATCH_DIR *firstDir;
+	DIR_WATCH_DIR **pathHash;
+	unsigned int hashSize;
+	unsigned int dirCount;
+	DIR_WATCH_DIR **watchIndex;
+	int indexSize;
+}
+DIR_WATCH;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold the entries found by a streaming walk until the caller takes them                                *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirStreamBuffer
+{
+	DIR_LOAD_INFO *loadInfo;
+	char *dirPath;
+	int filesFound;
+	DIR_ENTRY **streamEntries;
+	int bufferSize;
+	int bufferHead;
+	int bufferCount;
+	bool walkDone;
+	pthread_mutex_t bufferMutex;
+	pthread_cond_t notEmpty;
+	pthread_cond_t notFull;
+}
+DIR_STREAM_BUFFER;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold the best entries found so far when only the first (or last) few are wanted                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirTopHeap
+{
+	int (*KeepFile)(DIR_ENTRY *dirEntry);
+	DIR_ENTRY **heapEntries;
+	int heapSize;
+	int heapAlloc;
+	int heapCount;
+	int filesKept;
+	bool keepLast;
+	pthread_mutex_t heapMutex;
+}
+DIR_TOP_HEAP;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold a directory waiting to be read by the work pool                                                  *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirLoadTask
+{
+	char *dirPath;
+	char *partPath;
+	int level;
+	struct _dirExcludeList *excludeList;
+}
+DIR_LOAD_TASK;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold a worker thread, its deque of directories and what it found                                      *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirWorker
+{
+	pthread_t threadID;
+	pthread_mutex_t dequeMutex;
+	DIR_LOAD_TASK **taskDeque;
+	int dequeSize;
+	int dequeHead;
+	int dequeCount;
+	int workerNum;
+	int filesFound;
+	void *fileList;
+	struct _dirStatRing *statRing;
+	struct _dirWorkPool *workPool;
+}
+DIR_WORKER;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold the work pool used to read directories in parallel                                               *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirWorkPool
+{
+	DIR_LOAD_INFO *loadInfo;
+	DIR_WORKER *workers;
+	int workerCount;
+	int idleWorkers;
+	unsigned long pendingTasks;
+	unsigned long workVersion;
+	pthread_mutex_t poolMutex;
+	pthread_cond_t poolCond;
+}
+DIR_WORK_POOL;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold a name read from a directory and what we know about it                                           *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirLoadItem
+{
+	char *fileName;
+	unsigned char dirType;
+	int itemFlags;
+	int statError;
+	mode_t fileMode;
+	DIR_ENTRY *saveEntry;
+	char *cacheStat;
+	unsigned int cacheMask;
+	unsigned int cacheSize;
+}
+DIR_LOAD_ITEM;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold a directory listing kept in the cache, the key is its device, inode and times                    *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirCacheDir
+{
+	struct _dirCacheDir *nextDir;
+	unsigned long long dirDev;
+	unsigned long long dirIno;
+	long long mtimeSec;
+	long long ctimeSec;
+	long mtimeNsec;
+	long ctimeNsec;
+	unsigned int itemCount;
+	unsigned int dataSize;
+	char *dirData;
+}
+DIR_CACHE_DIR;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold each name in a cached listing, followed by its stat then the name                                *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirCacheItem
+{
+	unsigned int fileMode;
+	unsigned int statMask;
+	unsigned short statSize;
+	unsigned short nameSize;
+}
+DIR_CACHE_ITEM;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold a cached listing as a directory is read                                                          *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirCacheBuild
+{
+	char *buildData;
+	unsigned int dataSize;
+	unsigned int bufferSize;
+	unsigned int itemCount;
+	unsigned int statCount;
+	bool buildFailed;
+}
+DIR_CACHE_BUILD;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold the start of the cache file                                                                      *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirCacheHeader
+{
+	char cacheMagic[8];
+	unsigned int cacheVersion;
+	unsigned int statSize;
+	unsigned int dirCount;
+	unsigned int spare;
+}
+DIR_CACHE_HEADER;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold each directory in the cache file, it is followed by its listing                                  *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirCacheRecord
+{
+	unsigned long long dirDev;
+	unsigned long long dirIno;
+	long long mtimeSec;
+	long long ctimeSec;
+	long long mtimeNsec;
+	long long ctimeNsec;
+	unsigned int itemCount;
+	unsigned int dataSize;
+}
+DIR_CACHE_RECORD;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold the cache of directory listings                                                                  *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirCache
+{
+	char *cacheFile;
+	DIR_CACHE_DIR **hashTable;
+	DIR_CACHE_DIR *oldDirs;
+	unsigned int hashSize;
+	unsigned int dirCount;
+	bool cacheChanged;
+	pthread_mutex_t cacheMutex;
+}
+DIR_CACHE;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold an open directory and the last batch of names read from it                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirLoadBatch
+{
+	int dirFd;
+#ifndef SYS_getdents64
+	DIR *dirPtr;
+#endif
+	char *readBuffer;
+	DIR_LOAD_ITEM *loadItems;
+	int itemCount;
+	struct _dirStatRing **statRing;
+	struct _dirLoadBatch *nextBatch;
+	char *fullPath;
+	char *partPath;
+}
+DIR_LOAD_BATCH;
+
+#ifdef USE_URING
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold an io_uring used to stat a batch of names at once                                                *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _dirStatRing
+{
+	int ringFd;
+	unsigned int ringEntries;
+	void *sqRingPtr;
+	void *cqRingPtr;
+	size_t sqRingSize;
+	size_t cqRingSize;
+	size_t sqeSize;
+	unsigned int *sqHead;
+	unsigned int *sqTail;
+	unsigned int *sqMask;
+	unsigned int *sqArray;
+	unsigned int *cqHead;
+	unsigned int *cqTail;
+	unsigned int *cqMask;
+	struct io_uring_sqe *sqEntries;
+	struct io_uring_cqe *cqEntries;
+	struct statx *ringStats;
+	unsigned int ringOwed;
+}
+DIR_STAT_RING;
+
+static int uringState = 0;
+#endif
+
+static int loadThreads = 1;
+static int loadMaxDepth = -1;
+static DIR_CACHE *dirCache = NULL;
+static DIR_EXCLUDE_LIST excludeGlobal;
+
+/*----------------------------------------------------------------------------*
+ * Rules used to hide the version control directories, as if in .gitignore    *
+ *----------------------------------------------------------------------------*/
+static DIR_EXCLUDE_RULE verCtlRules[] =
+{
+	{	EXCLUDE_DIRONLY,	EXCLUDE_LITERAL,	3,	"CVS"	},
+	{	EXCLUDE_DIRONLY,	EXCLUDE_LITERAL,	4,	".git"	},
+	{	EXCLUDE_DIRONLY,	EXCLUDE_LITERAL,	4,	".svn"	}
+};
+static DIR_EXCLUDE_LIST excludeVerCtl =
+{
+	NULL, 1, "", 0, sizeof (verCtlRules) / sizeof (DIR_EXCLUDE_RULE), 0, verCtlRules
+};
+static char *excludeName = NULL;
+#ifdef USE_STATX
+static unsigned int loadStatMask = STATX_ALL;
+#endif
+
 /**********************************************************************************************************************
  *                                                                                                                    *
  * Prototypes                                                                                                         *
  *                                                                                                                    *
  **********************************************************************************************************************/
 static int listCompare (const void **item1, const void **item2);
+static int listKeyCompare (const void **item1, const void **item2);
+static int directoryLoadDir (DIR_LOAD_INFO *loadInfo, int parentFd, char *dirName, char *dirPath, char *partPath,
+		void *fileList, int level, DIR_EXCLUDE_LIST *excludeList, DIR_WORKER *worker);
+static bool workerPushTask (DIR_WORKER *worker, char *dirPath, char *partPath, int level,
+		DIR_EXCLUDE_LIST *excludeList);
+static void directoryCloseBatch (DIR_LOAD_BATCH *loadBatch);
 #ifdef USE_STATX
 static int getEntryType (struct statx *fileStat);
 #else
 static int getEntryType (struct stat *fileStat);
 #endif
+#ifdef USE_URING
+static bool statRingDrain (DIR_STAT_RING *statRing);
+#endif
 
 /**********************************************************************************************************************
  *                                                                                                                    *
@@ -126,270 +602,3853 @@ static char *strcat_ch (char *buff, char ch)
  *  \param fileTwo Second file to compare with.
  *  \result 0 same, 1 greater, -1 less.
  */
-int directoryDefCompare (DIR_ENTRY *fileOne, DIR_ENTRY *fileTwo)
+int directoryDefCompare (DIR_ENTRY *fileOne, DIR_ENTRY *fileTwo)
+{
+#ifdef USE_STATX
+	if (fileOne -> fileStat.stx_mode & S_IFDIR)
+	{
+		if (!(fileTwo -> fileStat.stx_mode & S_IFDIR))
+			return -1;
+	}
+	if (fileTwo -> fileStat.stx_mode & S_IFDIR)
+	{
+		if (!(fileOne -> fileStat.stx_mode & S_IFDIR))
+			return 1;
+	}
+#else
+	if (fileOne -> fileStat.st_mode & S_IFDIR)
+	{
+		if (!(fileTwo -> fileStat.st_mode & S_IFDIR))
+			return -1;
+	}
+	if (fileTwo -> fileStat.st_mode & S_IFDIR)
+	{
+		if (!(fileOne -> fileStat.st_mode & S_IFDIR))
+			return 1;
+	}
+#endif
+	return strcasecmp (fileOne -> fileName, fileTwo -> fileName);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  F R E E  E N T R Y                                                                             *
+ *  =====================================                                                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Free a directory entry and everything that was added to it.
+ *  \param dirEntry Entry to free.
+ *  \result None.
+ */
+static void directoryFreeEntry (DIR_ENTRY *dirEntry)
+{
+	/*------------------------------------------------------------------------*
+     * Entries from a list's arena are freed with the list                    *
+     *------------------------------------------------------------------------*/
+	if (dirEntry -> entryArena != NULL)
+		return;
+
+	if (dirEntry -> md5Sum != NULL)
+	{
+		free (dirEntry -> md5Sum);
+	}
+	if (dirEntry -> sha256Sum != NULL)
+	{
+		free (dirEntry -> sha256Sum);
+	}
+	if (dirEntry -> fileVer != NULL)
+	{
+		if (dirEntry -> fileVer -> fileStart != NULL)
+		{
+			free (dirEntry -> fileVer -> fileStart);
+		}
+		free (dirEntry -> fileVer);
+	}
+	if (dirEntry -> sortKey != NULL)
+	{
+		free (dirEntry -> sortKey);
+	}
+	free (dirEntry -> fileName);
+	free (dirEntry -> fullPath);
+	free (dirEntry -> partPath);
+
+	free (dirEntry);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  L O A D  S U B  D I R                                                                          *
+ *  ========================================                                                                          *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Read a sub-directory now, or hand it to the work pool if reading in parallel.
+ *  \param loadInfo Settings for this load.
+ *  \param parentFd Open directory that dirName is relative to.
+ *  \param dirName Name of the sub-directory in the parent.
+ *  \param dirPath The path to the sub-directory, ends with a '/'.
+ *  \param partPath Path as it goes into sub directories.
+ *  \param fileList Where to save the directory.
+ *  \param level Level of recursion.
+ *  \param excludeList Exclude rules of the parent directory.
+ *  \param worker Worker reading the parent directory, NULL if not parallel.
+ *  \result The number of files found, always 0 when handed to the pool.
+ */
+static int directoryLoadSubDir (DIR_LOAD_INFO *loadInfo, int parentFd, char *dirName, char *dirPath, char *partPath,
+		void *fileList, int level, DIR_EXCLUDE_LIST *excludeList, DIR_WORKER *worker)
+{
+	if (worker != NULL)
+	{
+		if (workerPushTask (worker, dirPath, partPath, level, excludeList))
+		{
+			return 0;
+		}
+	}
+	return directoryLoadDir (loadInfo, parentFd, dirName, dirPath, partPath, fileList, level, excludeList, worker);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  G E T  D I R E N T  T Y P E                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Convert the type given by the directory into the find flags.
+ *  \param dirType Type from the directory entry, d_type.
+ *  \result The type of the file, or ALLFILES if the directory did not say.
+ */
+static int getDirentType (unsigned char dirType)
+{
+	switch (dirType)
+	{
+	case DT_LNK:
+		return ONLYLINKS;
+	case DT_DIR:
+		return ONLYDIRS;
+	case DT_REG:
+		return ONLYFILES;
+	case DT_BLK:
+	case DT_CHR:
+		return ONLYDEVS;
+	case DT_SOCK:
+		return ONLYSOCKS;
+	case DT_FIFO:
+		return ONLYPIPES;
+	}
+	return ALLFILES;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  O P E N  B A T C H                                                                             *
+ *  =====================================                                                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Open a directory so that it can be read in batches.
+ *  \param loadBatch Batch to open.
+ *  \param parentFd Open directory that dirName is relative to, or AT_FDCWD.
+ *  \param dirName The name of the directory to be read.
+ *  \result True if the directory was opened.
+ */
+static bool directoryOpenBatch (DIR_LOAD_BATCH *loadBatch, int parentFd, char *dirName)
+{
+	memset (loadBatch, 0, sizeof (DIR_LOAD_BATCH));
+	if ((loadBatch -> dirFd = openat (parentFd, dirName, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) == -1)
+		return false;
+#ifndef SYS_getdents64
+	if ((loadBatch -> dirPtr = fdopendir (loadBatch -> dirFd)) == NULL)
+	{
+		close (loadBatch -> dirFd);
+		return false;
+	}
+#endif
+	loadBatch -> readBuffer = malloc (DIR_BATCH_SIZE);
+	loadBatch -> loadItems = malloc (DIR_BATCH_ITEMS * sizeof (DIR_LOAD_ITEM));
+	if (loadBatch -> readBuffer == NULL || loadBatch -> loadItems == NULL)
+	{
+		directoryCloseBatch (loadBatch);
+		return false;
+	}
+	return true;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  C L O S E  B A T C H                                                                           *
+ *  =======================================                                                                           *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Close a directory opened with directoryOpenBatch.
+ *  \param loadBatch Batch to close.
+ *  \result None.
+ */
+static void directoryCloseBatch (DIR_LOAD_BATCH *loadBatch)
+{
+	DIR_LOAD_BATCH *nextBatch;
+
+	while ((nextBatch = loadBatch -> nextBatch) != NULL)
+	{
+		loadBatch -> nextBatch = nextBatch -> nextBatch;
+		free (nextBatch -> readBuffer);
+		free (nextBatch -> loadItems);
+		free (nextBatch);
+	}
+#ifdef SYS_getdents64
+	if (loadBatch -> dirFd != -1)
+		close (loadBatch -> dirFd);
+#else
+	if (loadBatch -> dirPtr != NULL)
+		closedir (loadBatch -> dirPtr);
+	loadBatch -> dirPtr = NULL;
+#endif
+	loadBatch -> dirFd = -1;
+	free (loadBatch -> readBuffer);
+	free (loadBatch -> loadItems);
+	loadBatch -> readBuffer = NULL;
+	loadBatch -> loadItems = NULL;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  N E X T  B A T C H                                                                             *
+ *  =====================================                                                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Add another batch to the chain so a whole directory can be held before it is processed.
+ *  \param loadBatch Last batch in the chain, the new one reads from the same directory.
+ *  \result The new batch, or NULL if out of memory.
+ */
+static DIR_LOAD_BATCH *directoryNextBatch (DIR_LOAD_BATCH *loadBatch)
+{
+	DIR_LOAD_BATCH *nextBatch;
+
+	if ((nextBatch = calloc (1, sizeof (DIR_LOAD_BATCH))) == NULL)
+		return NULL;
+
+	nextBatch -> dirFd = loadBatch -> dirFd;
+#ifndef SYS_getdents64
+	nextBatch -> dirPtr = loadBatch -> dirPtr;
+#endif
+	nextBatch -> statRing = loadBatch -> statRing;
+	nextBatch -> readBuffer = malloc (DIR_BATCH_SIZE);
+	nextBatch -> loadItems = malloc (DIR_BATCH_ITEMS * sizeof (DIR_LOAD_ITEM));
+	if (nextBatch -> readBuffer == NULL || nextBatch -> loadItems == NULL)
+	{
+		free (nextBatch -> readBuffer);
+		free (nextBatch -> loadItems);
+		free (nextBatch);
+		return NULL;
+	}
+	loadBatch -> nextBatch = nextBatch;
+	return nextBatch;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  R E A D  B A T C H                                                                             *
+ *  =====================================                                                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Read the next batch of names from the directory, getdents64 gives us many per call.
+ *  \param loadBatch Batch to fill, names point in to the read buffer.
+ *  \result The number of names read, 0 at the end of the directory.
+ */
+static int directoryReadBatch (DIR_LOAD_BATCH *loadBatch)
+{
+	loadBatch -> itemCount = 0;
+#ifdef SYS_getdents64
+	long readSize = syscall (SYS_getdents64, loadBatch -> dirFd, loadBatch -> readBuffer, DIR_BATCH_SIZE);
+	long offset = 0;
+
+	while (offset < readSize && loadBatch -> itemCount < DIR_BATCH_ITEMS)
+	{
+		struct dirent64 *dirList = (struct dirent64 *)&loadBatch -> readBuffer[offset];
+		DIR_LOAD_ITEM *loadItem = &loadBatch -> loadItems[loadBatch -> itemCount++];
+
+		memset (loadItem, 0, sizeof (DIR_LOAD_ITEM));
+		loadItem -> fileName = dirList -> d_name;
+		loadItem -> dirType = dirList -> d_type;
+		offset += dirList -> d_reclen;
+	}
+#else
+	struct dirent *dirList;
+	int offset = 0;
+
+	/*------------------------------------------------------------------------*
+     * No getdents64 so copy the names from readdir in to our buffer          *
+     *------------------------------------------------------------------------*/
+	while (loadBatch -> itemCount < DIR_BATCH_ITEMS && offset + NAME_MAX + 1 < DIR_BATCH_SIZE &&
+			(dirList = readdir (loadBatch -> dirPtr)) != NULL)
+	{
+		DIR_LOAD_ITEM *loadItem = &loadBatch -> loadItems[loadBatch -> itemCount++];
+
+		memset (loadItem, 0, sizeof (DIR_LOAD_ITEM));
+		loadItem -> fileName = strcpy (&loadBatch -> readBuffer[offset], dirList -> d_name);
+#ifdef _DIRENT_HAVE_D_TYPE
+		loadItem -> dirType = dirList -> d_type;
+#else
+		loadItem -> dirType = DT_UNKNOWN;
+#endif
+		offset += strlen (dirList -> d_name) + 1;
+	}
+#endif
+	return loadBatch -> itemCount;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  S A V E  S T A T                                                                               *
+ *  ===================================                                                                               *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Copy a stat in to an entry, compact entries only keep the start of it.
+ *  \param saveEntry Entry to save the stat in.
+ *  \param fileStat Stat to copy.
+ *  \result None.
+ */
+#ifdef USE_STATX
+static void directorySaveStat (DIR_ENTRY *saveEntry, struct statx *fileStat)
+#else
+static void directorySaveStat (DIR_ENTRY *saveEntry, struct stat *fileStat)
+#endif
+{
+	memcpy (&saveEntry -> fileStat, fileStat, saveEntry -> statSize);
+#ifdef USE_STATX
+	if (saveEntry -> statSize < sizeof (struct statx))
+		saveEntry -> fileStat.stx_mask &= COMPACT_STAT_MASK;
+#endif
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  E X C L U D E  H O L D                                                                                            *
+ *  ======================                                                                                            *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Keep a list of exclude rules while a directory below it is read.
+ *  \param excludeList List to keep, may be NULL.
+ *  \result The list.
+ */
+static DIR_EXCLUDE_LIST *excludeHold (DIR_EXCLUDE_LIST *excludeList)
+{
+	if (excludeList != NULL)
+	{
+		__atomic_add_fetch (&excludeList -> refCount, 1, __ATOMIC_RELAXED);
+	}
+	return excludeList;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  E X C L U D E  R E L E A S E                                                                                      *
+ *  ============================                                                                                      *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Let go of a list of exclude rules, it is freed when no directory needs it.
+ *  \param excludeList List to let go of, may be NULL.
+ *  \result None.
+ */
+static void excludeRelease (DIR_EXCLUDE_LIST *excludeList)
+{
+	DIR_EXCLUDE_LIST *parentList;
+	int i;
+
+	while (excludeList != NULL && __atomic_sub_fetch (&excludeList -> refCount, 1, __ATOMIC_ACQ_REL) == 0)
+	{
+		parentList = excludeList -> parentList;
+		for (i = 0; i < excludeList -> ruleCount; ++i)
+		{
+			free (excludeList -> excludeRules[i].ruleText);
+		}
+		free (excludeList -> excludeRules);
+		free (excludeList);
+		excludeList = parentList;
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  E X C L U D E  A D D  R U L E                                                                                     *
+ *  =============================                                                                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Add a line in the form used by .gitignore to a list of exclude rules.
+ *  \param excludeList List to add to.
+ *  \param ruleLine The line, it need not end with a nul.
+ *  \param lineLen Length of the line.
+ *  \result True if a rule was added, false for blank lines, comments or no memory.
+ */
+static bool excludeAddRule (DIR_EXCLUDE_LIST *excludeList, char *ruleLine, int lineLen)
+{
+	DIR_EXCLUDE_RULE *newRule;
+	int ruleFlags = 0;
+	char *wildPtr;
+
+	/*------------------------------------------------------------------------*
+     * Trailing spaces are dropped unless quoted with a backslash             *
+     *------------------------------------------------------------------------*/
+	while (lineLen > 0 && (ruleLine[lineLen - 1] == '\n' || ruleLine[lineLen - 1] == '\r'))
+		--lineLen;
+	while (lineLen > 0 && ruleLine[lineLen - 1] == ' ' && (lineLen < 2 || ruleLine[lineLen - 2] != '\\'))
+		--lineLen;
+	if (lineLen == 0 || ruleLine[0] == '#')
+		return false;
+
+	if (ruleLine[0] == '!')
+	{
+		ruleFlags |= EXCLUDE_NEGATE;
+		++ruleLine;
+		--lineLen;
+	}
+	if (lineLen > 0 && ruleLine[lineLen - 1] == '/')
+	{
+		ruleFlags |= EXCLUDE_DIRONLY;
+		--lineLen;
+	}
+
+	/*------------------------------------------------------------------------*
+     * A '/' anywhere but the end ties the rule to the directory it was       *
+     * read from, otherwise it matches the name at any level                  *
+     *------------------------------------------------------------------------*/
+	if (memchr (ruleLine, '/', lineLen) != NULL)
+	{
+		ruleFlags |= EXCLUDE_ANCHORED;
+		if (ruleLine[0] == '/')
+		{
+			++ruleLine;
+			--lineLen;
+		}
+	}
+	if (lineLen <= 0)
+		return false;
+
+	if (excludeList -> ruleCount == excludeList -> ruleSize)
+	{
+		int newSize = (excludeList -> ruleSize ? excludeList -> ruleSize * 2 : 16);
+		DIR_EXCLUDE_RULE *newRules = realloc (excludeList -> excludeRules, newSize * sizeof (DIR_EXCLUDE_RULE));
+
+		if (newRules == NULL)
+			return false;
+
+		excludeList -> excludeRules = newRules;
+		excludeList -> ruleSize = newSize;
+	}
+	newRule = &excludeList -> excludeRules[excludeList -> ruleCount];
+	if ((newRule -> ruleText = malloc (lineLen + 1)) == NULL)
+		return false;
+
+	memcpy (newRule -> ruleText, ruleLine, lineLen);
+	newRule -> ruleText[lineLen] = 0;
+	newRule -> ruleFlags = ruleFlags;
+	newRule -> textLen = lineLen;
+	newRule -> ruleType = EXCLUDE_GLOB;
+
+	/*------------------------------------------------------------------------*
+     * Plain names and "*.ext" are compared without the glob                  *
+     *------------------------------------------------------------------------*/
+	if ((wildPtr = strpbrk (newRule -> ruleText, "*?[\\")) == NULL)
+	{
+		newRule -> ruleType = EXCLUDE_LITERAL;
+	}
+	else if (!(ruleFlags & EXCLUDE_ANCHORED) && wildPtr == newRule -> ruleText &&
+			strpbrk (&newRule -> ruleText[1], "*?[\\") == NULL)
+	{
+		newRule -> ruleType = EXCLUDE_SUFFIX;
+	}
+	++excludeList -> ruleCount;
+	return true;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  E X C L U D E  C L A S S                                                                                          *
+ *  ========================                                                                                          *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Match a character against a class such as [a-z] or [!0-9].
+ *  \param ptn Pattern, pointing at the '['.
+ *  \param ch Character to match.
+ *  \param classMatch Set true if the character is in the class.
+ *  \result Pointer to the closing ']', NULL if there is none.
+ */
+static char *excludeClass (char *ptn, char ch, bool *classMatch)
+{
+	bool negate = false;
+	char *firstPtr;
+
+	*classMatch = false;
+	if (*++ptn == '!' || *ptn == '^')
+	{
+		negate = true;
+		++ptn;
+	}
+	firstPtr = ptn;
+	while (*ptn && (*ptn != ']' || ptn == firstPtr))
+	{
+		unsigned char lowCh, highCh;
+
+		if (*ptn == '\\' && ptn[1])
+			++ptn;
+
+		lowCh = highCh = *ptn;
+		if (ptn[1] == '-' && ptn[2] && ptn[2] != ']')
+		{
+			ptn += 2;
+			if (*ptn == '\\' && ptn[1])
+				++ptn;
+			highCh = *ptn;
+		}
+		if ((unsigned char)ch >= lowCh && (unsigned char)ch <= highCh)
+			*classMatch = true;
+		++ptn;
+	}
+	if (*ptn != ']')
+		return NULL;
+
+	if (negate)
+		*classMatch = !*classMatch;
+	return ptn;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  E X C L U D E  G L O B                                                                                            *
+ *  ======================                                                                                            *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Match a name or path against a rule as .gitignore does, '*' stops at '/', '**' does not.
+ *  \param ptn The rule.
+ *  \param str Name or path to match.
+ *  \param segStart True if at the start of a part of the path.
+ *  \result True if it matches.
+ */
+static bool excludeGlob (char *ptn, char *str, bool segStart)
+{
+	bool classMatch;
+	char *classEnd;
+
+	while (*ptn)
+	{
+		switch (*ptn)
+		{
+		case '*':
+			if (ptn[1] == '*' && segStart && (ptn[2] == '/' || ptn[2] == 0))
+			{
+				if (ptn[2] == 0)
+					return true;
+
+				/*------------------------------------------------------------*
+                 * Two stars and a slash match any number of directories      *
+                 *------------------------------------------------------------*/
+				ptn += 3;
+				while (!excludeGlob (ptn, str, true))
+				{
+					if ((str = strchr (str, '/')) == NULL)
+						return false;
+					++str;
+				}
+				return true;
+			}
+			while (*ptn == '*')
+				++ptn;
+			while (!excludeGlob (ptn, str, false))
+			{
+				if (*str == 0 || *str == '/')
+					return false;
+				++str;
+			}
+			return true;
+
+		case '?':
+			if (*str == 0 || *str == '/')
+				return false;
+			break;
+
+		case '[':
+			if (*str == 0 || *str == '/')
+				return false;
+			if ((classEnd = excludeClass (ptn, *str, &classMatch)) == NULL)
+			{
+				if (*str != '[')
+					return false;
+			}
+			else if (!classMatch)
+			{
+				return false;
+			}
+			else
+			{
+				ptn = classEnd;
+			}
+			break;
+
+		case '\\':
+			if (ptn[1])
+				++ptn;
+			/* fall through */
+		default:
+			if (*ptn != *str)
+				return false;
+			break;
+		}
+		segStart = (*ptn == '/');
+		++ptn;
+		++str;
+	}
+	return (*str == 0);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  E X C L U D E  L O A D  F I L E                                                                                   *
+ *  ===============================                                                                                   *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Read the exclude rules file from a directory, see directorySetExcludeFile.
+ *  \param dirFd The open directory.
+ *  \param partPath Path of the directory as it goes into sub directories.
+ *  \param parentList Rules of the parent directory, these still apply.
+ *  \result The rules for this directory, release with excludeRelease.
+ */
+static DIR_EXCLUDE_LIST *excludeLoadFile (int dirFd, char *partPath, DIR_EXCLUDE_LIST *parentList)
+{
+	DIR_EXCLUDE_LIST *excludeList;
+	struct stat fileStat;
+	char *fileData, *linePtr, *lineEnd;
+	int fileFd, partLen = strlen (partPath);
+	ssize_t readSize;
+
+	if (excludeName == NULL || (fileFd = openat (dirFd, excludeName, O_RDONLY | O_CLOEXEC)) == -1)
+		return excludeHold (parentList);
+
+	if (fstat (fileFd, &fileStat) != 0 || !S_ISREG (fileStat.st_mode) ||
+			(excludeList = calloc (1, sizeof (DIR_EXCLUDE_LIST) + partLen + 1)) == NULL)
+	{
+		close (fileFd);
+		return excludeHold (parentList);
+	}
+	if ((fileData = malloc (fileStat.st_size + 1)) != NULL)
+	{
+		readSize = read (fileFd, fileData, fileStat.st_size);
+		fileData[readSize > 0 ? readSize : 0] = 0;
+		for (linePtr = fileData; *linePtr; linePtr = lineEnd)
+		{
+			if ((lineEnd = strchr (linePtr, '\n')) == NULL)
+				lineEnd = &linePtr[strlen (linePtr)];
+			else
+				++lineEnd;
+			excludeAddRule (excludeList, linePtr, lineEnd - linePtr);
+		}
+		free (fileData);
+	}
+	close (fileFd);
+
+	if (excludeList -> ruleCount == 0)
+	{
+		free (excludeList -> excludeRules);
+		free (excludeList);
+		return excludeHold (parentList);
+	}
+	excludeList -> basePath = strcpy ((char *)&excludeList[1], partPath);
+	excludeList -> baseLen = partLen;
+	excludeList -> refCount = 1;
+	excludeList -> parentList = excludeHold (parentList);
+	return excludeList;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  E X C L U D E  M A T C H  L I S T                                                                                 *
+ *  =================================                                                                                 *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Find the last rule in a list that matches a name, later rules override earlier ones.
+ *  \param excludeList List of rules.
+ *  \param relPath Path from the directory the rules were read in, NULL if not below it.
+ *  \param fileName Name to match.
+ *  \param nameLen Length of the name.
+ *  \param isDir True if the name is a directory.
+ *  \result True if excluded, false if included again by a '!', EXCLUDE_NO_MATCH if no rule matched.
+ */
+static int excludeMatchList (DIR_EXCLUDE_LIST *excludeList, char *relPath, char *fileName, int nameLen, bool isDir)
+{
+	int i;
+
+	for (i = excludeList -> ruleCount - 1; i >= 0; --i)
+	{
+		DIR_EXCLUDE_RULE *excludeRule = &excludeList -> excludeRules[i];
+		bool ruleMatch;
+
+		if (excludeRule -> ruleFlags & EXCLUDE_DIRONLY && !isDir)
+			continue;
+
+		if (excludeRule -> ruleFlags & EXCLUDE_ANCHORED)
+		{
+			if (relPath == NULL)
+				continue;
+			if (excludeRule -> ruleType == EXCLUDE_LITERAL)
+				ruleMatch = (strcmp (relPath, excludeRule -> ruleText) == 0);
+			else
+				ruleMatch = excludeGlob (excludeRule -> ruleText, relPath, true);
+		}
+		else if (excludeRule -> ruleType == EXCLUDE_LITERAL)
+		{
+			ruleMatch = (nameLen == excludeRule -> textLen && memcmp (fileName, excludeRule -> ruleText, nameLen) == 0);
+		}
+		else if (excludeRule -> ruleType == EXCLUDE_SUFFIX)
+		{
+			ruleMatch = (nameLen >= excludeRule -> textLen - 1 && memcmp (&fileName[nameLen - excludeRule -> textLen + 1],
+					&excludeRule -> ruleText[1], excludeRule -> textLen - 1) == 0);
+		}
+		else
+		{
+			ruleMatch = excludeGlob (excludeRule -> ruleText, fileName, true);
+		}
+		if (ruleMatch)
+			return !(excludeRule -> ruleFlags & EXCLUDE_NEGATE);
+	}
+	return EXCLUDE_NO_MATCH;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  E X C L U D E  C H E C K                                                                                          *
+ *  ========================                                                                                          *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Check if a name is excluded by the rules given to the library or read from the directories.
+ *  \param excludeList Rules read from the directory and those above it.
+ *  \param findFlags Flags for the load, HIDEVERCTL adds the version control rules.
+ *  \param partPath Path of the directory as it goes into sub directories.
+ *  \param fileName Name to check.
+ *  \param isDir True if the name is a directory.
+ *  \result True if it is excluded.
+ */
+static bool excludeCheck (DIR_EXCLUDE_LIST *excludeList, int findFlags, char *partPath, char *fileName, bool isDir)
+{
+	char relPath[PATH_SIZE], *pathPtr = NULL;
+	int nameLen = strlen (fileName), partLen = strlen (partPath), retn;
+
+	if (partLen + nameLen < PATH_SIZE)
+	{
+		memcpy (relPath, partPath, partLen);
+		strcpy (&relPath[partLen], fileName);
+		pathPtr = relPath;
+	}
+
+	/*------------------------------------------------------------------------*
+     * Rules given to the library come first, then those to hide version      *
+     * control, then those read from the closest directory up to the top      *
+     *------------------------------------------------------------------------*/
+	if ((retn = excludeMatchList (&excludeGlobal, pathPtr, fileName, nameLen, isDir)) != EXCLUDE_NO_MATCH)
+		return retn;
+
+	if (findFlags & HIDEVERCTL &&
+			(retn = excludeMatchList (&excludeVerCtl, pathPtr, fileName, nameLen, isDir)) != EXCLUDE_NO_MATCH)
+		return retn;
+
+	for (; excludeList != NULL; excludeList = excludeList -> parentList)
+	{
+		char *listPath = NULL;
+
+		if (pathPtr != NULL && strncmp (partPath, excludeList -> basePath, excludeList -> baseLen) == 0)
+			listPath = &pathPtr[excludeList -> baseLen];
+
+		if ((retn = excludeMatchList (excludeList, listPath, fileName, nameLen, isDir)) != EXCLUDE_NO_MATCH)
+			return retn;
+	}
+	return false;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  S O R T  B A T C H                                                                             *
+ *  =====================================                                                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Decide what each name in the batch is needed for, and if we have to stat it.
+ *  \param loadInfo Settings for this load, pattern, flags and compare function.
+ *  \param loadBatch Batch of names read from the directory.
+ *  \param dirPath The path to the directory being read, ends with a '/'.
+ *  \param partPath Path as it goes into sub directories.
+ *  \param fileList Where to save the directory.
+ *  \param excludeList Exclude rules for this directory.
+ *  \result None.
+ */
+static void directorySortBatch (DIR_LOAD_INFO *loadInfo, DIR_LOAD_BATCH *loadBatch, char *dirPath, char *partPath,
+		void *fileList, DIR_EXCLUDE_LIST *excludeList)
+{
+	int i, findFlags = loadInfo -> findFlags;
+	void *entryArena = (loadInfo -> StreamFile == NULL && loadInfo -> dirWatch == NULL &&
+			loadInfo -> topHeap == NULL ? fileList : NULL);
+
+	for (i = 0; i < loadBatch -> itemCount; ++i)
+	{
+		DIR_LOAD_ITEM *loadItem = &loadBatch -> loadItems[i];
+		char *fileName = loadItem -> fileName;
+		int nameType = getDirentType (loadItem -> dirType);
+
+		loadItem -> fileMode = DTTOIF (loadItem -> dirType);
+
+		/*--------------------------------------------------------------------*
+         * Excluded names are neither kept nor read, if the directory did     *
+         * not give the type they are checked once it has been read           *
+         *--------------------------------------------------------------------*/
+		if ((excludeList != NULL || excludeGlobal.ruleCount || findFlags & HIDEVERCTL) &&
+				strcmp (fileName, ".") && strcmp (fileName, ".."))
+		{
+			if (loadItem -> dirType == DT_UNKNOWN)
+			{
+				loadItem -> itemFlags |= ITEM_CHECK_EXCLUDE;
+			}
+			else if (excludeCheck (excludeList, findFlags, partPath, fileName, nameType == ONLYDIRS))
+			{
+				continue;
+			}
+		}
+
+		/*--------------------------------------------------------------------*
+         * Recursive directories, avoid '.' and '..', only the types that     *
+         * might lead to a directory are looked at                            *
+         *--------------------------------------------------------------------*/
+		if (findFlags & RECUDIR && (fileName[0] != '.' || findFlags & SHOWALL) &&
+				strcmp (fileName, ".") && strcmp (fileName, ".."))
+		{
+			if (loadItem -> dirType == DT_UNKNOWN)
+			{
+				loadItem -> itemFlags |= ITEM_RECURSE | ITEM_NEED_STAT;
+			}
+			else if (nameType & ONLYDIRS || (nameType & ONLYLINKS && findFlags & RECULINK))
+			{
+				loadItem -> itemFlags |= ITEM_RECURSE;
+			}
+		}
+
+		/*--------------------------------------------------------------------*
+         * Does this file match our pattern, the type from the directory can  *
+         * reject it without a stat                                           *
+         *--------------------------------------------------------------------*/
+		if (nameType & findFlags && matchExec (loadInfo -> fileMatch, fileName))
+		{
+			size_t entrySize = (findFlags & COMPACTSTAT ? COMPACT_ENTRY_SIZE : sizeof (DIR_ENTRY));
+			DIR_ENTRY *saveEntry = (entryArena != NULL ? queueAlloc (entryArena, entrySize) : malloc (entrySize));
+
+			if (saveEntry != NULL)
+			{
+				memset (saveEntry, 0, entrySize);
+				saveEntry -> entryArena = entryArena;
+				saveEntry -> statSize = entrySize - offsetof (DIR_ENTRY, fileStat);
+				saveEntry -> fileName = directoryAlloc (saveEntry, strlen (fileName) + 1);
+
+				/*------------------------------------------------------------*
+                 * Entries in an arena share one copy of the directory paths, *
+                 * streamed, watched and top entries are freed one by one so  *
+                 * have their own                                             *
+                 *------------------------------------------------------------*/
+				if (entryArena != NULL)
+				{
+					if (loadBatch -> fullPath == NULL)
+					{
+						int fullLen = strlen (dirPath) + 1;
+
+						loadBatch -> fullPath = queueAlloc (entryArena, fullLen + strlen (partPath) + 1);
+						if (loadBatch -> fullPath != NULL)
+						{
+							loadBatch -> partPath = &loadBatch -> fullPath[fullLen];
+							strcpy (loadBatch -> fullPath, dirPath);
+							strcpy (loadBatch -> partPath, partPath);
+						}
+					}
+					saveEntry -> fullPath = loadBatch -> fullPath;
+					saveEntry -> partPath = loadBatch -> partPath;
+				}
+				else
+				{
+					if ((saveEntry -> fullPath = malloc (strlen (dirPath) + 1)) != NULL)
+						strcpy (saveEntry -> fullPath, dirPath);
+					if ((saveEntry -> partPath = malloc (strlen (partPath) + 1)) != NULL)
+						strcpy (saveEntry -> partPath, partPath);
+				}
+
+				/*------------------------------------------------------------*
+                 * Out of memory, an entry without its names is not kept      *
+                 *------------------------------------------------------------*/
+				if (saveEntry -> fileName == NULL || saveEntry -> fullPath == NULL || saveEntry -> partPath == NULL)
+				{
+					directoryFreeEntry (saveEntry);
+					saveEntry = NULL;
+				}
+			}
+			if (saveEntry != NULL)
+			{
+				strcpy (saveEntry -> fileName, fileName);
+				saveEntry -> match = 0;
+				saveEntry -> Compare = (comparePtr *)loadInfo -> Compare;
+				loadItem -> saveEntry = saveEntry;
+
+				/*------------------------------------------------------------*
+                 * If the caller only needs the type then trust the directory *
+                 * unless we must tell executables from other files           *
+                 *------------------------------------------------------------*/
+				if (loadItem -> cacheStat != NULL && loadItem -> cacheSize >= saveEntry -> statSize &&
+						(loadItem -> cacheMask & loadInfo -> statMask) == loadInfo -> statMask)
+				{
+					directorySaveStat (saveEntry, (void *)loadItem -> cacheStat);
+					loadItem -> itemFlags |= ITEM_HAVE_STAT;
+				}
+				else if (!(findFlags & SKIPSTAT) || loadItem -> dirType == DT_UNKNOWN ||
+						(nameType == ONLYFILES && (findFlags & ONLYFILES) != ONLYFILES))
+				{
+					loadItem -> itemFlags |= ITEM_NEED_STAT;
+				}
+				else
+				{
+#ifdef USE_STATX
+					saveEntry -> fileStat.stx_mask = STATX_TYPE;
+					saveEntry -> fileStat.stx_mode = DTTOIF (loadItem -> dirType);
+#else
+					saveEntry -> fileStat.st_mode = DTTOIF (loadItem -> dirType);
+#endif
+				}
+			}
+		}
+	}
+}
+
+#ifdef USE_URING
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  S T A T  R I N G  D E L E T E                                                                                     *
+ *  =============================                                                                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Unmap and close an io_uring created by statRingCreate.
+ *  \param statRing Ring to delete, may be NULL.
+ *  \result None.
+ */
+static void statRingDelete (DIR_STAT_RING *statRing)
+{
+	if (statRing != NULL)
+	{
+		/*--------------------------------------------------------------------*
+         * The kernel may still write the stats it owes, if it will not say   *
+         * it is done they are left to it rather than freed                   *
+         *--------------------------------------------------------------------*/
+		if (statRingDrain (statRing))
+			free (statRing -> ringStats);
+
+		if (statRing -> sqEntries != MAP_FAILED)
+			munmap (statRing -> sqEntries, statRing -> sqeSize);
+		if (statRing -> cqRingPtr != MAP_FAILED && statRing -> cqRingPtr != statRing -> sqRingPtr)
+			munmap (statRing -> cqRingPtr, statRing -> cqRingSize);
+		if (statRing -> sqRingPtr != MAP_FAILED)
+			munmap (statRing -> sqRingPtr, statRing -> sqRingSize);
+		close (statRing -> ringFd);
+		free (statRing);
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  S T A T  R I N G  C R E A T E                                                                                     *
+ *  =============================                                                                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Set up an io_uring for statx, the kernel is only asked the first time.
+ *  \result The ring, or NULL if the kernel cannot do statx through io_uring.
+ */
+static DIR_STAT_RING *statRingCreate (void)
+{
+	struct io_uring_params ringParams;
+	struct io_uring_probe *ringProbe;
+	DIR_STAT_RING *statRing;
+	bool statSupported = false;
+
+	if (__atomic_load_n (&uringState, __ATOMIC_RELAXED) < 0)
+		return NULL;
+
+	if ((statRing = calloc (1, sizeof (DIR_STAT_RING))) == NULL)
+		return NULL;
+
+	memset (&ringParams, 0, sizeof (ringParams));
+	if ((statRing -> ringFd = syscall (SYS_io_uring_setup, STAT_RING_SIZE, &ringParams)) < 0)
+	{
+		__atomic_store_n (&uringState, -1, __ATOMIC_RELAXED);
+		free (statRing);
+		return NULL;
+	}
+
+	/*------------------------------------------------------------------------*
+     * Map the submission and completion rings in to our memory               *
+     *------------------------------------------------------------------------*/
+	statRing -> ringEntries = ringParams.sq_entries;
+	statRing -> sqRingSize = ringParams.sq_off.array + ringParams.sq_entries * sizeof (unsigned int);
+	statRing -> cqRingSize = ringParams.cq_off.cqes + ringParams.cq_entries * sizeof (struct io_uring_cqe);
+	statRing -> sqeSize = ringParams.sq_entries * sizeof (struct io_uring_sqe);
+	if (ringParams.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (statRing -> cqRingSize > statRing -> sqRingSize)
+			statRing -> sqRingSize = statRing -> cqRingSize;
+	}
+	statRing -> sqRingPtr = mmap (NULL, statRing -> sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			statRing -> ringFd, IORING_OFF_SQ_RING);
+	statRing -> cqRingPtr = statRing -> sqRingPtr;
+	if (!(ringParams.features & IORING_FEAT_SINGLE_MMAP))
+	{
+		statRing -> cqRingPtr = mmap (NULL, statRing -> cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				statRing -> ringFd, IORING_OFF_CQ_RING);
+	}
+	statRing -> sqEntries = mmap (NULL, statRing -> sqeSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			statRing -> ringFd, IORING_OFF_SQES);
+	statRing -> ringStats = malloc (statRing -> ringEntries * sizeof (struct statx));
+
+	if (statRing -> sqRingPtr == MAP_FAILED || statRing -> cqRingPtr == MAP_FAILED || statRing -> sqEntries == MAP_FAILED ||
+			statRing -> ringStats == NULL)
+	{
+		statRingDelete (statRing);
+		return NULL;
+	}
+	statRing -> sqHead = (unsigned int *)((char *)statRing -> sqRingPtr + ringParams.sq_off.head);
+	statRing -> sqTail = (unsigned int *)((char *)statRing -> sqRingPtr + ringParams.sq_off.tail);
+	statRing -> sqMask = (unsigned int *)((char *)statRing -> sqRingPtr + ringParams.sq_off.ring_mask);
+	statRing -> sqArray = (unsigned int *)((char *)statRing -> sqRingPtr + ringParams.sq_off.array);
+	statRing -> cqHead = (unsigned int *)((char *)statRing -> cqRingPtr + ringParams.cq_off.head);
+	statRing -> cqTail = (unsigned int *)((char *)statRing -> cqRingPtr + ringParams.cq_off.tail);
+	statRing -> cqMask = (unsigned int *)((char *)statRing -> cqRingPtr + ringParams.cq_off.ring_mask);
+	statRing -> cqEntries = (struct io_uring_cqe *)((char *)statRing -> cqRingPtr + ringParams.cq_off.cqes);
+
+	/*------------------------------------------------------------------------*
+     * Older kernels have io_uring but not statx, ask before we use it        *
+     *------------------------------------------------------------------------*/
+	if (__atomic_load_n (&uringState, __ATOMIC_RELAXED) == 0)
+	{
+		if ((ringProbe = calloc (1, sizeof (struct io_uring_probe) + 256 * sizeof (struct io_uring_probe_op))) != NULL)
+		{
+			if (syscall (SYS_io_uring_register, statRing -> ringFd, IORING_REGISTER_PROBE, ringProbe, 256) == 0)
+			{
+				if (ringProbe -> last_op >= IORING_OP_STATX &&
+						ringProbe -> ops[IORING_OP_STATX].flags & IO_URING_OP_SUPPORTED)
+				{
+					statSupported = true;
+				}
+			}
+			free (ringProbe);
+		}
+		if (!statSupported)
+		{
+			__atomic_store_n (&uringState, -1, __ATOMIC_RELAXED);
+			statRingDelete (statRing);
+			return NULL;
+		}
+		__atomic_store_n (&uringState, 1, __ATOMIC_RELAXED);
+	}
+	return statRing;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  S T A T  R I N G  R E A P                                                                                         *
+ *  =========================                                                                                         *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Fill in the items for the stats the kernel has finished.
+ *  \param statRing Ring the stats were submitted to, the kernel wrote them in to its stats.
+ *  \param loadBatch Batch the stats are for.
+ *  \result The number of completions taken from the ring.
+ */
+static unsigned int statRingReap (DIR_STAT_RING *statRing, DIR_LOAD_BATCH *loadBatch)
+{
+	unsigned int cqHead = *statRing -> cqHead, reaped = 0;
+	unsigned int cqTail = __atomic_load_n (statRing -> cqTail, __ATOMIC_ACQUIRE);
+
+	while (cqHead != cqTail)
+	{
+		struct io_uring_cqe *ringDone = &statRing -> cqEntries[cqHead & *statRing -> cqMask];
+		DIR_LOAD_ITEM *loadItem = &loadBatch -> loadItems[ringDone -> user_data & RING_ITEM_MASK];
+		struct statx *ringStat = &statRing -> ringStats[ringDone -> user_data >> RING_SLOT_SHIFT];
+
+		if (ringDone -> res < 0)
+		{
+			loadItem -> statError = -ringDone -> res;
+		}
+		else
+		{
+			loadItem -> fileMode = ringStat -> stx_mode;
+			if (loadItem -> saveEntry != NULL)
+			{
+				directorySaveStat (loadItem -> saveEntry, ringStat);
+				loadItem -> itemFlags |= ITEM_HAVE_STAT;
+			}
+		}
+		loadItem -> itemFlags |= ITEM_RING_DONE;
+		++cqHead;
+		++reaped;
+	}
+	__atomic_store_n (statRing -> cqHead, cqHead, __ATOMIC_RELEASE);
+	return reaped;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  S T A T  R I N G  W A I T                                                                                         *
+ *  =========================                                                                                         *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Submit and wait for stats, trying again while the kernel is interrupted or busy.
+ *  \param statRing Ring the stats were submitted to.
+ *  \param toSubmit Number of new stats to hand to the kernel.
+ *  \param waitFor Number of completions to wait for.
+ *  \result Number of stats submitted, or -1 with errno set.
+ */
+static long statRingWait (DIR_STAT_RING *statRing, unsigned int toSubmit, unsigned int waitFor)
+{
+	long ringRetn;
+	int busyCount = 0;
+
+	while ((ringRetn = syscall (SYS_io_uring_enter, statRing -> ringFd, toSubmit, waitFor,
+			IORING_ENTER_GETEVENTS, NULL, 0)) < 0)
+	{
+		/*--------------------------------------------------------------------*
+         * A full completion ring or short of memory is worth another go      *
+         *--------------------------------------------------------------------*/
+		if (errno == EINTR)
+			continue;
+		if ((errno != EAGAIN && errno != EBUSY) || ++busyCount > STAT_RING_BUSY)
+			break;
+		sched_yield ();
+	}
+	return ringRetn;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  S T A T  R I N G  D R A I N                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Wait for and throw away the stats still owed from a batch the ring gave up on.
+ *  \param statRing Ring to drain.
+ *  \result True if nothing is owed, false if the kernel still has some.
+ */
+static bool statRingDrain (DIR_STAT_RING *statRing)
+{
+	while (statRing -> ringOwed)
+	{
+		unsigned int cqHead = *statRing -> cqHead;
+		unsigned int cqTail = __atomic_load_n (statRing -> cqTail, __ATOMIC_ACQUIRE);
+
+		statRing -> ringOwed -= (cqTail - cqHead < statRing -> ringOwed ? cqTail - cqHead : statRing -> ringOwed);
+		__atomic_store_n (statRing -> cqHead, cqTail, __ATOMIC_RELEASE);
+		if (statRing -> ringOwed && statRingWait (statRing, 0, statRing -> ringOwed) < 0)
+			return false;
+	}
+	return true;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  S T A T  R I N G  S T A T  B A T C H                                                                              *
+ *  ====================================                                                                              *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Stat the names in the batch that need it by submitting them all to the io_uring at once.
+ *  \param loadBatch Batch of names read from the directory, stats are relative to its open directory.
+ *  \param statMask The statx fields the caller needs.
+ *  \result The number of items dealt with, any after this not marked done must be done without the ring.
+ */
+static int statRingStatBatch (DIR_LOAD_BATCH *loadBatch, unsigned int statMask)
+{
+	DIR_STAT_RING *statRing;
+	int i, needStat = 0, chunkStart = 0;
+
+	for (i = 0; i < loadBatch -> itemCount; ++i)
+	{
+		if (loadBatch -> loadItems[i].itemFlags & ITEM_NEED_STAT)
+			++needStat;
+	}
+	if (needStat < STAT_RING_MIN || loadBatch -> statRing == NULL || __atomic_load_n (&uringState, __ATOMIC_RELAXED) < 0)
+		return 0;
+
+	if ((statRing = *loadBatch -> statRing) == NULL)
+	{
+		if ((statRing = *loadBatch -> statRing = statRingCreate ()) == NULL)
+			return 0;
+	}
+
+	/*------------------------------------------------------------------------*
+     * Stats owed from an earlier batch use the ring's stats, they must be    *
+     * done before it is used again                                           *
+     *------------------------------------------------------------------------*/
+	if (!statRingDrain (statRing))
+		return 0;
+
+	while (chunkStart < loadBatch -> itemCount)
+	{
+		unsigned int sqTail = *statRing -> sqTail, sqStart = sqTail, submitted = 0, reaped = 0, toSubmit;
+		long ringRetn = 0;
+		int ringError = 0;
+
+		/*--------------------------------------------------------------------*
+         * Fill the submission ring with as many stats as it will take, each  *
+         * is written in to the ring's stats for its slot                     *
+         *--------------------------------------------------------------------*/
+		for (i = chunkStart; i < loadBatch -> itemCount && submitted < statRing -> ringEntries; ++i)
+		{
+			DIR_LOAD_ITEM *loadItem = &loadBatch -> loadItems[i];
+			struct io_uring_sqe *ringEntry;
+			unsigned int ringIndex = sqTail & *statRing -> sqMask;
+
+			if (!(loadItem -> itemFlags & ITEM_NEED_STAT))
+				continue;
+
+			ringEntry = &statRing -> sqEntries[ringIndex];
+			memset (ringEntry, 0, sizeof (struct io_uring_sqe));
+			ringEntry -> opcode = IORING_OP_STATX;
+			ringEntry -> fd = loadBatch -> dirFd;
+			ringEntry -> addr = (unsigned long)loadItem -> fileName;
+			ringEntry -> len = statMask;
+			ringEntry -> off = (unsigned long)&statRing -> ringStats[ringIndex];
+			ringEntry -> statx_flags = AT_SYMLINK_NOFOLLOW;
+			ringEntry -> user_data = ((unsigned long long)ringIndex << RING_SLOT_SHIFT) | (unsigned int)i;
+			statRing -> sqArray[ringIndex] = ringIndex;
+			++sqTail;
+			++submitted;
+		}
+		__atomic_store_n (statRing -> sqTail, sqTail, __ATOMIC_RELEASE);
+
+		/*--------------------------------------------------------------------*
+         * Fill in the items as the completions arrive                        *
+         *--------------------------------------------------------------------*/
+		toSubmit = submitted;
+		while (reaped < submitted)
+		{
+			reaped += statRingReap (statRing, loadBatch);
+			if (reaped < submitted)
+			{
+				if ((ringRetn = statRingWait (statRing, toSubmit, submitted - reaped)) < 0)
+				{
+					ringError = errno;
+					break;
+				}
+				toSubmit -= ringRetn;
+			}
+		}
+		if (ringError)
+		{
+			/*----------------------------------------------------------------*
+             * Take back the stats the kernel did not take, then wait for     *
+             * those it did                                                   *
+             *----------------------------------------------------------------*/
+			unsigned int sqHead = __atomic_load_n (statRing -> sqHead, __ATOMIC_ACQUIRE);
+			unsigned int inFlight = sqHead - sqStart;
+
+			__atomic_store_n (statRing -> sqTail, sqHead, __ATOMIC_RELEASE);
+			while (reaped < inFlight)
+			{
+				reaped += statRingReap (statRing, loadBatch);
+				if (reaped < inFlight && statRingWait (statRing, 0, inFlight - reaped) < 0)
+					break;
+			}
+
+			/*----------------------------------------------------------------*
+             * Any the kernel still has only write to the ring's stats, the   *
+             * ring keeps them owed and the items are stated without it       *
+             *----------------------------------------------------------------*/
+			statRing -> ringOwed = inFlight - reaped;
+
+			/*----------------------------------------------------------------*
+             * Only give up on io_uring if the kernel would not take the      *
+             * stats at all, not when it was just too busy                    *
+             *----------------------------------------------------------------*/
+			if (ringError != EAGAIN && ringError != EBUSY)
+				__atomic_store_n (&uringState, -1, __ATOMIC_RELAXED);
+			return chunkStart;
+		}
+		chunkStart = i;
+	}
+	return loadBatch -> itemCount;
+}
+#endif
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  S T A T  B A T C H                                                                             *
+ *  =====================================                                                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Stat the names in the batch that need it, the results go in the entry if it is kept.
+ *  \param loadBatch Batch of names read from the directory, stats are relative to its open directory.
+ *  \param statMask The statx fields the caller needs, not used by fstatat.
+ *  \result None.
+ */
+static void directoryStatBatch (DIR_LOAD_BATCH *loadBatch, unsigned int statMask)
+{
+	int i = 0;
+
+#ifdef USE_URING
+	i = statRingStatBatch (loadBatch, statMask);
+#endif
+	for (; i < loadBatch -> itemCount; ++i)
+	{
+		DIR_LOAD_ITEM *loadItem = &loadBatch -> loadItems[i];
+#ifdef USE_STATX
+		struct statx tempStat, *fileStat = &tempStat;
+#else
+		struct stat tempStat, *fileStat = &tempStat;
+#endif
+		if (!(loadItem -> itemFlags & ITEM_NEED_STAT) || loadItem -> itemFlags & ITEM_RING_DONE)
+			continue;
+
+		if (loadItem -> saveEntry != NULL && loadItem -> saveEntry -> statSize == sizeof (tempStat))
+			fileStat = &loadItem -> saveEntry -> fileStat;
+
+#ifdef USE_STATX
+		if (statx (loadBatch -> dirFd, loadItem -> fileName, AT_SYMLINK_NOFOLLOW, statMask, fileStat) == 0)
+			loadItem -> fileMode = fileStat -> stx_mode;
+#else
+		if (fstatat (loadBatch -> dirFd, loadItem -> fileName, fileStat, AT_SYMLINK_NOFOLLOW) == 0)
+			loadItem -> fileMode = fileStat -> st_mode;
+#endif
+		else
+		{
+			loadItem -> statError = errno;
+			continue;
+		}
+		if (loadItem -> saveEntry != NULL)
+		{
+			if (fileStat == &tempStat)
+				directorySaveStat (loadItem -> saveEntry, fileStat);
+			loadItem -> itemFlags |= ITEM_HAVE_STAT;
+		}
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C A C H E  D I R  K E Y                                                                                           *
+ *  =======================                                                                                           *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Make the key used to find an open directory in the cache.
+ *  \param dirStat Stat of the open directory.
+ *  \param cacheKey Where to save the device, inode and times.
+ *  \result None.
+ */
+static void cacheDirKey (struct stat *dirStat, DIR_CACHE_DIR *cacheKey)
+{
+	memset (cacheKey, 0, sizeof (DIR_CACHE_DIR));
+	cacheKey -> dirDev = dirStat -> st_dev;
+	cacheKey -> dirIno = dirStat -> st_ino;
+	cacheKey -> mtimeSec = dirStat -> st_mtim.tv_sec;
+	cacheKey -> mtimeNsec = dirStat -> st_mtim.tv_nsec;
+	cacheKey -> ctimeSec = dirStat -> st_ctim.tv_sec;
+	cacheKey -> ctimeNsec = dirStat -> st_ctim.tv_nsec;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C A C H E  H A S H                                                                                                *
+ *  ==================                                                                                                *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Work out where a directory goes in the cache hash table.
+ *  \param cacheKey Directory to hash.
+ *  \param hashSize Size of the hash table, a power of two.
+ *  \result Index in to the hash table.
+ */
+static unsigned int cacheHash (DIR_CACHE_DIR *cacheKey, unsigned int hashSize)
+{
+	unsigned long long hashVal = (cacheKey -> dirIno ^ (cacheKey -> dirDev << 32)) * 0x9E3779B97F4A7C15ULL;
+
+	return (unsigned int)(hashVal >> 32) & (hashSize - 1);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C A C H E  I N S E R T  D I R                                                                                     *
+ *  =============================                                                                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Add a directory to the cache hash table, replacing any with the same device and inode.
+ *  \param cacheDir Directory to add, the cache must be locked.
+ *  \result None.
+ */
+static void cacheInsertDir (DIR_CACHE_DIR *cacheDir)
+{
+	DIR_CACHE_DIR **prevDir;
+
+	/*------------------------------------------------------------------------*
+     * Keep the table no more than full, double it if it is                   *
+     *------------------------------------------------------------------------*/
+	if (dirCache -> dirCount >= dirCache -> hashSize)
+	{
+		DIR_CACHE_DIR **newTable;
+		unsigned int i, newSize = (dirCache -> hashSize == 0 ? CACHE_HASH_MIN : dirCache -> hashSize * 2);
+
+		if ((newTable = calloc (newSize, sizeof (DIR_CACHE_DIR *))) != NULL)
+		{
+			for (i = 0; i < dirCache -> hashSize; ++i)
+			{
+				DIR_CACHE_DIR *moveDir;
+
+				while ((moveDir = dirCache -> hashTable[i]) != NULL)
+				{
+					unsigned int hashIdx = cacheHash (moveDir, newSize);
+
+					dirCache -> hashTable[i] = moveDir -> nextDir;
+					moveDir -> nextDir = newTable[hashIdx];
+					newTable[hashIdx] = moveDir;
+				}
+			}
+			free (dirCache -> hashTable);
+			dirCache -> hashTable = newTable;
+			dirCache -> hashSize = newSize;
+		}
+		else if (dirCache -> hashSize == 0)
+		{
+			free (cacheDir -> dirData);
+			free (cacheDir);
+			return;
+		}
+	}
+
+	/*------------------------------------------------------------------------*
+     * Old listings may still be in use, free them when the cache is closed   *
+     *------------------------------------------------------------------------*/
+	prevDir = &dirCache -> hashTable[cacheHash (cacheDir, dirCache -> hashSize)];
+	while (*prevDir != NULL)
+	{
+		if ((*prevDir) -> dirIno == cacheDir -> dirIno && (*prevDir) -> dirDev == cacheDir -> dirDev)
+		{
+			DIR_CACHE_DIR *oldDir = *prevDir;
+
+			*prevDir = oldDir -> nextDir;
+			oldDir -> nextDir = dirCache -> oldDirs;
+			dirCache -> oldDirs = oldDir;
+			--dirCache -> dirCount;
+			break;
+		}
+		prevDir = &(*prevDir) -> nextDir;
+	}
+	cacheDir -> nextDir = *prevDir;
+	*prevDir = cacheDir;
+	++dirCache -> dirCount;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C A C H E  F I N D  D I R                                                                                         *
+ *  =========================                                                                                         *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Look for a directory in the cache, it is only returned if it has not changed.
+ *  \param cacheKey Device, inode and times of the directory.
+ *  \result The cached directory, NULL if not found or it has changed.
+ */
+static DIR_CACHE_DIR *cacheFindDir (DIR_CACHE_DIR *cacheKey)
+{
+	DIR_CACHE_DIR *cacheDir = NULL;
+
+	pthread_mutex_lock (&dirCache -> cacheMutex);
+	if (dirCache -> hashSize)
+	{
+		cacheDir = dirCache -> hashTable[cacheHash (cacheKey, dirCache -> hashSize)];
+		while (cacheDir != NULL)
+		{
+			if (cacheDir -> dirIno == cacheKey -> dirIno && cacheDir -> dirDev == cacheKey -> dirDev)
+			{
+				if (cacheDir -> mtimeSec != cacheKey -> mtimeSec || cacheDir -> mtimeNsec != cacheKey -> mtimeNsec ||
+						cacheDir -> ctimeSec != cacheKey -> ctimeSec || cacheDir -> ctimeNsec != cacheKey -> ctimeNsec)
+					cacheDir = NULL;
+				break;
+			}
+			cacheDir = cacheDir -> nextDir;
+		}
+	}
+	pthread_mutex_unlock (&dirCache -> cacheMutex);
+	return cacheDir;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C A C H E  R E A D  B A T C H                                                                                     *
+ *  =============================                                                                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Fill a batch with the next names from a cached directory, used in place of directoryReadBatch.
+ *  \param loadBatch Batch to fill, names point in to the cache.
+ *  \param cacheDir Cached directory to read.
+ *  \param readPos Offset of the next name in the cached data, updated.
+ *  \result The number of names read, 0 at the end of the directory.
+ */
+static int cacheReadBatch (DIR_LOAD_BATCH *loadBatch, DIR_CACHE_DIR *cacheDir, unsigned int *readPos)
+{
+	loadBatch -> itemCount = 0;
+	while (*readPos < cacheDir -> dataSize && loadBatch -> itemCount < DIR_BATCH_ITEMS)
+	{
+		DIR_LOAD_ITEM *loadItem = &loadBatch -> loadItems[loadBatch -> itemCount++];
+		DIR_CACHE_ITEM cacheItem;
+
+		memcpy (&cacheItem, &cacheDir -> dirData[*readPos], sizeof (DIR_CACHE_ITEM));
+		*readPos += sizeof (DIR_CACHE_ITEM);
+
+		memset (loadItem, 0, sizeof (DIR_LOAD_ITEM));
+		loadItem -> dirType = IFTODT (cacheItem.fileMode);
+		if (cacheItem.statSize)
+		{
+			loadItem -> cacheStat = &cacheDir -> dirData[*readPos];
+			loadItem -> cacheMask = cacheItem.statMask;
+			loadItem -> cacheSize = cacheItem.statSize;
+		}
+		loadItem -> fileName = &cacheDir -> dirData[*readPos + cacheItem.statSize];
+		*readPos += cacheItem.statSize + cacheItem.nameSize;
+	}
+	return loadBatch -> itemCount;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C A C H E  A D D  B A T C H                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Add a batch that has been sorted and stated to the listing being built for the cache.
+ *  \param cacheBuild Listing being built.
+ *  \param loadBatch Batch to add.
+ *  \param statMask The statx fields asked for when the batch was stated.
+ *  \result None.
+ */
+static void cacheAddBatch (DIR_CACHE_BUILD *cacheBuild, DIR_LOAD_BATCH *loadBatch, unsigned int statMask)
+{
+	int i;
+
+	for (i = 0; i < loadBatch -> itemCount && !cacheBuild -> buildFailed; ++i)
+	{
+		DIR_LOAD_ITEM *loadItem = &loadBatch -> loadItems[i];
+		DIR_CACHE_ITEM cacheItem;
+		char *statPtr = NULL;
+
+		memset (&cacheItem, 0, sizeof (DIR_CACHE_ITEM));
+		cacheItem.nameSize = strlen (loadItem -> fileName) + 1;
+		cacheItem.fileMode = loadItem -> fileMode;
+
+		/*--------------------------------------------------------------------*
+         * Keep a stat made by this read, else any from the last one          *
+         *--------------------------------------------------------------------*/
+		if ((loadItem -> itemFlags & (ITEM_NEED_STAT | ITEM_HAVE_STAT)) == (ITEM_NEED_STAT | ITEM_HAVE_STAT))
+		{
+			statPtr = (char *)&loadItem -> saveEntry -> fileStat;
+			cacheItem.statSize = loadItem -> saveEntry -> statSize;
+			cacheItem.statMask = statMask;
+		}
+		else if (loadItem -> cacheStat != NULL)
+		{
+			statPtr = loadItem -> cacheStat;
+			cacheItem.statSize = loadItem -> cacheSize;
+			cacheItem.statMask = loadItem -> cacheMask;
+		}
+		if (loadItem -> itemFlags & ITEM_NEED_STAT)
+			++cacheBuild -> statCount;
+
+		if (cacheBuild -> dataSize + sizeof (DIR_CACHE_ITEM) + cacheItem.statSize + cacheItem.nameSize >
+				cacheBuild -> bufferSize)
+		{
+			unsigned int newSize = (cacheBuild -> bufferSize == 0 ? DIR_BATCH_SIZE : cacheBuild -> bufferSize * 2);
+			char *newData = realloc (cacheBuild -> buildData, newSize);
+
+			if (newData == NULL)
+			{
+				cacheBuild -> buildFailed = true;
+				break;
+			}
+			cacheBuild -> buildData = newData;
+			cacheBuild -> bufferSize = newSize;
+		}
+		memcpy (&cacheBuild -> buildData[cacheBuild -> dataSize], &cacheItem, sizeof (DIR_CACHE_ITEM));
+		cacheBuild -> dataSize += sizeof (DIR_CACHE_ITEM);
+		if (statPtr != NULL)
+		{
+			memcpy (&cacheBuild -> buildData[cacheBuild -> dataSize], statPtr, cacheItem.statSize);
+			cacheBuild -> dataSize += cacheItem.statSize;
+		}
+		memcpy (&cacheBuild -> buildData[cacheBuild -> dataSize], loadItem -> fileName, cacheItem.nameSize);
+		cacheBuild -> dataSize += cacheItem.nameSize;
+		++cacheBuild -> itemCount;
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C A C H E  S T O R E  D I R                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Save a listing that was built in to the cache, if it is new and can be trusted.
+ *  \param cacheKey Device, inode and times of the directory, read before it was listed.
+ *  \param cacheBuild Listing that was built, its data is used or freed.
+ *  \param dirFound True if the listing was read from the cache.
+ *  \result None.
+ */
+static void cacheStoreDir (DIR_CACHE_DIR *cacheKey, DIR_CACHE_BUILD *cacheBuild, bool dirFound)
+{
+	DIR_CACHE_DIR *cacheDir;
+
+	/*------------------------------------------------------------------------*
+     * A directory changed in the last second may change again without its    *
+     * times changing, so it is not kept                                      *
+     *------------------------------------------------------------------------*/
+	if (cacheBuild -> buildFailed || (dirFound && cacheBuild -> statCount == 0) ||
+			cacheKey -> mtimeSec >= time (NULL) - 1 || cacheKey -> ctimeSec >= time (NULL) - 1 ||
+			(cacheDir = malloc (sizeof (DIR_CACHE_DIR))) == NULL)
+	{
+		free (cacheBuild -> buildData);
+		return;
+	}
+	memcpy (cacheDir, cacheKey, sizeof (DIR_CACHE_DIR));
+	cacheDir -> itemCount = cacheBuild -> itemCount;
+	cacheDir -> dataSize = cacheBuild -> dataSize;
+	cacheDir -> dirData = cacheBuild -> buildData;
+
+	pthread_mutex_lock (&dirCache -> cacheMutex);
+	cacheInsertDir (cacheDir);
+	dirCache -> cacheChanged = true;
+	pthread_mutex_unlock (&dirCache -> cacheMutex);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  W A T C H  H A S H  P A T H                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Work out where a directory path goes in the watch hash table.
+ *  \param dirPath Path to hash.
+ *  \param hashSize Size of the hash table, a power of two.
+ *  \result Index in to the hash table.
+ */
+static unsigned int watchHashPath (char *dirPath, unsigned int hashSize)
+{
+	unsigned int hashVal = 2166136261U;
+
+	while (*dirPath)
+	{
+		hashVal = (hashVal ^ (unsigned char)*dirPath++) * 16777619U;
+	}
+	return hashVal & (hashSize - 1);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  W A T C H  F I N D  D I R                                                                                         *
+ *  =========================                                                                                         *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Find a watched directory from its path.
+ *  \param dirWatch Tree being watched.
+ *  \param dirPath The path to the directory, ends with a '/'.
+ *  \result The directory, NULL if it is not watched.
+ */
+static DIR_WATCH_DIR *watchFindDir (DIR_WATCH *dirWatch, char *dirPath)
+{
+	DIR_WATCH_DIR *watchDir = NULL;
+
+	if (dirWatch -> hashSize)
+	{
+		watchDir = dirWatch -> pathHash[watchHashPath (dirPath, dirWatch -> hashSize)];
+		while (watchDir != NULL && strcmp (watchDir -> dirPath, dirPath) != 0)
+		{
+			watchDir = watchDir -> nextHash;
+		}
+	}
+	return watchDir;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  W A T C H  A D D  D I R                                                                                           *
+ *  =======================                                                                                           *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Start watching a directory that has just been opened, its entries are kept with it.
+ *  \param dirWatch Tree being watched.
+ *  \param dirStat Stat of the open directory, NULL if it could not be read.
+ *  \param dirPath The path to the directory, ends with a '/'.
+ *  \param partPath Path as it goes into sub directories.
+ *  \param level Level of recursion.
+ *  \param excludeList Exclude rules of the parent directory, kept so it can be read again.
+ *  \result The new directory, NULL if out of memory.
+ */
+static DIR_WATCH_DIR *watchAddDir (DIR_WATCH *dirWatch, struct stat *dirStat, char *dirPath, char *partPath,
+		int level, DIR_EXCLUDE_LIST *excludeList)
+{
+#ifdef USE_INOTIFY
+	DIR_WATCH_DIR *watchDir;
+	unsigned int hashIdx;
+	int dirLen = strlen (dirPath) + 1;
+
+	/*------------------------------------------------------------------------*
+     * Keep the path table no more than full, double it if it is              *
+     *------------------------------------------------------------------------*/
+	if (dirWatch -> dirCount >= dirWatch -> hashSize)
+	{
+		DIR_WATCH_DIR **newHash;
+		unsigned int i, newSize = (dirWatch -> hashSize == 0 ? WATCH_HASH_MIN : dirWatch -> hashSize * 2);
+
+		if ((newHash = calloc (newSize, sizeof (DIR_WATCH_DIR *))) == NULL)
+			return NULL;
+
+		for (i = 0; i < dirWatch -> hashSize; ++i)
+		{
+			while ((watchDir = dirWatch -> pathHash[i]) != NULL)
+			{
+				dirWatch -> pathHash[i] = watchDir -> nextHash;
+				hashIdx = watchHashPath (watchDir -> dirPath, newSize);
+				watchDir -> nextHash = newHash[hashIdx];
+				newHash[hashIdx] = watchDir;
+			}
+		}
+		free (dirWatch -> pathHash);
+		dirWatch -> pathHash = newHash;
+		dirWatch -> hashSize = newSize;
+	}
+
+	if ((watchDir = calloc (1, sizeof (DIR_WATCH_DIR) + dirLen + strlen (partPath) + 1)) == NULL)
+		return NULL;
+
+	watchDir -> dirPath = strcpy ((char *)&watchDir[1], dirPath);
+	watchDir -> partPath = strcpy (&watchDir -> dirPath[dirLen], partPath);
+	watchDir -> dirLevel = level;
+	watchDir -> excludeList = excludeHold (excludeList);
+	if (dirStat != NULL)
+	{
+		watchDir -> mtimeSec = dirStat -> st_mtim.tv_sec;
+		watchDir -> mtimeNsec = dirStat -> st_mtim.tv_nsec;
+		watchDir -> ctimeSec = dirStat -> st_ctim.tv_sec;
+		watchDir -> ctimeNsec = dirStat -> st_ctim.tv_nsec;
+	}
+
+	/*------------------------------------------------------------------------*
+     * The same directory seen twice, through a link, is only watched once    *
+     *------------------------------------------------------------------------*/
+	watchDir -> watchDesc = inotify_add_watch (dirWatch -> watchFd, dirPath, WATCH_EVENTS);
+	if (watchDir -> watchDesc >= dirWatch -> indexSize)
+	{
+		int newSize = (watchDir -> watchDesc + 1) * 2;
+		DIR_WATCH_DIR **newIndex = realloc (dirWatch -> watchIndex, newSize * sizeof (DIR_WATCH_DIR *));
+
+		if (newIndex != NULL)
+		{
+			memset (&newIndex[dirWatch -> indexSize], 0, (newSize - dirWatch -> indexSize) * sizeof (DIR_WATCH_DIR *));
+			dirWatch -> watchIndex = newIndex;
+			dirWatch -> indexSize = newSize;
+		}
+	}
+	if (watchDir -> watchDesc < 0)
+	{
+		fprintf (stderr, "Watch failed: [%d] %s\n", errno, dirPath);
+	}
+	else if (watchDir -> watchDesc >= dirWatch -> indexSize || dirWatch -> watchIndex[watchDir -> watchDesc] != NULL)
+	{
+		watchDir -> watchDesc = -1;
+	}
+	else
+	{
+		dirWatch -> watchIndex[watchDir -> watchDesc] = watchDir;
+	}
+
+	hashIdx = watchHashPath (dirPath, dirWatch -> hashSize);
+	watchDir -> nextHash = dirWatch -> pathHash[hashIdx];
+	dirWatch -> pathHash[hashIdx] = watchDir;
+	if ((watchDir -> nextDir = dirWatch -> firstDir) != NULL)
+		watchDir -> nextDir -> prevDir = watchDir;
+	dirWatch -> firstDir = watchDir;
+	++dirWatch -> dirCount;
+	return watchDir;
+#else
+	return NULL;
+#endif
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  W A T C H  K E E P  E N T R Y                                                                                     *
+ *  =============================                                                                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Keep an entry with the watched directory it was found in.
+ *  \param watchDir Directory the entry is in.
+ *  \param saveEntry Entry to keep.
+ *  \result None.
+ */
+static void watchKeepEntry (DIR_WATCH_DIR *watchDir, DIR_ENTRY *saveEntry)
+{
+	if (watchDir -> entryCount == watchDir -> entrySize)
+	{
+		int newSize = (watchDir -> entrySize == 0 ? 16 : watchDir -> entrySize * 2);
+		DIR_ENTRY **newEntries = realloc (watchDir -> dirEntries, newSize * sizeof (DIR_ENTRY *));
+
+		if (newEntries == NULL)
+		{
+			directoryFreeEntry (saveEntry);
+			return;
+		}
+		watchDir -> dirEntries = newEntries;
+		watchDir -> entrySize = newSize;
+	}
+	watchDir -> dirEntries[watchDir -> entryCount++] = saveEntry;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  S T R E A M  B U F F E R  P U T                                                                                   *
+ *  ===============================                                                                                   *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Add an entry to the stream buffer, wait while the caller catches up.
+ *  \param streamBuffer Buffer shared with the caller.
+ *  \param saveEntry Entry to add.
+ *  \result None.
+ */
+static void streamBufferPut (DIR_STREAM_BUFFER *streamBuffer, DIR_ENTRY *saveEntry)
+{
+	pthread_mutex_lock (&streamBuffer -> bufferMutex);
+	while (streamBuffer -> bufferCount == streamBuffer -> bufferSize)
+	{
+		pthread_cond_wait (&streamBuffer -> notFull, &streamBuffer -> bufferMutex);
+	}
+	streamBuffer -> streamEntries[(streamBuffer -> bufferHead + streamBuffer -> bufferCount) %
+			streamBuffer -> bufferSize] = saveEntry;
+	++streamBuffer -> bufferCount;
+	pthread_cond_signal (&streamBuffer -> notEmpty);
+	pthread_mutex_unlock (&streamBuffer -> bufferMutex);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  S T R E A M  B U F F E R  G E T                                                                                   *
+ *  ===============================                                                                                   *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Take the next entry from the stream buffer, wait for the walk if it is empty.
+ *  \param streamBuffer Buffer shared with the walk.
+ *  \result The next entry, NULL when the walk has finished.
+ */
+static DIR_ENTRY *streamBufferGet (DIR_STREAM_BUFFER *streamBuffer)
+{
+	DIR_ENTRY *readEntry = NULL;
+
+	pthread_mutex_lock (&streamBuffer -> bufferMutex);
+	while (streamBuffer -> bufferCount == 0 && !streamBuffer -> walkDone)
+	{
+		pthread_cond_wait (&streamBuffer -> notEmpty, &streamBuffer -> bufferMutex);
+	}
+	if (streamBuffer -> bufferCount > 0)
+	{
+		readEntry = streamBuffer -> streamEntries[streamBuffer -> bufferHead];
+		streamBuffer -> bufferHead = (streamBuffer -> bufferHead + 1) % streamBuffer -> bufferSize;
+		--streamBuffer -> bufferCount;
+		pthread_cond_signal (&streamBuffer -> notFull);
+	}
+	pthread_mutex_unlock (&streamBuffer -> bufferMutex);
+	return readEntry;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  T O P  H E A P  C O M P A R E                                                                                     *
+ *  =============================                                                                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Compare two entries in the order they are kept, the last entries are kept by reversing it.
+ *  \param topHeap Heap the entries are for.
+ *  \param entryOne First entry to compare.
+ *  \param entryTwo Second entry to compare with.
+ *  \result Less than zero if entryOne is better, more than zero if entryTwo is better.
+ */
+static int topHeapCompare (DIR_TOP_HEAP *topHeap, DIR_ENTRY *entryOne, DIR_ENTRY *entryTwo)
+{
+	if (topHeap -> keepLast)
+		return entryTwo -> Compare (entryTwo, entryOne);
+
+	return entryOne -> Compare (entryOne, entryTwo);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  T O P  H E A P  P U T                                                                                             *
+ *  =====================                                                                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Offer an entry to the heap, it is kept if it is better than the worst one held.
+ *  \param topHeap Heap of the best entries, the worst is at the top.
+ *  \param saveEntry Entry to offer, it is freed if it is not kept or pushes out another.
+ *  \result None.
+ */
+static void topHeapPut (DIR_TOP_HEAP *topHeap, DIR_ENTRY *saveEntry)
+{
+	DIR_ENTRY **heapEntries;
+	int i, child;
+
+	pthread_mutex_lock (&topHeap -> heapMutex);
+	if (topHeap -> KeepFile != NULL && !topHeap -> KeepFile (saveEntry))
+	{
+		pthread_mutex_unlock (&topHeap -> heapMutex);
+		directoryFreeEntry (saveEntry);
+		return;
+	}
+	++topHeap -> filesKept;
+
+	/*------------------------------------------------------------------------*
+     * Grow the heap as it fills, if that fails it is full at its current size*
+     *------------------------------------------------------------------------*/
+	if (topHeap -> heapCount == topHeap -> heapAlloc && topHeap -> heapAlloc < topHeap -> heapSize)
+	{
+		int newAlloc = (topHeap -> heapAlloc > topHeap -> heapSize / 2 ? topHeap -> heapSize :
+				topHeap -> heapAlloc == 0 ? 256 : topHeap -> heapAlloc * 2);
+
+		if (newAlloc > topHeap -> heapSize)
+			newAlloc = topHeap -> heapSize;
+
+		if ((heapEntries = realloc (topHeap -> heapEntries, newAlloc * sizeof (DIR_ENTRY *))) != NULL)
+		{
+			topHeap -> heapEntries = heapEntries;
+			topHeap -> heapAlloc = newAlloc;
+		}
+		else
+		{
+			topHeap -> heapSize = topHeap -> heapAlloc;
+		}
+	}
+	heapEntries = topHeap -> heapEntries;
+
+	/*------------------------------------------------------------------------*
+     * Not full so add it, moving it up past any better entries               *
+     *------------------------------------------------------------------------*/
+	if (topHeap -> heapCount < topHeap -> heapSize)
+	{
+		i = topHeap -> heapCount++;
+		while (i > 0 && topHeapCompare (topHeap, saveEntry, heapEntries[(i - 1) / 2]) > 0)
+		{
+			heapEntries[i] = heapEntries[(i - 1) / 2];
+			i = (i - 1) / 2;
+		}
+		heapEntries[i] = saveEntry;
+		saveEntry = NULL;
+	}
+
+	/*------------------------------------------------------------------------*
+     * Full so it must beat the worst, which is dropped, then moves down      *
+     *------------------------------------------------------------------------*/
+	else if (topHeap -> heapCount && topHeapCompare (topHeap, saveEntry, heapEntries[0]) < 0)
+	{
+		DIR_ENTRY *dropEntry = heapEntries[0];
+
+		i = 0;
+		while ((child = (i * 2) + 1) < topHeap -> heapCount)
+		{
+			if (child + 1 < topHeap -> heapCount &&
+					topHeapCompare (topHeap, heapEntries[child + 1], heapEntries[child]) > 0)
+			{
+				++child;
+			}
+			if (topHeapCompare (topHeap, heapEntries[child], saveEntry) <= 0)
+				break;
+
+			heapEntries[i] = heapEntries[child];
+			i = child;
+		}
+		heapEntries[i] = saveEntry;
+		saveEntry = dropEntry;
+	}
+	pthread_mutex_unlock (&topHeap -> heapMutex);
+
+	if (saveEntry != NULL)
+	{
+		directoryFreeEntry (saveEntry);
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  V I S I T E D  A D D                                                                                              *
+ *  ====================                                                                                              *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Remember a directory has been read, links and bind mounts can lead back to one already read.
+ *  \param visitedDirs Directories read so far.
+ *  \param dirStat Stat of the open directory.
+ *  \result True if it had not been read before, false if it has and the branch should be pruned.
+ */
+static bool visitedAdd (DIR_VISITED *visitedDirs, struct stat *dirStat)
+{
+	unsigned long long dirDev = dirStat -> st_dev, dirIno = dirStat -> st_ino;
+	unsigned int hashIdx;
+	bool retn = true;
+
+	pthread_mutex_lock (&visitedDirs -> visitMutex);
+
+	/*------------------------------------------------------------------------*
+     * Keep the table no more than half full, double it if it is              *
+     *------------------------------------------------------------------------*/
+	if (visitedDirs -> visitCount * 2 >= visitedDirs -> visitSize)
+	{
+		unsigned int i, newSize = (visitedDirs -> visitSize == 0 ? VISITED_MIN : visitedDirs -> visitSize * 2);
+		unsigned long long *newKeys = calloc (newSize * 2, sizeof (unsigned long long));
+
+		if (newKeys == NULL)
+		{
+			pthread_mutex_unlock (&visitedDirs -> visitMutex);
+			return true;
+		}
+		for (i = 0; i < visitedDirs -> visitSize; ++i)
+		{
+			unsigned long long *oldKey = &visitedDirs -> visitKeys[i * 2];
+
+			if (oldKey[0] || oldKey[1])
+			{
+				hashIdx = (unsigned int)((oldKey[1] ^ (oldKey[0] << 32)) * 0x9E3779B97F4A7C15ULL >> 32) & (newSize - 1);
+				while (newKeys[hashIdx * 2] || newKeys[hashIdx * 2 + 1])
+				{
+					hashIdx = (hashIdx + 1) & (newSize - 1);
+				}
+				newKeys[hashIdx * 2] = oldKey[0];
+				newKeys[hashIdx * 2 + 1] = oldKey[1];
+			}
+		}
+		free (visitedDirs -> visitKeys);
+		visitedDirs -> visitKeys = newKeys;
+		visitedDirs -> visitSize = newSize;
+	}
+
+	hashIdx = (unsigned int)((dirIno ^ (dirDev << 32)) * 0x9E3779B97F4A7C15ULL >> 32) & (visitedDirs -> visitSize - 1);
+	while (visitedDirs -> visitKeys[hashIdx * 2] || visitedDirs -> visitKeys[hashIdx * 2 + 1])
+	{
+		if (visitedDirs -> visitKeys[hashIdx * 2] == dirDev && visitedDirs -> visitKeys[hashIdx * 2 + 1] == dirIno)
+		{
+			++visitedDirs -> prunedCount;
+			retn = false;
+			break;
+		}
+		hashIdx = (hashIdx + 1) & (visitedDirs -> visitSize - 1);
+	}
+	if (retn)
+	{
+		visitedDirs -> visitKeys[hashIdx * 2] = dirDev;
+		visitedDirs -> visitKeys[hashIdx * 2 + 1] = dirIno;
+		++visitedDirs -> visitCount;
+	}
+	pthread_mutex_unlock (&visitedDirs -> visitMutex);
+	return retn;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  V I S I T E D  F R E E                                                                                            *
+ *  ======================                                                                                            *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Say how many branches were pruned and free the directories read.
+ *  \param loadInfo Settings for this load, holds the directories read.
+ *  \result None.
+ */
+static void visitedFree (DIR_LOAD_INFO *loadInfo)
+{
+	DIR_VISITED *visitedDirs = loadInfo -> visitedDirs;
+
+	if (visitedDirs != NULL)
+	{
+		if (visitedDirs -> prunedCount)
+		{
+			fprintf (stderr, "Skipped %d directories already read\n", visitedDirs -> prunedCount);
+		}
+		pthread_mutex_destroy (&visitedDirs -> visitMutex);
+		free (visitedDirs -> visitKeys);
+		free (visitedDirs);
+		loadInfo -> visitedDirs = NULL;
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  K E E P  E N T R Y                                                                             *
+ *  =====================================                                                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Keep an entry that matched, add it to the list, the top heap or hand it to the stream.
+ *  \param loadInfo Settings for this load, says if it is streamed or only the best are kept.
+ *  \param fileList Where to save the entry when not streaming.
+ *  \param saveEntry Entry to keep, it is freed here when streaming without a buffer.
+ *  \result None.
+ */
+static void directoryKeepEntry (DIR_LOAD_INFO *loadInfo, void *fileList, DIR_ENTRY *saveEntry)
+{
+	if (loadInfo -> streamBuffer != NULL)
+	{
+		streamBufferPut (loadInfo -> streamBuffer, saveEntry);
+	}
+	else if (loadInfo -> StreamFile != NULL)
+	{
+		loadInfo -> StreamFile (saveEntry);
+		directoryFreeEntry (saveEntry);
+	}
+	else if (loadInfo -> dirWatch != NULL)
+	{
+		watchKeepEntry ((DIR_WATCH_DIR *)fileList, saveEntry);
+	}
+	else if (loadInfo -> topHeap != NULL)
+	{
+		topHeapPut (loadInfo -> topHeap, saveEntry);
+	}
+	else
+	{
+		if (strlen (saveEntry -> fileName) > queueGetFreeData (fileList))
+			queueSetFreeData (fileList, strlen (saveEntry -> fileName));
+
+		queuePut (fileList, saveEntry);
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  O T H E R  D E V I C E                                                                         *
+ *  =========================================                                                                         *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief With SAMEDEVICE, check the stat we already have to see if a directory is on another device.
+ *  \param loadInfo Settings for this load, holds the device of the top directory.
+ *  \param loadItem The directory found.
+ *  \result True if it is known to be on another device, false if it is not or we do not know yet.
+ */
+static bool directoryOtherDevice (DIR_LOAD_INFO *loadInfo, DIR_LOAD_ITEM *loadItem)
+{
+	DIR_ENTRY *saveEntry = loadItem -> saveEntry;
+
+	if (loadInfo -> loadDev == (dev_t)-1 || saveEntry == NULL || !(loadItem -> itemFlags & ITEM_HAVE_STAT))
+		return false;
+
+#ifdef USE_STATX
+	if (saveEntry -> statSize < offsetof (struct statx, stx_dev_minor) + sizeof (saveEntry -> fileStat.stx_dev_minor))
+		return false;
+
+	return (makedev (saveEntry -> fileStat.stx_dev_major, saveEntry -> fileStat.stx_dev_minor) != loadInfo -> loadDev);
+#else
+	return (saveEntry -> fileStat.st_dev != loadInfo -> loadDev);
+#endif
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  P R O C E S S  B A T C H                                                                       *
+ *  ===========================================                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Recurse in to the sub-directories in a batch and keep the entries that match.
+ *  \param loadInfo Settings for this load, pattern, flags and compare function.
+ *  \param loadBatch Batch that has been sorted and stated.
+ *  \param dirPath The path to the directory being read, ends with a '/'.
+ *  \param partPath If it is recursive keep the subdirs to be added to t.
+ *  \param fileList Where to save the directory.
+ *  \param level Level of recursion.
+ *  \param excludeList Exclude rules for this directory.
+ *  \param worker Worker to give sub-directories to, NULL if not parallel.
+ *  \result The number of files found.
+ */
+static int directoryProcessBatch (DIR_LOAD_INFO *loadInfo, DIR_LOAD_BATCH *loadBatch, char *dirPath, char *partPath,
+		void *fileList, int level, DIR_EXCLUDE_LIST *excludeList, DIR_WORKER *worker)
+{
+	int i, filesFound = 0, findFlags = loadInfo -> findFlags;
+
+	for (i = 0; i < loadBatch -> itemCount; ++i)
+	{
+		DIR_LOAD_ITEM *loadItem = &loadBatch -> loadItems[i];
+		DIR_ENTRY *saveEntry = loadItem -> saveEntry;
+
+		if (loadItem -> itemFlags & ITEM_CHECK_EXCLUDE &&
+				excludeCheck (excludeList, findFlags, partPath, loadItem -> fileName, S_ISDIR (loadItem -> fileMode)))
+		{
+			if (saveEntry != NULL)
+			{
+				directoryFreeEntry (saveEntry);
+			}
+			continue;
+		}
+
+		/*--------------------------------------------------------------------*
+         * Recursive directories, the type is known by now                    *
+         *--------------------------------------------------------------------*/
+		if (loadItem -> itemFlags & ITEM_RECURSE)
+		{
+			if (loadItem -> dirType == DT_UNKNOWN && loadItem -> statError)
+			{
+				printf ("Stat failed: [%d]\n", loadItem -> statError);
+			}
+			else if (S_ISLNK (loadItem -> fileMode) && findFlags & RECULINK && level <= loadInfo -> maxDepth)
+			{
+				ssize_t linkSize;
+				char *linkPath = malloc (PATH_SIZE + 4);
+
+				if (linkPath != NULL &&
+						(linkSize = readlinkat (loadBatch -> dirFd, loadItem -> fileName, linkPath, PATH_SIZE)) >= 0)
+				{
+#ifdef USE_STATX
+					struct statx linkStat;
+#else
+					struct stat linkStat;
+#endif
+					linkPath[linkSize] = 0;
+#ifdef USE_STATX
+					if (statx (AT_FDCWD, linkPath, AT_SYMLINK_NOFOLLOW, loadInfo -> statMask, &linkStat) == 0)
+#else
+					if (lstat (linkPath, &linkStat) == 0)
+#endif
+					{
+						if (getEntryType (&linkStat) & ONLYDIRS)
+						{
+							strcat_ch (linkPath, DIRSEP);
+							filesFound += directoryLoadSubDir (loadInfo, AT_FDCWD, linkPath, linkPath, linkPath,
+									fileList, level, excludeList, worker);
+						}
+					}
+				}
+				free (linkPath);
+			}
+			else if (S_ISDIR (loadItem -> fileMode))
+			{
+				int nameLen = strlen (loadItem -> fileName);
+				int dirLen = strlen (dirPath) + nameLen + 2;
+				char *tempPath, *subPath;
+
+				/*------------------------------------------------------------*
+                 * Only now do we need the paths to the sub-directory, unless *
+                 * it is deeper than asked for or on another device           *
+                 *------------------------------------------------------------*/
+				if (level <= loadInfo -> maxDepth &&
+						!(findFlags & SAMEDEVICE && directoryOtherDevice (loadInfo, loadItem)) &&
+						(tempPath = malloc (dirLen + strlen (partPath) + nameLen + 2)) != NULL)
+				{
+					subPath = &tempPath[dirLen];
+					strcpy (tempPath, dirPath);
+					strcat_ch (tempPath, DIRSEP);
+					strcat (tempPath, loadItem -> fileName);
+					strcat_ch (tempPath, DIRSEP);
+
+					strcpy (subPath, partPath);
+					strcat (subPath, loadItem -> fileName);
+					strcat_ch (subPath, DIRSEP);
+
+					filesFound += directoryLoadSubDir (loadInfo, loadBatch -> dirFd, loadItem -> fileName,
+							tempPath, subPath, fileList, level, excludeList, worker);
+					free (tempPath);
+				}
+			}
+		}
+
+		/*--------------------------------------------------------------------*
+         * Does this file match our pattern, if yes then show it to           *
+         * the user.                                                          *
+         *--------------------------------------------------------------------*/
+		if (saveEntry != NULL)
+		{
+			if (loadItem -> itemFlags & ITEM_NEED_STAT && loadItem -> statError)
+			{
+				printf ("Stat failed: [2:%d]\n", loadItem -> statError);
+			}
+
+			if (getEntryType (&saveEntry -> fileStat) & findFlags)
+			{
+				directoryKeepEntry (loadInfo, fileList, saveEntry);
+				filesFound ++;
+			}
+			else
+			{
+				directoryFreeEntry (saveEntry);
+			}
+		}
+	}
+	return filesFound;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  L O A D  D I R                                                                                 *
+ *  =================================                                                                                 *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Read the contents of a directory into memory.
+ *  \param loadInfo Settings for this load, pattern, flags and compare function.
+ *  \param parentFd Open directory that dirName is relative to, or AT_FDCWD.
+ *  \param dirName The name of the directory to be read.
+ *  \param dirPath The path to the directory to be read, ends with a '/'.
+ *  \param partPath If it is recursive keep the subdirs to be added to t.
+ *  \param fileList Where to save the directory.
+ *  \param level Level of recursion.
+ *  \param excludeList Exclude rules of the parent directory.
+ *  \param worker Worker to give sub-directories to, NULL if not parallel.
+ *  \result The number of files found.
+ */
+static int directoryLoadDir (DIR_LOAD_INFO *loadInfo, int parentFd, char *dirName, char *dirPath, char *partPath,
+		void *fileList, int level, DIR_EXCLUDE_LIST *excludeList, DIR_WORKER *worker)
+{
+	DIR_LOAD_BATCH loadBatch, *readBatch, *nextBatch;
+	DIR_EXCLUDE_LIST *dirExcludes;
+	DIR_CACHE_DIR cacheKey, *cacheDir = NULL;
+	DIR_CACHE_BUILD cacheBuild;
+	struct stat dirStat;
+	unsigned int cachePos = 0;
+	bool useCache = false, haveStat = false;
+	bool wholeDir = (loadInfo -> StreamFile != NULL && loadInfo -> findFlags & STREAMWHOLE);
+	int filesFound = 0;
+
+	if (++level > loadInfo -> maxLevel)
+	{
+		fprintf (stderr, "Too many levels of recursion\n");
+		return filesFound;
+	}
+
+	/*------------------------------------------------------------------------*
+     * A watched directory that is already loaded is kept as it is            *
+     *------------------------------------------------------------------------*/
+	if (loadInfo -> dirWatch != NULL && watchFindDir (loadInfo -> dirWatch, dirPath) != NULL)
+	{
+		return filesFound;
+	}
+
+	/*------------------------------------------------------------------------*
+     * Open the directory we plan to view, relative to its parent             *
+     *------------------------------------------------------------------------*/
+	if (directoryOpenBatch (&loadBatch, parentFd, dirName))
+	{
+		if (loadInfo -> visitedDirs != NULL || loadInfo -> dirWatch != NULL || dirCache != NULL ||
+				loadInfo -> findFlags & SAMEDEVICE)
+		{
+			haveStat = (fstat (loadBatch.dirFd, &dirStat) == 0);
+		}
+
+		/*--------------------------------------------------------------------*
+         * With SAMEDEVICE the top directory sets the device, any other       *
+         * mount point is listed in its parent but not read                   *
+         *--------------------------------------------------------------------*/
+		if (haveStat && loadInfo -> findFlags & SAMEDEVICE)
+		{
+			if (level == 1)
+			{
+				loadInfo -> loadDev = dirStat.st_dev;
+			}
+			else if (loadInfo -> loadDev != (dev_t)-1 && dirStat.st_dev != loadInfo -> loadDev)
+			{
+				directoryCloseBatch (&loadBatch);
+				return filesFound;
+			}
+		}
+
+		/*--------------------------------------------------------------------*
+         * A directory already read, through a link or a bind mount, is only  *
+         * read once, this also stops any loops                               *
+         *--------------------------------------------------------------------*/
+		if (haveStat && loadInfo -> visitedDirs != NULL && !visitedAdd (loadInfo -> visitedDirs, &dirStat))
+		{
+			directoryCloseBatch (&loadBatch);
+			return filesFound;
+		}
+		if (loadInfo -> dirWatch != NULL)
+		{
+			if ((fileList = watchAddDir (loadInfo -> dirWatch, haveStat ? &dirStat : NULL, dirPath, partPath,
+					level, excludeList)) == NULL)
+			{
+				directoryCloseBatch (&loadBatch);
+				return filesFound;
+			}
+		}
+		loadBatch.statRing = (worker != NULL ? &worker -> statRing : &loadInfo -> statRing);
+		dirExcludes = excludeLoadFile (loadBatch.dirFd, partPath, excludeList);
+
+		/*--------------------------------------------------------------------*
+         * If the directory has not changed its names come from the cache     *
+         *--------------------------------------------------------------------*/
+		if (dirCache != NULL && haveStat)
+		{
+			cacheDirKey (&dirStat, &cacheKey);
+			useCache = true;
+			cacheDir = cacheFindDir (&cacheKey);
+			memset (&cacheBuild, 0, sizeof (DIR_CACHE_BUILD));
+		}
+		readBatch = &loadBatch;
+		while ((cacheDir != NULL ? cacheReadBatch (readBatch, cacheDir, &cachePos) : directoryReadBatch (readBatch)) > 0)
+		{
+			directorySortBatch (loadInfo, readBatch, dirPath, partPath, fileList, dirExcludes);
+			directoryStatBatch (readBatch, loadInfo -> statMask);
+			if (useCache)
+			{
+				cacheAddBatch (&cacheBuild, readBatch, loadInfo -> statMask);
+			}
+
+			/*----------------------------------------------------------------*
+             * A stream that renames files would see them again, so it reads  *
+             * all of the directory before any entry is handed over           *
+             *----------------------------------------------------------------*/
+			if (wholeDir)
+			{
+				if ((nextBatch = directoryNextBatch (readBatch)) == NULL)
+					break;
+				readBatch = nextBatch;
+			}
+			else
+			{
+				filesFound += directoryProcessBatch (loadInfo, readBatch, dirPath, partPath, fileList, level,
+						dirExcludes, worker);
+			}
+		}
+		if (wholeDir)
+		{
+			for (readBatch = &loadBatch; readBatch != NULL; readBatch = readBatch -> nextBatch)
+			{
+				filesFound += directoryProcessBatch (loadInfo, readBatch, dirPath, partPath, fileList, level,
+						dirExcludes, worker);
+			}
+		}
+		if (useCache)
+		{
+			cacheStoreDir (&cacheKey, &cacheBuild, cacheDir != NULL);
+		}
+		excludeRelease (dirExcludes);
+		/*--------------------------------------------------------------------*
+         * All done so close the directory and tell them how many files and   *
+         * directories were found                                             *
+         *--------------------------------------------------------------------*/
+		directoryCloseBatch (&loadBatch);
+	}
+	return filesFound;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  W O R K E R  P U S H  T A S K                                                                                     *
+ *  =============================                                                                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Add a directory to the bottom of a workers deque, other workers may steal it.
+ *  \param worker Worker that found the directory.
+ *  \param dirPath The path to the directory to be read.
+ *  \param partPath Path as it goes into sub directories.
+ *  \param level Level of recursion.
+ *  \param excludeList Exclude rules of the parent directory, kept until the task is done.
+ *  \result True if the task was added.
+ */
+static bool workerPushTask (DIR_WORKER *worker, char *dirPath, char *partPath, int level,
+		DIR_EXCLUDE_LIST *excludeList)
+{
+	DIR_WORK_POOL *workPool = worker -> workPool;
+	DIR_LOAD_TASK *newTask;
+	int dirLen = strlen (dirPath) + 1;
+
+	if ((newTask = malloc (sizeof (DIR_LOAD_TASK) + dirLen + strlen (partPath) + 1)) == NULL)
+		return false;
+
+	newTask -> dirPath = (char *)&newTask[1];
+	newTask -> partPath = &newTask -> dirPath[dirLen];
+	newTask -> level = level;
+	newTask -> excludeList = excludeHold (excludeList);
+	strcpy (newTask -> dirPath, dirPath);
+	strcpy (newTask -> partPath, partPath);
+
+	pthread_mutex_lock (&worker -> dequeMutex);
+	if (worker -> dequeCount == worker -> dequeSize)
+	{
+		int i, newSize = (worker -> dequeSize ? worker -> dequeSize * 2 : 64);
+		DIR_LOAD_TASK **newDeque;
+
+		if ((newDeque = malloc (newSize * sizeof (DIR_LOAD_TASK *))) == NULL)
+		{
+			pthread_mutex_unlock (&worker -> dequeMutex);
+			excludeRelease (newTask -> excludeList);
+			free (newTask);
+			return false;
+		}
+		for (i = 0; i < worker -> dequeCount; ++i)
+		{
+			newDeque[i] = worker -> taskDeque[(worker -> dequeHead + i) % worker -> dequeSize];
+		}
+		free (worker -> taskDeque);
+		worker -> taskDeque = newDeque;
+		worker -> dequeSize = newSize;
+		worker -> dequeHead = 0;
+	}
+	worker -> taskDeque[(worker -> dequeHead + worker -> dequeCount) % worker -> dequeSize] = newTask;
+	worker -> dequeCount ++;
+	__atomic_add_fetch (&workPool -> pendingTasks, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock (&worker -> dequeMutex);
+
+	/*------------------------------------------------------------------------*
+     * Wake up an idle worker so it can steal the new directory               *
+     *------------------------------------------------------------------------*/
+	pthread_mutex_lock (&workPool -> poolMutex);
+	workPool -> workVersion ++;
+	if (workPool -> idleWorkers)
+	{
+		pthread_cond_signal (&workPool -> poolCond);
+	}
+	pthread_mutex_unlock (&workPool -> poolMutex);
+	return true;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  W O R K E R  P O P  T A S K                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Take the newest directory from the bottom of our own deque.
+ *  \param worker Worker that owns the deque.
+ *  \result The task or NULL if the deque is empty.
+ */
+static DIR_LOAD_TASK *workerPopTask (DIR_WORKER *worker)
+{
+	DIR_LOAD_TASK *retn = NULL;
+
+	pthread_mutex_lock (&worker -> dequeMutex);
+	if (worker -> dequeCount)
+	{
+		worker -> dequeCount --;
+		retn = worker -> taskDeque[(worker -> dequeHead + worker -> dequeCount) % worker -> dequeSize];
+	}
+	pthread_mutex_unlock (&worker -> dequeMutex);
+	return retn;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  W O R K E R  S T E A L  T A S K                                                                                   *
+ *  ===============================                                                                                   *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Take the oldest directory from the top of another workers deque.
+ *  \param victim Worker to steal from.
+ *  \result The task or NULL if the deque is empty.
+ */
+static DIR_LOAD_TASK *workerStealTask (DIR_WORKER *victim)
+{
+	DIR_LOAD_TASK *retn = NULL;
+
+	pthread_mutex_lock (&victim -> dequeMutex);
+	if (victim -> dequeCount)
+	{
+		retn = victim -> taskDeque[victim -> dequeHead];
+		victim -> dequeHead = (victim -> dequeHead + 1) % victim -> dequeSize;
+		victim -> dequeCount --;
+	}
+	pthread_mutex_unlock (&victim -> dequeMutex);
+	return retn;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  P O O L  F I N D  T A S K                                                                                         *
+ *  =========================                                                                                         *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Find the next directory to read, our own first then steal from the others.
+ *  \param worker Worker looking for work.
+ *  \result The task or NULL if there was nothing to do.
+ */
+static DIR_LOAD_TASK *poolFindTask (DIR_WORKER *worker)
+{
+	DIR_WORK_POOL *workPool = worker -> workPool;
+	DIR_LOAD_TASK *retn;
+	int i;
+
+	if ((retn = workerPopTask (worker)) == NULL)
+	{
+		for (i = 1; i < workPool -> workerCount && retn == NULL; ++i)
+		{
+			retn = workerStealTask (&workPool -> workers[(worker -> workerNum + i) % workPool -> workerCount]);
+		}
+	}
+	return retn;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  W O R K E R  T H R E A D                                                                                          *
+ *  ========================                                                                                          *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Thread that reads directories until there are none left in the pool.
+ *  \param param Pointer to the DIR_WORKER for this thread.
+ *  \result Always NULL.
+ */
+static void *workerThread (void *param)
+{
+	DIR_WORKER *worker = (DIR_WORKER *)param;
+	DIR_WORK_POOL *workPool = worker -> workPool;
+	DIR_LOAD_TASK *loadTask;
+	unsigned long lastVersion;
+	bool allDone = false;
+
+	while (!allDone)
+	{
+		pthread_mutex_lock (&workPool -> poolMutex);
+		lastVersion = workPool -> workVersion;
+		pthread_mutex_unlock (&workPool -> poolMutex);
+
+		if ((loadTask = poolFindTask (worker)) != NULL)
+		{
+			worker -> filesFound += directoryLoadDir (workPool -> loadInfo, AT_FDCWD, loadTask -> dirPath,
+					loadTask -> dirPath, loadTask -> partPath, worker -> fileList, loadTask -> level,
+					loadTask -> excludeList, worker);
+			excludeRelease (loadTask -> excludeList);
+			free (loadTask);
+
+			if (__atomic_sub_fetch (&workPool -> pendingTasks, 1, __ATOMIC_SEQ_CST) == 0)
+			{
+				pthread_mutex_lock (&workPool -> poolMutex);
+				workPool -> workVersion ++;
+				pthread_cond_broadcast (&workPool -> poolCond);
+				pthread_mutex_unlock (&workPool -> poolMutex);
+			}
+			continue;
+		}
+
+		/*--------------------------------------------------------------------*
+         * Nothing to steal, sleep until a directory is added or all done     *
+         *--------------------------------------------------------------------*/
+		pthread_mutex_lock (&workPool -> poolMutex);
+		while (__atomic_load_n (&workPool -> pendingTasks, __ATOMIC_SEQ_CST) &&
+				workPool -> workVersion == lastVersion)
+		{
+			workPool -> idleWorkers ++;
+			pthread_cond_wait (&workPool -> poolCond, &workPool -> poolMutex);
+			workPool -> idleWorkers --;
+		}
+		allDone = (__atomic_load_n (&workPool -> pendingTasks, __ATOMIC_SEQ_CST) == 0);
+		pthread_mutex_unlock (&workPool -> poolMutex);
+	}
+	return NULL;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  W O R K  P O O L  S T A R T                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Start a pool of work stealing threads on a directory tree and wait for them to read it all.
+ *  \param workPool Pool to fill in, end it with workPoolEnd even if this fails.
+ *  \param loadInfo Settings for this load.
+ *  \param dirPath The path to the top directory, ends with a '/'.
+ *  \param withLists True if each worker needs a list to save what it finds, false if they are streamed.
+ *  \result True if the pool read the tree, false if it could not be started.
+ */
+static bool workPoolStart (DIR_WORK_POOL *workPool, DIR_LOAD_INFO *loadInfo, char *dirPath, bool withLists)
+{
+	int i, started;
+	bool allCreated = true;
+
+	memset (workPool, 0, sizeof (DIR_WORK_POOL));
+	if ((workPool -> workers = calloc (loadThreads, sizeof (DIR_WORKER))) == NULL)
+	{
+		return false;
+	}
+	workPool -> loadInfo = loadInfo;
+	workPool -> workerCount = loadThreads;
+	pthread_mutex_init (&workPool -> poolMutex, NULL);
+	pthread_cond_init (&workPool -> poolCond, NULL);
+
+	for (i = 0; i < workPool -> workerCount; ++i)
+	{
+		workPool -> workers[i].workPool = workPool;
+		workPool -> workers[i].workerNum = i;
+		pthread_mutex_init (&workPool -> workers[i].dequeMutex, NULL);
+		if (withLists && (workPool -> workers[i].fileList = queueCreate ()) == NULL)
+			allCreated = false;
+	}
+
+	/*------------------------------------------------------------------------*
+     * The calling thread is worker zero and starts with the top directory    *
+     *------------------------------------------------------------------------*/
+	if (!allCreated || !workerPushTask (&workPool -> workers[0], dirPath, "", 0, NULL))
+	{
+		return false;
+	}
+	for (started = 1; started < workPool -> workerCount; ++started)
+	{
+		if (pthread_create (&workPool -> workers[started].threadID, NULL, workerThread,
+				&workPool -> workers[started]) != 0)
+			break;
+	}
+	workerThread (&workPool -> workers[0]);
+	for (i = 1; i < started; ++i)
+	{
+		pthread_join (workPool -> workers[i].threadID, NULL);
+	}
+	return true;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  W O R K  P O O L  E N D                                                                                           *
+ *  =======================                                                                                           *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Free a pool of workers, any worker lists must have been emptied and deleted.
+ *  \param workPool Pool to free.
+ *  \result The number of files the workers found.
+ */
+static int workPoolEnd (DIR_WORK_POOL *workPool)
+{
+	int i, filesFound = 0;
+
+	if (workPool -> workers == NULL)
+	{
+		return filesFound;
+	}
+	for (i = 0; i < workPool -> workerCount; ++i)
+	{
+		DIR_WORKER *worker = &workPool -> workers[i];
+
+		filesFound += worker -> filesFound;
+#ifdef USE_URING
+		statRingDelete (worker -> statRing);
+#endif
+		free (worker -> taskDeque);
+		pthread_mutex_destroy (&worker -> dequeMutex);
+	}
+	pthread_cond_destroy (&workPool -> poolCond);
+	pthread_mutex_destroy (&workPool -> poolMutex);
+	free (workPool -> workers);
+	return filesFound;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  L O A D  P A R A L L E L                                                                       *
+ *  ===========================================                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Read a directory tree using a pool of work stealing threads.
+ *  \param loadInfo Settings for this load.
+ *  \param dirPath The path to the top directory, ends with a '/'.
+ *  \param fileList Where to save the directory.
+ *  \result The number of files found.
+ */
+static int directoryLoadParallel (DIR_LOAD_INFO *loadInfo, char *dirPath, void *fileList)
+{
+	DIR_WORK_POOL workPool;
+	DIR_ENTRY *readEntry;
+	int i, filesFound = 0;
+
+	if (!workPoolStart (&workPool, loadInfo, dirPath, true))
+	{
+		filesFound = directoryLoadDir (loadInfo, AT_FDCWD, dirPath, dirPath, "", fileList, 0, NULL, NULL);
+	}
+
+	/*------------------------------------------------------------------------*
+     * Move what each worker found on to the callers list                     *
+     *------------------------------------------------------------------------*/
+	for (i = 0; workPool.workers != NULL && i < workPool.workerCount; ++i)
+	{
+		DIR_WORKER *worker = &workPool.workers[i];
+
+		if (worker -> fileList != NULL)
+		{
+			if (queueGetFreeData (worker -> fileList) > queueGetFreeData (fileList))
+				queueSetFreeData (fileList, queueGetFreeData (worker -> fileList));
+
+			while ((readEntry = (DIR_ENTRY *)queueGet (worker -> fileList)) != NULL)
+			{
+				readEntry -> entryArena = fileList;
+				queuePut (fileList, readEntry);
+			}
+			queueMoveArena (fileList, worker -> fileList);
+			queueDelete (worker -> fileList);
+		}
+	}
+	return filesFound + workPoolEnd (&workPool);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  S T R E A M  P A R A L L E L                                                                   *
+ *  ===============================================                                                                   *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Walk a directory tree for a stream using a pool of work stealing threads, the workers keep no lists.
+ *  \param loadInfo Settings for this load, entries go to its stream buffer.
+ *  \param dirPath The path to the top directory, ends with a '/'.
+ *  \result The number of files found.
+ */
+static int directoryStreamParallel (DIR_LOAD_INFO *loadInfo, char *dirPath)
+{
+	DIR_WORK_POOL workPool;
+	int filesFound = 0;
+
+	if (!workPoolStart (&workPool, loadInfo, dirPath, false))
+	{
+		filesFound = directoryLoadDir (loadInfo, AT_FDCWD, dirPath, dirPath, "", NULL, 0, NULL, NULL);
+	}
+	return filesFound + workPoolEnd (&workPool);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  S E T  T H R E A D S                                                                           *
+ *  =======================================                                                                           *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Set the number of threads used to read sub-directories with RECUDIR.
+ *  \param threads Number of threads, 0 for one per CPU, 1 (the default) reads in the calling thread.
+ *  \result None.
+ */
+void directorySetThreads (int threads)
+{
+	if (threads == 0)
+	{
+		threads = sysconf (_SC_NPROCESSORS_ONLN);
+	}
+	loadThreads = (threads < 1 ? 1 : threads > MAX_LOAD_THREADS ? MAX_LOAD_THREADS : threads);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  S E T  M A X  D E P T H                                                                        *
+ *  ==========================================                                                                        *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Set how many levels of sub-directories later loads with RECUDIR read.
+ *  \param maxDepth Levels below the directory given, 0 reads none, -1 (the default) has no limit.
+ *  \result None.
+ */
+void directorySetMaxDepth (int maxDepth)
+{
+	loadMaxDepth = (maxDepth < 0 ? -1 : maxDepth);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  S E T  S T A T  M A S K                                                                        *
+ *  ==========================================                                                                        *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Set the statx fields that later loads need, the type and mode are always read.
+ *  \param statMask Mask of STATX_ fields, 0 for STATX_ALL (the default), ignored without statx.
+ *  \result None.
+ */
+void directorySetStatMask (unsigned int statMask)
+{
+#ifdef USE_STATX
+	loadStatMask = (statMask == 0 ? STATX_ALL : statMask | STATX_TYPE | STATX_MODE);
+#endif
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  E X C L U D E  A D D                                                                           *
+ *  =======================================                                                                           *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Add a rule, in the form used by .gitignore, for names that later loads should not keep or read.
+ *  \param excludeRule The rule, a leading '!' keeps a name again and a trailing '/' only matches directories.
+ *  \result True if the rule was added.
+ */
+int directoryExcludeAdd (char *excludeRule)
+{
+	return excludeAddRule (&excludeGlobal, excludeRule, strlen (excludeRule));
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  S E T  E X C L U D E  F I L E                                                                  *
+ *  ================================================                                                                  *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Set the name of a file of exclude rules, such as .gitignore, to read from each directory loaded.
+ *  \param fileName Name of the file, NULL (the default) reads none.
+ *  \result None.
+ */
+void directorySetExcludeFile (char *fileName)
+{
+	free (excludeName);
+	excludeName = (fileName == NULL ? NULL : strdup (fileName));
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C A C H E  C H E C K  D I R                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Check a listing read from the cache file will not take us past the end of its data.
+ *  \param cacheDir Listing to check.
+ *  \result True if the listing is sound.
+ */
+static bool cacheCheckDir (DIR_CACHE_DIR *cacheDir)
+{
+	unsigned int i, readPos = 0;
+
+	for (i = 0; i < cacheDir -> itemCount; ++i)
+	{
+		DIR_CACHE_ITEM cacheItem;
+
+		if (cacheDir -> dataSize - readPos < sizeof (DIR_CACHE_ITEM))
+			return false;
+
+		memcpy (&cacheItem, &cacheDir -> dirData[readPos], sizeof (DIR_CACHE_ITEM));
+		readPos += sizeof (DIR_CACHE_ITEM);
+		if (cacheItem.nameSize == 0 || cacheItem.statSize > sizeof (((DIR_ENTRY *)0) -> fileStat) ||
+				cacheDir -> dataSize - readPos < (unsigned int)cacheItem.statSize + cacheItem.nameSize)
+			return false;
+
+		readPos += cacheItem.statSize + cacheItem.nameSize;
+		if (cacheDir -> dirData[readPos - 1] != 0)
+			return false;
+	}
+	return readPos == cacheDir -> dataSize;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  C A C H E  O P E N                                                                             *
+ *  =====================================                                                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Keep the names and stats of directories that are read, in a file, so that later loads can
+ *  skip reading any that have not changed since. A directory is known by its device and inode and is
+ *  only used if its modify and change times are the same.
+ *  \param cacheFile File to load the cache from and save it back to, it is created if missing.
+ *  \result True if the cache is open, an unreadable or out of date file gives an empty cache.
+ */
+int directoryCacheOpen (char *cacheFile)
+{
+	DIR_CACHE_HEADER cacheHeader;
+	FILE *readFile;
+
+	if (dirCache != NULL)
+		directoryCacheClose ();
+
+	if ((dirCache = calloc (1, sizeof (DIR_CACHE) + strlen (cacheFile) + 1)) == NULL)
+		return 0;
+
+	dirCache -> cacheFile = strcpy ((char *)&dirCache[1], cacheFile);
+	pthread_mutex_init (&dirCache -> cacheMutex, NULL);
+
+	if ((readFile = fopen (cacheFile, "rb")) != NULL)
+	{
+		if (fread (&cacheHeader, sizeof (DIR_CACHE_HEADER), 1, readFile) == 1 &&
+				memcmp (cacheHeader.cacheMagic, CACHE_MAGIC, sizeof (cacheHeader.cacheMagic)) == 0 &&
+				cacheHeader.cacheVersion == CACHE_VERSION &&
+				cacheHeader.statSize == sizeof (((DIR_ENTRY *)0) -> fileStat))
+		{
+			unsigned int i;
+
+			for (i = 0; i < cacheHeader.dirCount; ++i)
+			{
+				DIR_CACHE_RECORD cacheRecord;
+				DIR_CACHE_DIR *cacheDir;
+
+				if (fread (&cacheRecord, sizeof (DIR_CACHE_RECORD), 1, readFile) != 1 ||
+						(cacheDir = malloc (sizeof (DIR_CACHE_DIR))) == NULL)
+					break;
+
+				memset (cacheDir, 0, sizeof (DIR_CACHE_DIR));
+				cacheDir -> dirDev = cacheRecord.dirDev;
+				cacheDir -> dirIno = cacheRecord.dirIno;
+				cacheDir -> mtimeSec = cacheRecord.mtimeSec;
+				cacheDir -> mtimeNsec = cacheRecord.mtimeNsec;
+				cacheDir -> ctimeSec = cacheRecord.ctimeSec;
+				cacheDir -> ctimeNsec = cacheRecord.ctimeNsec;
+				cacheDir -> itemCount = cacheRecord.itemCount;
+				cacheDir -> dataSize = cacheRecord.dataSize;
+
+				if ((cacheDir -> dirData = malloc (cacheDir -> dataSize + 1)) == NULL ||
+						fread (cacheDir -> dirData, 1, cacheDir -> dataSize, readFile) != cacheDir -> dataSize ||
+						!cacheCheckDir (cacheDir))
+				{
+					free (cacheDir -> dirData);
+					free (cacheDir);
+					break;
+				}
+				cacheInsertDir (cacheDir);
+			}
+		}
+		fclose (readFile);
+	}
+	return 1;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  C A C H E  C L O S E                                                                           *
+ *  =======================================                                                                           *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Save the cache back to its file if any directory was added or changed, then free it.
+ *  \result True if the cache did not need saving or was saved.
+ */
+int directoryCacheClose (void)
+{
+	DIR_CACHE_DIR *cacheDir;
+	unsigned int i;
+	int retn = 1;
+
+	if (dirCache == NULL)
+		return 0;
+
+	/*------------------------------------------------------------------------*
+     * Write to a new file and rename it so a reader never sees half a cache  *
+     *------------------------------------------------------------------------*/
+	if (dirCache -> cacheChanged)
+	{
+		char *tempFile = malloc (strlen (dirCache -> cacheFile) + 5);
+		FILE *writeFile = NULL;
+
+		retn = 0;
+		if (tempFile != NULL)
+		{
+			strcat (strcpy (tempFile, dirCache -> cacheFile), ".tmp");
+			writeFile = fopen (tempFile, "wb");
+		}
+		if (writeFile != NULL)
+		{
+			DIR_CACHE_HEADER cacheHeader;
+			bool writeOK;
+
+			memset (&cacheHeader, 0, sizeof (DIR_CACHE_HEADER));
+			memcpy (cacheHeader.cacheMagic, CACHE_MAGIC, sizeof (cacheHeader.cacheMagic));
+			cacheHeader.cacheVersion = CACHE_VERSION;
+			cacheHeader.statSize = sizeof (((DIR_ENTRY *)0) -> fileStat);
+			cacheHeader.dirCount = dirCache -> dirCount;
+			writeOK = fwrite (&cacheHeader, sizeof (DIR_CACHE_HEADER), 1, writeFile) == 1;
+
+			for (i = 0; i < dirCache -> hashSize && writeOK; ++i)
+			{
+				for (cacheDir = dirCache -> hashTable[i]; cacheDir != NULL && writeOK; cacheDir = cacheDir -> nextDir)
+				{
+					DIR_CACHE_RECORD cacheRecord;
+
+					memset (&cacheRecord, 0, sizeof (DIR_CACHE_RECORD));
+					cacheRecord.dirDev = cacheDir -> dirDev;
+					cacheRecord.dirIno = cacheDir -> dirIno;
+					cacheRecord.mtimeSec = cacheDir -> mtimeSec;
+					cacheRecord.mtimeNsec = cacheDir -> mtimeNsec;
+					cacheRecord.ctimeSec = cacheDir -> ctimeSec;
+					cacheRecord.ctimeNsec = cacheDir -> ctimeNsec;
+					cacheRecord.itemCount = cacheDir -> itemCount;
+					cacheRecord.dataSize = cacheDir -> dataSize;
+					writeOK = fwrite (&cacheRecord, sizeof (DIR_CACHE_RECORD), 1, writeFile) == 1 &&
+							fwrite (cacheDir -> dirData, 1, cacheDir -> dataSize, writeFile) == cacheDir -> dataSize;
+				}
+			}
+			if (fclose (writeFile) == 0 && writeOK && rename (tempFile, dirCache -> cacheFile) == 0)
+				retn = 1;
+			else
+				unlink (tempFile);
+		}
+		free (tempFile);
+	}
+
+	/*------------------------------------------------------------------------*
+     * Free the listings, both current and those that have been replaced      *
+     *------------------------------------------------------------------------*/
+	for (i = 0; i < dirCache -> hashSize; ++i)
+	{
+		while ((cacheDir = dirCache -> hashTable[i]) != NULL)
+		{
+			dirCache -> hashTable[i] = cacheDir -> nextDir;
+			free (cacheDir -> dirData);
+			free (cacheDir);
+		}
+	}
+	while ((cacheDir = dirCache -> oldDirs) != NULL)
+	{
+		dirCache -> oldDirs = cacheDir -> nextDir;
+		free (cacheDir -> dirData);
+		free (cacheDir);
+	}
+	pthread_mutex_destroy (&dirCache -> cacheMutex);
+	free (dirCache -> hashTable);
+	free (dirCache);
+	dirCache = NULL;
+	return retn;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  L O A D  I N I T                                                                               *
+ *  ===================================                                                                               *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Fill in the load settings and split the path from the pattern.
+ *  \param loadInfo Settings to fill in.
+ *  \param inPath The path to the directory to be process, the pattern is used where it is.
+ *  \param findFlags Various options to select what files to read.
+ *  \param Compare Function to compare two directory entries, NULL for the default.
+ *  \result The path to the directory (ends with a '/'), free when done, NULL if out of memory.
+ */
+static char *directoryLoadInit (DIR_LOAD_INFO *loadInfo, char *inPath, int findFlags, compareFile *Compare)
+{
+	char *dirPath, *endPath;
+	struct rlimit fileLimit;
+
+	memset (loadInfo, 0, sizeof (DIR_LOAD_INFO));
+	loadInfo -> findFlags = findFlags;
+	loadInfo -> Compare = (Compare == NULL ? directoryDefCompare : Compare);
+#ifdef USE_STATX
+	loadInfo -> statMask = loadStatMask;
+#endif
+
+	/*------------------------------------------------------------------------*
+     * Loops are found from the directories read, so the depth is only        *
+     * limited by the open directories each level holds                       *
+     *------------------------------------------------------------------------*/
+	loadInfo -> maxDepth = (loadMaxDepth < 0 ? MAXINT : loadMaxDepth);
+	loadInfo -> loadDev = (dev_t)-1;
+	loadInfo -> maxLevel = MAX_LOAD_LEVEL;
+	if (getrlimit (RLIMIT_NOFILE, &fileLimit) == 0 && fileLimit.rlim_cur != RLIM_INFINITY &&
+			fileLimit.rlim_cur / 2 < MAX_LOAD_LEVEL)
+	{
+		loadInfo -> maxLevel = (fileLimit.rlim_cur / 2 < MIN_LOAD_LEVEL ? MIN_LOAD_LEVEL : fileLimit.rlim_cur / 2);
+	}
+	if (findFlags & RECUDIR)
+	{
+		if ((loadInfo -> visitedDirs = calloc (1, sizeof (DIR_VISITED))) != NULL)
+		{
+			pthread_mutex_init (&loadInfo -> visitedDirs -> visitMutex, NULL);
+		}
+	}
+
+	/*------------------------------------------------------------------------*
+     * Split the path from the pattern, the pattern is used where it is       *
+     *------------------------------------------------------------------------*/
+	if ((endPath = strrchr (inPath, DIRSEP)) != NULL)
+	{
+		int dirLen = ++endPath - inPath;
+
+		if ((dirPath = malloc (dirLen + 1)) == NULL)
+			return NULL;
+
+		strncpy (dirPath, inPath, dirLen);
+		dirPath[dirLen] = 0;
+		loadInfo -> filePattern = (*endPath ? endPath : "*");
+	}
+	else
+	{
+		char *cwdPath = getcwd (NULL, 0);
+
+		if ((dirPath = malloc ((cwdPath == NULL ? 1 : strlen (cwdPath)) + 2)) == NULL)
+		{
+			free (cwdPath);
+			return NULL;
+		}
+		strcpy (dirPath, cwdPath == NULL ? "." : cwdPath);
+		strcat_ch (dirPath, DIRSEP);
+		loadInfo -> filePattern = inPath;
+		free (cwdPath);
+	}
+
+	/*------------------------------------------------------------------------*
+     * Compile the pattern once, it is then checked against every name read   *
+     *------------------------------------------------------------------------*/
+	if ((loadInfo -> fileMatch = matchCompile (loadInfo -> filePattern, findFlags)) == NULL)
+	{
+		visitedFree (loadInfo);
+		free (dirPath);
+		return NULL;
+	}
+	return dirPath;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  L O A D                                                                                        *
+ *  ==========================                                                                                        *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Read the contents of a directory into memory.
+ *  \param inPath The path to the directory to be process.
+ *  \param findFlags Various options to select what files to read.
+ *  \param Compare Function to compare two directory entries.
+ *  \param fileList Where to save the directory.
+ *  \result The number of files found.
+ */
+int directoryLoad (char *inPath, int findFlags, compareFile *Compare, void **fileList)
+{
+	DIR_LOAD_INFO loadInfo;
+	char *dirPath;
+	int filesFound = 0;
+
+	if ((dirPath = directoryLoadInit (&loadInfo, inPath, findFlags, Compare)) == NULL)
+		return 0;
+
+	if (!(*fileList))
+	{
+		if ((*fileList = queueCreate ()) == NULL)
+		{
+			visitedFree (&loadInfo);
+			matchFree (loadInfo.fileMatch);
+			free (dirPath);
+			return 0;
+		}
+	}
+	if (loadThreads > 1 && findFlags & RECUDIR)
+	{
+		filesFound = directoryLoadParallel (&loadInfo, dirPath, *fileList);
+	}
+	else
+	{
+		filesFound = directoryLoadDir (&loadInfo, AT_FDCWD, dirPath, dirPath, "", *fileList, 0, NULL, NULL);
+	}
+#ifdef USE_URING
+	statRingDelete (loadInfo.statRing);
+#endif
+	visitedFree (&loadInfo);
+	matchFree (loadInfo.fileMatch);
+	free (dirPath);
+	return filesFound;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  L O A D  T O P                                                                                 *
+ *  =================================                                                                                 *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Read the contents of a directory, only keeping the entries that would be first once sorted.
+ *  \param inPath The path to the directory to be process.
+ *  \param findFlags Various options to select what files to read.
+ *  \param Compare Function to compare two directory entries.
+ *  \param KeepFile Function to say if an entry is wanted (returns 0 to drop it), NULL to want them all.
+ *  \param topCount How many to keep, if negative the entries that would be last are kept.
+ *  \param fileList Where to save the entries kept, sort it with directorySort.
+ *  \result The number of files found and wanted, not just those kept.
+ */
+int directoryLoadTop (char *inPath, int findFlags, compareFile *Compare, int(*KeepFile)(DIR_ENTRY *dirEntry),
+		int topCount, void **fileList)
+{
+	DIR_LOAD_INFO loadInfo;
+	DIR_TOP_HEAP topHeap;
+	char *dirPath;
+	int i;
+
+	if ((dirPath = directoryLoadInit (&loadInfo, inPath, findFlags, Compare)) == NULL)
+		return 0;
+
+	if (!(*fileList))
+	{
+		if ((*fileList = queueCreate ()) == NULL)
+		{
+			visitedFree (&loadInfo);
+			matchFree (loadInfo.fileMatch);
+			free (dirPath);
+			return 0;
+		}
+	}
+
+	/*------------------------------------------------------------------------*
+     * Entries are offered to a heap as they are found, so only the best are  *
+     * ever held, a parallel load shares the one heap                         *
+     *------------------------------------------------------------------------*/
+	memset (&topHeap, 0, sizeof (DIR_TOP_HEAP));
+	topHeap.KeepFile = KeepFile;
+	topHeap.heapSize = (topCount < 0 ? -topCount : topCount);
+	topHeap.keepLast = (topCount < 0);
+	pthread_mutex_init (&topHeap.heapMutex, NULL);
+	loadInfo.topHeap = &topHeap;
+
+	if (loadThreads > 1 && findFlags & RECUDIR)
+	{
+		directoryLoadParallel (&loadInfo, dirPath, *fileList);
+	}
+	else
+	{
+		directoryLoadDir (&loadInfo, AT_FDCWD, dirPath, dirPath, "", *fileList, 0, NULL, NULL);
+	}
+
+	/*------------------------------------------------------------------------*
+     * Move the entries kept on to the callers list                           *
+     *------------------------------------------------------------------------*/
+	for (i = 0; i < topHeap.heapCount; ++i)
+	{
+		DIR_ENTRY *readEntry = topHeap.heapEntries[i];
+
+		if (strlen (readEntry -> fileName) > queueGetFreeData (*fileList))
+			queueSetFreeData (*fileList, strlen (readEntry -> fileName));
+
+		queuePut (*fileList, readEntry);
+	}
+	free (topHeap.heapEntries);
+	pthread_mutex_destroy (&topHeap.heapMutex);
+#ifdef USE_URING
+	statRingDelete (loadInfo.statRing);
+#endif
+	visitedFree (&loadInfo);
+	matchFree (loadInfo.fileMatch);
+	free (dirPath);
+	return topHeap.filesKept;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  S T R E A M  W A L K  T H R E A D                                                                                 *
+ *  =================================                                                                                 *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Thread that walks the directories and fills the stream buffer.
+ *  \param param The stream buffer, it holds the settings and the path.
+ *  \result Always NULL.
+ */
+static void *streamWalkThread (void *param)
+{
+	DIR_STREAM_BUFFER *streamBuffer = (DIR_STREAM_BUFFER *)param;
+	DIR_LOAD_INFO *loadInfo = streamBuffer -> loadInfo;
+
+	if (loadThreads > 1 && loadInfo -> findFlags & RECUDIR)
+	{
+		streamBuffer -> filesFound = directoryStreamParallel (loadInfo, streamBuffer -> dirPath);
+	}
+	else
+	{
+		streamBuffer -> filesFound = directoryLoadDir (loadInfo, AT_FDCWD, streamBuffer -> dirPath,
+				streamBuffer -> dirPath, "", NULL, 0, NULL, NULL);
+	}
+	pthread_mutex_lock (&streamBuffer -> bufferMutex);
+	streamBuffer -> walkDone = true;
+	pthread_cond_broadcast (&streamBuffer -> notEmpty);
+	pthread_mutex_unlock (&streamBuffer -> bufferMutex);
+	return NULL;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  S T R E A M                                                                                    *
+ *  ==============================                                                                                    *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Walk a directory and pass each matching file to a call back as it is found, nothing is kept.
+ *  \param inPath The path to the directory to be process.
+ *  \param findFlags Various options to select what files to read, add STREAMWHOLE if the call back renames files.
+ *  \param ProcFile Call back function, the entry is freed when it returns.
+ *  \param lookAhead How many entries the walk may get ahead of the call back, run on its own thread.
+ *  0 walks on the calling thread with no look ahead.
+ *  \result The number of files found.
+ */
+int directoryStream (char *inPath, int findFlags, int(*ProcFile)(DIR_ENTRY *dirEntry), int lookAhead)
+{
+	DIR_LOAD_INFO loadInfo;
+	DIR_STREAM_BUFFER streamBuffer;
+	DIR_ENTRY *readEntry;
+	pthread_t walkThread;
+	char *dirPath;
+	int filesFound = 0;
+
+	if ((dirPath = directoryLoadInit (&loadInfo, inPath, findFlags, NULL)) == NULL)
+		return 0;
+
+	loadInfo.StreamFile = ProcFile;
+	memset (&streamBuffer, 0, sizeof (DIR_STREAM_BUFFER));
+	if (lookAhead > 0 && (streamBuffer.streamEntries = malloc (lookAhead * sizeof (DIR_ENTRY *))) != NULL)
+	{
+		streamBuffer.loadInfo = &loadInfo;
+		streamBuffer.dirPath = dirPath;
+		streamBuffer.bufferSize = lookAhead;
+		pthread_mutex_init (&streamBuffer.bufferMutex, NULL);
+		pthread_cond_init (&streamBuffer.notEmpty, NULL);
+		pthread_cond_init (&streamBuffer.notFull, NULL);
+		loadInfo.streamBuffer = &streamBuffer;
+
+		/*--------------------------------------------------------------------*
+         * The walk fills the buffer while this thread empties it             *
+         *--------------------------------------------------------------------*/
+		if (pthread_create (&walkThread, NULL, streamWalkThread, &streamBuffer) == 0)
+		{
+			while ((readEntry = streamBufferGet (&streamBuffer)) != NULL)
+			{
+				ProcFile (readEntry);
+				directoryFreeEntry (readEntry);
+			}
+			pthread_join (walkThread, NULL);
+			filesFound = streamBuffer.filesFound;
+		}
+		else
+		{
+			loadInfo.streamBuffer = NULL;
+			filesFound = directoryLoadDir (&loadInfo, AT_FDCWD, dirPath, dirPath, "", NULL, 0, NULL, NULL);
+		}
+		pthread_cond_destroy (&streamBuffer.notFull);
+		pthread_cond_destroy (&streamBuffer.notEmpty);
+		pthread_mutex_destroy (&streamBuffer.bufferMutex);
+		free (streamBuffer.streamEntries);
+	}
+	else
+	{
+		/*--------------------------------------------------------------------*
+         * No look ahead, the call back is done as each directory is read     *
+         *--------------------------------------------------------------------*/
+		filesFound = directoryLoadDir (&loadInfo, AT_FDCWD, dirPath, dirPath, "", NULL, 0, NULL, NULL);
+	}
+#ifdef USE_URING
+	statRingDelete (loadInfo.statRing);
+#endif
+	visitedFree (&loadInfo);
+	matchFree (loadInfo.fileMatch);
+	free (dirPath);
+	return filesFound;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  W A T C H  D R O P  D I R                                                                                         *
+ *  =========================                                                                                         *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Stop keeping a directory and free the entries found in it.
+ *  \param dirWatch Tree being watched.
+ *  \param watchDir Directory to drop.
+ *  \param removeWatch False if the directory is to be loaded again, so keep the inotify watch.
+ *  \result None.
+ */
+static void watchDropDir (DIR_WATCH *dirWatch, DIR_WATCH_DIR *watchDir, bool removeWatch)
+{
+	DIR_WATCH_DIR **prevHash = &dirWatch -> pathHash[watchHashPath (watchDir -> dirPath, dirWatch -> hashSize)];
+	int i;
+
+	while (*prevHash != watchDir)
+	{
+		prevHash = &(*prevHash) -> nextHash;
+	}
+	*prevHash = watchDir -> nextHash;
+
+	if (watchDir -> prevDir != NULL)
+		watchDir -> prevDir -> nextDir = watchDir -> nextDir;
+	else
+		dirWatch -> firstDir = watchDir -> nextDir;
+	if (watchDir -> nextDir != NULL)
+		watchDir -> nextDir -> prevDir = watchDir -> prevDir;
+	--dirWatch -> dirCount;
+
+	if (watchDir -> watchDesc >= 0)
+	{
+		dirWatch -> watchIndex[watchDir -> watchDesc] = NULL;
+#ifdef USE_INOTIFY
+		if (removeWatch)
+			inotify_rm_watch (dirWatch -> watchFd, watchDir -> watchDesc);
+#endif
+	}
+	for (i = 0; i < watchDir -> entryCount; ++i)
+	{
+		directoryFreeEntry (watchDir -> dirEntries[i]);
+	}
+	free (watchDir -> dirEntries);
+	excludeRelease (watchDir -> excludeList);
+	free (watchDir);
+}
+
+#ifdef USE_INOTIFY
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  W A T C H  D R O P  T R E E                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Drop a directory and all those below it, used when it is deleted or moved away.
+ *  \param dirWatch Tree being watched.
+ *  \param dirPath The path to the directory, ends with a '/'.
+ *  \result The number of directories dropped.
+ */
+static int watchDropTree (DIR_WATCH *dirWatch, char *dirPath)
+{
+	DIR_WATCH_DIR *watchDir = dirWatch -> firstDir, *nextDir;
+	int dirLen = strlen (dirPath), dropCount = 0;
+
+	while (watchDir != NULL)
+	{
+		nextDir = watchDir -> nextDir;
+		if (strncmp (watchDir -> dirPath, dirPath, dirLen) == 0)
+		{
+			watchDropDir (dirWatch, watchDir, true);
+			++dropCount;
+		}
+		watchDir = nextDir;
+	}
+	return dropCount;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  W A T C H  R E L O A D  D I R                                                                                     *
+ *  =============================                                                                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Read a changed directory again, new sub-directories are loaded, those already watched are kept.
+ *  \param dirWatch Tree being watched.
+ *  \param watchDir Directory to read, it is replaced.
+ *  \result None.
+ */
+static void watchReloadDir (DIR_WATCH *dirWatch, DIR_WATCH_DIR *watchDir)
+{
+	int dirLen = strlen (watchDir -> dirPath) + 1, watchDesc = watchDir -> watchDesc, level = watchDir -> dirLevel;
+	char *dirPath = malloc (dirLen + strlen (watchDir -> partPath) + 1), *partPath;
+	DIR_EXCLUDE_LIST *excludeList;
+
+	if (dirPath == NULL)
+		return;
+
+	excludeList = excludeHold (watchDir -> excludeList);
+	partPath = strcpy (&dirPath[dirLen], watchDir -> partPath);
+	strcpy (dirPath, watchDir -> dirPath);
+	watchDropDir (dirWatch, watchDir, false);
+
+	/*------------------------------------------------------------------------*
+     * Directories still watched are found by path, so only those read from   *
+     * here on need to be remembered                                          *
+     *------------------------------------------------------------------------*/
+	if (dirWatch -> loadInfo.visitedDirs != NULL)
+	{
+		pthread_mutex_lock (&dirWatch -> loadInfo.visitedDirs -> visitMutex);
+		if (dirWatch -> loadInfo.visitedDirs -> visitKeys != NULL)
+		{
+			memset (dirWatch -> loadInfo.visitedDirs -> visitKeys, 0,
+					dirWatch -> loadInfo.visitedDirs -> visitSize * 2 * sizeof (unsigned long long));
+		}
+		dirWatch -> loadInfo.visitedDirs -> visitCount = 0;
+		pthread_mutex_unlock (&dirWatch -> loadInfo.visitedDirs -> visitMutex);
+	}
+
+	directoryLoadDir (&dirWatch -> loadInfo, AT_FDCWD, dirPath, dirPath, partPath, NULL, level - 1, excludeList, NULL);
+	excludeRelease (excludeList);
+
+	/*------------------------------------------------------------------------*
+     * If it could not be read, it has gone, so stop watching it              *
+     *------------------------------------------------------------------------*/
+	if (watchDesc >= 0 && dirWatch -> watchIndex[watchDesc] == NULL)
+		inotify_rm_watch (dirWatch -> watchFd, watchDesc);
+	free (dirPath);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  W A T C H  E V E N T                                                                                              *
+ *  ====================                                                                                              *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Mark the directories changed by an inotify event, those deleted or moved away are dropped.
+ *  \param dirWatch Tree being watched.
+ *  \param watchEvent Event read from inotify.
+ *  \result The number of directories dropped, -1 if events were lost.
+ */
+static int watchEvent (DIR_WATCH *dirWatch, struct inotify_event *watchEvent)
+{
+	DIR_WATCH_DIR *watchDir;
+	int dropCount = 0;
+
+	if (watchEvent -> mask & IN_Q_OVERFLOW)
+		return -1;
+
+	if (watchEvent -> wd < 0 || watchEvent -> wd >= dirWatch -> indexSize ||
+			(watchDir = dirWatch -> watchIndex[watchEvent -> wd]) == NULL)
+		return 0;
+
+	/*------------------------------------------------------------------------*
+     * The directory itself has gone, when read again it will be dropped      *
+     *------------------------------------------------------------------------*/
+	if (watchEvent -> mask & IN_IGNORED)
+	{
+		dirWatch -> watchIndex[watchEvent -> wd] = NULL;
+		watchDir -> watchDesc = -1;
+		watchDir -> dirChanged = true;
+		return 0;
+	}
+	if (watchEvent -> len == 0)
+		return 0;
+
+	if (watchEvent -> mask & IN_ISDIR && watchEvent -> mask & (IN_DELETE | IN_MOVED_FROM))
+	{
+		char *subPath = malloc (strlen (watchDir -> dirPath) + strlen (watchEvent -> name) + 2);
+
+		if (subPath != NULL)
+		{
+			strcpy (subPath, watchDir -> dirPath);
+			strcat (subPath, watchEvent -> name);
+			strcat_ch (subPath, DIRSEP);
+			dropCount = watchDropTree (dirWatch, subPath);
+			free (subPath);
+		}
+	}
+	watchDir -> dirChanged = true;
+	return dropCount;
+}
+#endif
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  W A T C H  O P E N                                                                             *
+ *  =====================================                                                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Load a directory and keep it up to date from inotify, see directoryWatchWait.
+ *  \param inPath The path to the directory to be process.
+ *  \param findFlags Various options to select what files to read.
+ *  \param Compare Function to compare two directory entries.
+ *  \result Handle for the watch, NULL if it could not be started.
+ */
+void *directoryWatchOpen (char *inPath, int findFlags, compareFile *Compare)
 {
-#ifdef USE_STATX
-	if (fileOne -> fileStat.stx_mode & S_IFDIR)
+#ifdef USE_INOTIFY
+	DIR_WATCH *dirWatch;
+
+	if ((dirWatch = calloc (1, sizeof (DIR_WATCH))) == NULL)
+		return NULL;
+
+	if ((dirWatch -> rootPath = directoryLoadInit (&dirWatch -> loadInfo, inPath, findFlags, Compare)) == NULL)
 	{
-		if (!(fileTwo -> fileStat.stx_mode & S_IFDIR))
-			return -1;
+		free (dirWatch);
+		return NULL;
 	}
-	if (fileTwo -> fileStat.stx_mode & S_IFDIR)
+	if ((dirWatch -> watchFd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC)) < 0)
 	{
-		if (!(fileOne -> fileStat.stx_mode & S_IFDIR))
-			return 1;
+		visitedFree (&dirWatch -> loadInfo);
+		matchFree (dirWatch -> loadInfo.fileMatch);
+		free (dirWatch -> rootPath);
+		free (dirWatch);
+		return NULL;
 	}
+	dirWatch -> loadInfo.dirWatch = dirWatch;
+	directoryLoadDir (&dirWatch -> loadInfo, AT_FDCWD, dirWatch -> rootPath, dirWatch -> rootPath, "", NULL, 0,
+			NULL, NULL);
+	return dirWatch;
 #else
-	if (fileOne -> fileStat.st_mode & S_IFDIR)
-	{
-		if (!(fileTwo -> fileStat.st_mode & S_IFDIR))
-			return -1;
-	}
-	if (fileTwo -> fileStat.st_mode & S_IFDIR)
-	{
-		if (!(fileOne -> fileStat.st_mode & S_IFDIR))
-			return 1;
-	}
+	return NULL;
 #endif
-	return strcasecmp (fileOne -> fileName, fileTwo -> fileName);
 }
 
 /**********************************************************************************************************************
  *                                                                                                                    *
- *  D I R E C T O R Y  L O A D  I N T                                                                                 *
- *  =================================                                                                                 *
+ *  D I R E C T O R Y  W A T C H  W A I T                                                                             *
+ *  =====================================                                                                             *
  *                                                                                                                    *
  **********************************************************************************************************************/
 /**
- *  \brief Read the contents of a directory into memory.
- *  \param inPath The path to the directory to be process.
- *  \param partPath If it is recursive keep the subdirs to be added to t.
- *  \param findFlags Various options to select what files to read.
- *  \param Compare Function to compare two files.
- *  \param fileList Where to save the directory.
- *  \param level Level of recursion.
- *  \result The number of files found.
+ *  \brief Wait for changes to a watched tree and apply them, only the directories that changed are read
+ *  again. If events were lost every directory is checked and those with new times are read again.
+ *  \param watchHandle Handle from directoryWatchOpen.
+ *  \param waitTime Milliseconds to wait, -1 to wait for ever.
+ *  \result The number of directories changed, 0 if nothing changed, -1 on error.
  */
-static int directoryLoadInt (char *inPath, char *partPath, int findFlags, compareFile *Compare, void **fileList, int level)
+int directoryWatchWait (void *watchHandle, int waitTime)
 {
-	DIR *dirPtr;
-	int filesFound = 0;
-	struct dirent *dirList;
-	compareFile *compareFunc = Compare;
-	char fullPath[PATH_SIZE], filePattern[PATH_SIZE], *endPath;
+#ifdef USE_INOTIFY
+	DIR_WATCH *dirWatch = (DIR_WATCH *)watchHandle;
+	DIR_WATCH_DIR *watchDir, *nextDir;
+	struct pollfd pollFd;
+	char *eventBuffer;
+	ssize_t readSize;
+	bool lostEvents = false;
+	int pollResult, changeCount = 0;
 
-	if (++level > 40)
-	{
-		fprintf (stderr, "Too many levels of recursion\n");
-		return filesFound;
-	}
+	pollFd.fd = dirWatch -> watchFd;
+	pollFd.events = POLLIN;
+	if ((pollResult = poll (&pollFd, 1, waitTime)) <= 0)
+		return (pollResult < 0 && errno != EINTR ? -1 : 0);
 
-	strcpy (fullPath, inPath);
-	if ((endPath = strrchr (fullPath, DIRSEP)) != NULL)
+	if ((eventBuffer = malloc (WATCH_BUFFER_SIZE)) == NULL)
+		return -1;
+
+	/*------------------------------------------------------------------------*
+     * Take all the events waiting, each directory is only read once          *
+     *------------------------------------------------------------------------*/
+	while ((readSize = read (dirWatch -> watchFd, eventBuffer, WATCH_BUFFER_SIZE)) > 0)
 	{
-		if (*(++endPath))
+		ssize_t offset = 0;
+
+		while (offset < readSize)
 		{
-			strcpy (filePattern, endPath);
-			*endPath = 0;
+			struct inotify_event *event = (struct inotify_event *)&eventBuffer[offset];
+			int dropCount = watchEvent (dirWatch, event);
+
+			if (dropCount < 0)
+				lostEvents = true;
+			else
+				changeCount += dropCount;
+			offset += sizeof (struct inotify_event) + event -> len;
 		}
-		else
-			strcpy (filePattern, "*");
-	}
-	else
-	{
-		strcpy (filePattern, fullPath);
-		if (getcwd (fullPath, PATH_SIZE - 2) == NULL)
-			strcpy (fullPath, ".");
-		strcat_ch (fullPath, DIRSEP);
-	}
-	if (!(*fileList))
-	{
-		if ((*fileList = queueCreate ()) == NULL)
-			return 0;
-	}
-	if (compareFunc == NULL)
-	{
-		compareFunc = directoryDefCompare;
 	}
+	free (eventBuffer);
 
 	/*------------------------------------------------------------------------*
-     * Open the directory we plan to view                                     *
+     * Events were lost, so check the times of every directory                *
      *------------------------------------------------------------------------*/
-	if ((dirPtr = opendir (fullPath)) != NULL)
+	if (lostEvents)
 	{
-		endPath = &fullPath[strlen(fullPath)];
-
-		while ((dirList = readdir (dirPtr)) != NULL)
+		for (watchDir = dirWatch -> firstDir; watchDir != NULL; watchDir = watchDir -> nextDir)
 		{
-			/*----------------------------------------------------------------*
-             * Recursive directories, avoid '.' and '..'                      *
-             *----------------------------------------------------------------*/
-			if (findFlags & RECUDIR &&
-					(dirList -> d_name[0] != '.' || findFlags & SHOWALL) &&
-					strcmp (dirList -> d_name, ".") && strcmp (dirList -> d_name, ".."))
-			{
-#ifdef USE_STATX
-				struct statx tempStat;
-#else
-				struct stat tempStat;
-#endif
-				char tempPath[PATH_SIZE];
-				char subPath[PATH_SIZE];
+			struct stat dirStat;
 
-				*endPath = 0;
-				strcpy (tempPath, fullPath);
-				strcat_ch (tempPath, DIRSEP);
-				strcat (tempPath, dirList -> d_name);
+			if (stat (watchDir -> dirPath, &dirStat) != 0 ||
+					watchDir -> mtimeSec != dirStat.st_mtim.tv_sec || watchDir -> mtimeNsec != dirStat.st_mtim.tv_nsec ||
+					watchDir -> ctimeSec != dirStat.st_ctim.tv_sec || watchDir -> ctimeNsec != dirStat.st_ctim.tv_nsec)
+				watchDir -> dirChanged = true;
+		}
+	}
 
-#ifdef USE_STATX
-				if (statx (AT_FDCWD, tempPath, AT_SYMLINK_NOFOLLOW, STATX_ALL, &tempStat) == 0)
-#else
-				if (lstat (tempPath, &tempStat) == 0)
-#endif
-				{
-					if (getEntryType (&tempStat) & ONLYLINKS && findFlags & RECULINK)
-					{
-						ssize_t linkSize;
-						char linkPath[PATH_SIZE + 4];
-						if ((linkSize = readlink (tempPath, linkPath, PATH_SIZE)) >= 0)
-						{
-#ifdef USE_STATX
-							struct statx linkStat;
+	/*------------------------------------------------------------------------*
+     * Directories read again go to the front, so are not seen twice          *
+     *------------------------------------------------------------------------*/
+	for (watchDir = dirWatch -> firstDir; watchDir != NULL; watchDir = nextDir)
+	{
+		nextDir = watchDir -> nextDir;
+		if (watchDir -> dirChanged)
+		{
+			watchReloadDir (dirWatch, watchDir);
+			++changeCount;
+		}
+	}
+	return changeCount;
 #else
-							struct stat linkStat;
+	return -1;
 #endif
-							linkPath[linkSize] = 0;
-#ifdef USE_STATX
-							if (statx (AT_FDCWD, linkPath, AT_SYMLINK_NOFOLLOW, STATX_ALL, &linkStat) == 0)
-#else
-							if (lstat (linkPath, &linkStat) == 0)
-#endif
-							{
-								if (getEntryType (&linkStat) & ONLYDIRS)
-								{
-									char subPath[PATH_SIZE + 4];
-
-									strcat_ch (linkPath, DIRSEP);
-									strcpy (subPath, linkPath);
-									strcat (linkPath, filePattern);
-									filesFound += directoryLoadInt (linkPath, subPath, findFlags, compareFunc, fileList, level);
-								}
-							}
-						}
-					}
-					else if (getEntryType (&tempStat) & ONLYDIRS)
-					{
-						/*----------------------------------------------------*
-                         * Hide any directories linked with version control   *
-                         *----------------------------------------------------*/
-						if (findFlags & HIDEVERCTL)
-						{
-							if (strcmp (dirList -> d_name, "CVS") == 0 ||
-									strcmp (dirList -> d_name, ".git") == 0 ||
-									strcmp (dirList -> d_name, ".svn") == 0)
-							{
-								continue;
-							}
-						}
-						strcpy (tempPath, fullPath);
-						strcat_ch (tempPath, DIRSEP);
-						strcat (tempPath, dirList -> d_name);
-						strcat_ch (tempPath, DIRSEP);
-						strcat (tempPath, filePattern);
-
-						strcpy (subPath, partPath);
-						strcat (subPath, dirList -> d_name);
-						strcat_ch (subPath, DIRSEP);
-
-						filesFound += directoryLoadInt (tempPath, subPath, findFlags, compareFunc, fileList, level);
-					}
-				}
-				else
-				{
-					printf ("Stat failed: [%d]\n", errno);
-				}
-			}
+}
 
-			/*----------------------------------------------------------------*
-             * Does this file match our pattern, if yes then show it to the   *
-             * user.                                                          *
-             *----------------------------------------------------------------*/
-			if (matchLogic (dirList -> d_name, filePattern, findFlags))
-			{
-				DIR_ENTRY *saveEntry = malloc (sizeof (DIR_ENTRY));
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  W A T C H  L I S T                                                                             *
+ *  =====================================                                                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Put the entries of a watched tree on a list, they still belong to the watch so the list must be
+ *  read with directoryRead and freed with queueDelete, not directoryProcess.
+ *  \param watchHandle Handle from directoryWatchOpen.
+ *  \param fileList List to add the entries to, created if NULL.
+ *  \result The number of entries added.
+ */
+int directoryWatchList (void *watchHandle, void **fileList)
+{
+	DIR_WATCH *dirWatch = (DIR_WATCH *)watchHandle;
+	DIR_WATCH_DIR *watchDir;
+	int i, filesFound = 0;
 
-				if (saveEntry != NULL)
-				{
-					memset (saveEntry, 0, sizeof (DIR_ENTRY));
-					saveEntry -> fileName = malloc (strlen (dirList -> d_name) + 1);
-					saveEntry -> fullPath = malloc (strlen (fullPath) + 1);
-					saveEntry -> partPath = malloc (strlen (partPath) + 1);
-
-					*endPath = 0;
-					strcpy (saveEntry -> fileName, dirList -> d_name);
-					strcpy (saveEntry -> fullPath, fullPath);
-					strcpy (saveEntry -> partPath, partPath);
-					strcpy (endPath, dirList -> d_name);
-					saveEntry -> match = 0;
-					saveEntry -> Compare = (comparePtr *)compareFunc;
-
-					/*------------------------------------------------------------*
-		             * The 'STAT' function we get the full low down on file and   *
-		             * stores it in fileStat                                      *
-		             *------------------------------------------------------------*/
-#ifdef USE_STATX
-					if (statx (AT_FDCWD, fullPath, AT_SYMLINK_NOFOLLOW, STATX_ALL, &saveEntry -> fileStat) != 0)
-#else
-					if (lstat (fullPath, &saveEntry -> fileStat) != 0)
-#endif
-					{
-						printf ("Stat failed: [2:%d]\n", errno);
-					}
+	if (!(*fileList))
+	{
+		if ((*fileList = queueCreate ()) == NULL)
+			return 0;
+	}
+	for (watchDir = dirWatch -> firstDir; watchDir != NULL; watchDir = watchDir -> nextDir)
+	{
+		for (i = 0; i < watchDir -> entryCount; ++i)
+		{
+			DIR_ENTRY *readEntry = watchDir -> dirEntries[i];
 
-					if (getEntryType (&saveEntry -> fileStat) & findFlags)
-					{
-						if (strlen (saveEntry -> fileName) > queueGetFreeData (*fileList))
-							queueSetFreeData (*fileList, strlen (saveEntry -> fileName));
+			if (strlen (readEntry -> fileName) > queueGetFreeData (*fileList))
+				queueSetFreeData (*fileList, strlen (readEntry -> fileName));
 
-						queuePut (*fileList, saveEntry);
-						filesFound ++;
-					}
-					else
-					{
-						free (saveEntry -> partPath);
-						free (saveEntry -> fullPath);
-						free (saveEntry -> fileName);
-						free (saveEntry);
-					}
-				}
-			}
+			queuePut (*fileList, readEntry);
+			++filesFound;
 		}
-		/*--------------------------------------------------------------------*
-         * All done so close the directory and tell them how many files and   *
-         * directories were found                                             *
-         *--------------------------------------------------------------------*/
-		closedir (dirPtr);
 	}
 	return filesFound;
 }
 
 /**********************************************************************************************************************
  *                                                                                                                    *
- *  D I R E C T O R Y  L O A D                                                                                        *
- *  ==========================                                                                                        *
+ *  D I R E C T O R Y  W A T C H  C L O S E                                                                           *
+ *  =======================================                                                                           *
  *                                                                                                                    *
  **********************************************************************************************************************/
 /**
- *  \brief Read the contents of a directory into memory.
- *  \param inPath The path to the directory to be process.
- *  \param findFlags Various options to select what files to read.
- *  \param Compare Function to compare two directory entries.
- *  \param fileList Where to save the directory.
- *  \result The number of files found.
+ *  \brief Stop watching a tree and free all its entries.
+ *  \param watchHandle Handle from directoryWatchOpen.
+ *  \result None.
  */
-int directoryLoad (char *inPath, int findFlags, compareFile *Compare, void **fileList)
+void directoryWatchClose (void *watchHandle)
 {
-	return directoryLoadInt (inPath, "", findFlags, Compare, fileList, 0);
+	DIR_WATCH *dirWatch = (DIR_WATCH *)watchHandle;
+
+	if (dirWatch != NULL)
+	{
+		while (dirWatch -> firstDir != NULL)
+		{
+			watchDropDir (dirWatch, dirWatch -> firstDir, false);
+		}
+		close (dirWatch -> watchFd);
+#ifdef USE_URING
+		statRingDelete (dirWatch -> loadInfo.statRing);
+#endif
+		visitedFree (&dirWatch -> loadInfo);
+		matchFree (dirWatch -> loadInfo.fileMatch);
+		free (dirWatch -> pathHash);
+		free (dirWatch -> watchIndex);
+		free (dirWatch -> rootPath);
+		free (dirWatch);
+	}
 }
 
 /**********************************************************************************************************************
@@ -409,6 +4468,97 @@ int directorySort (void **fileList)
 	return 1;
 }
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  S O R T  K E Y                                                                                 *
+ *  =================================                                                                                 *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Sort the directory, radix sorting on a number from each file when there is one.
+ *  \param fileList List of files.
+ *  \param SortKey Function to get the number, it must not go down as the files go up in the sort order, files with
+ *  the same number are then compared, NULL to only compare.
+ *  \param threads Number of threads to sort with, 0 for one per CPU, only use more than 1 if the compare function
+ *  can be called by more than one thread at once.
+ *  \result 1 if OK.
+ */
+int directorySortKey (void **fileList, sortKeyFile *SortKey, int threads)
+{
+	queueSortKey (*fileList, (void *)listCompare, (sortKeyPtr *)SortKey, threads);
+	return 1;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  S O R T  B Y T E S                                                                             *
+ *  =====================================                                                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Sort the directory on a key made once for each file, the keys are compared with memcmp.
+ *  \param fileList List of files.
+ *  \param MakeKey Function to write the key for a file in to the buffer, returns the bytes used, 0 if the key does
+ *  not fit or cannot be made.
+ *  \param threads Number of threads to sort with, 0 for one per CPU.
+ *  \result 1 if sorted on the keys, 0 if a key could not be made and the files were compared.
+ */
+int directorySortBytes (void **fileList, sortBytesFile *MakeKey, int threads)
+{
+	void *current = NULL;
+	DIR_ENTRY *dirEntry;
+	unsigned char *keyBuff;
+	int keyLen = 1;
+
+	if ((keyBuff = (unsigned char *)malloc (SORT_KEY_SIZE)) == NULL)
+	{
+		keyLen = 0;
+	}
+
+	/*------------------------------------------------------------------------*
+     * Make every key before the sort, keys from an earlier sort are used     *
+     * again if the new key fits                                              *
+     *------------------------------------------------------------------------*/
+
+	while (keyLen > 0 && (dirEntry = (DIR_ENTRY *)queueReadNext (*fileList, &current)) != NULL)
+	{
+		if ((keyLen = MakeKey (dirEntry, keyBuff, SORT_KEY_SIZE)) > 0)
+		{
+			if (dirEntry -> sortKey == NULL || dirEntry -> sortKeyLen < (unsigned int)keyLen)
+			{
+				if (dirEntry -> sortKey != NULL)
+				{
+					directoryFree (dirEntry, dirEntry -> sortKey);
+				}
+				if ((dirEntry -> sortKey = (unsigned char *)directoryAlloc (dirEntry, keyLen)) == NULL)
+				{
+					keyLen = 0;
+					break;
+				}
+			}
+			memcpy (dirEntry -> sortKey, keyBuff, keyLen);
+			dirEntry -> sortKeyLen = keyLen;
+		}
+	}
+	if (keyBuff != NULL)
+	{
+		free (keyBuff);
+	}
+
+	/*------------------------------------------------------------------------*
+     * Without a key for every file fall back to the compare function, it     *
+     * may not be safe to call from more than one thread                      *
+     *------------------------------------------------------------------------*/
+
+	if (keyLen <= 0)
+	{
+		queueSortKey (*fileList, (void *)listCompare, NULL, 1);
+		return 0;
+	}
+	queueSortKey (*fileList, (void *)listKeyCompare, NULL, threads);
+	return 1;
+}
+
 /**********************************************************************************************************************
  *                                                                                                                    *
  *  D I R E C T O R Y  P R O C E S S                                                                                  *
@@ -432,27 +4582,7 @@ int directoryProcess (int(*ProcFile)(DIR_ENTRY *dirEntry),	void **fileList)
 		{
 			++filesProcessed;
 		}
-		if (readEntry -> md5Sum != NULL)
-		{
-			free (readEntry -> md5Sum);
-		}
-		if (readEntry -> sha256Sum != NULL)
-		{
-			free (readEntry -> sha256Sum);
-		}
-		if (readEntry -> fileVer != NULL)
-		{
-			if (readEntry -> fileVer -> fileStart != NULL)
-			{
-				free (readEntry -> fileVer -> fileStart);
-			}
-			free (readEntry -> fileVer);
-		}
-		free (readEntry -> fileName);
-		free (readEntry -> fullPath);
-		free (readEntry -> partPath);
-
-		free (readEntry);
+		directoryFreeEntry (readEntry);
 	}
 	queueDelete (*fileList);
 	*fileList = NULL;
@@ -488,6 +4618,44 @@ int directoryRead (int(*ReadFile)(DIR_ENTRY *dirEntry),	void **fileList)
 	return filesRead;
 }
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  A L L O C                                                                                      *
+ *  ============================                                                                                      *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Allocate memory to add to an entry, it comes from the same arena as the entry.
+ *  \param dirEntry Entry the memory is for.
+ *  \param size Number of bytes needed.
+ *  \result Pointer to the memory, NULL if out of memory.
+ */
+void *directoryAlloc (DIR_ENTRY *dirEntry, size_t size)
+{
+	if (dirEntry -> entryArena != NULL)
+		return queueAlloc (dirEntry -> entryArena, size);
+
+	return malloc (size);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  F R E E                                                                                        *
+ *  ==========================                                                                                        *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Free memory from directoryAlloc, arena memory is left for the list to free.
+ *  \param dirEntry Entry the memory was for.
+ *  \param memory Memory to free.
+ *  \result None.
+ */
+void directoryFree (DIR_ENTRY *dirEntry, void *memory)
+{
+	if (dirEntry -> entryArena == NULL)
+		free (memory);
+}
+
 /**********************************************************************************************************************
  *                                                                                                                    *
  *  D I R E C T O R Y  T R U E  L I N K  T Y P E                                                                      *
@@ -512,6 +4680,11 @@ mode_t directoryTrueLinkType (DIR_ENTRY *dirEntry)
 	{
 		int linkSize = 0;
 		char linkBuff[1025], fullName[PATH_SIZE];
+#ifdef USE_STATX
+		struct statx linkStat;
+#else
+		struct stat linkStat;
+#endif
 
 		if (level++ == 0)
 		{
@@ -522,8 +4695,9 @@ mode_t directoryTrueLinkType (DIR_ENTRY *dirEntry)
 		{
 			linkBuff[linkSize] = 0;
 #ifdef USE_STATX
-			if (statx (AT_FDCWD, linkBuff, AT_SYMLINK_NOFOLLOW, STATX_ALL, &dirEntry -> fileStat) == 0)
+			if (statx (AT_FDCWD, linkBuff, AT_SYMLINK_NOFOLLOW, loadStatMask, &linkStat) == 0)
 			{
+				directorySaveStat (dirEntry, &linkStat);
 				retn = dirEntry -> fileStat.stx_mode;
 				if (S_ISLNK (dirEntry -> fileStat.stx_mode))
 				{
@@ -536,8 +4710,9 @@ mode_t directoryTrueLinkType (DIR_ENTRY *dirEntry)
 				err = 1;
 			}
 #else
-			if (lstat (linkBuff, &dirEntry -> fileStat) == 0)
+			if (lstat (linkBuff, &linkStat) == 0)
 			{
+				directorySaveStat (dirEntry, &linkStat);
 				retn = dirEntry -> fileStat.st_mode;
 				if (S_ISLNK (dirEntry -> fileStat.st_mode))
 				{
@@ -560,6 +4735,40 @@ mode_t directoryTrueLinkType (DIR_ENTRY *dirEntry)
 	return retn;
 }
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I R E C T O R Y  S T A T  F U L L                                                                               *
+ *  ===================================                                                                               *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Get the full stat for an entry, it is read again if the entry only kept the common fields.
+ *  \param dirEntry Entry to get the stat for.
+ *  \param fileStat Where to save the stat.
+ *  \result 0 if all OK, -1 if the stat failed.
+ */
+#ifdef USE_STATX
+int directoryStatFull (DIR_ENTRY *dirEntry, struct statx *fileStat)
+#else
+int directoryStatFull (DIR_ENTRY *dirEntry, struct stat *fileStat)
+#endif
+{
+	char fullName[PATH_SIZE];
+
+	if (dirEntry -> statSize == sizeof (dirEntry -> fileStat))
+	{
+		memcpy (fileStat, &dirEntry -> fileStat, sizeof (dirEntry -> fileStat));
+		return 0;
+	}
+	strcpy (fullName, dirEntry -> fullPath);
+	strncat (fullName, dirEntry -> fileName, PATH_SIZE - strlen (fullName) - 1);
+#ifdef USE_STATX
+	return statx (AT_FDCWD, fullName, AT_SYMLINK_NOFOLLOW, STATX_ALL, fileStat);
+#else
+	return lstat (fullName, fileStat);
+#endif
+}
+
 /**********************************************************************************************************************
  *                                                                                                                    *
  *  L I S T  C O M P A R E                                                                                            *
@@ -580,6 +4789,32 @@ static int listCompare (const void **item1, const void **item2)
 	return (dirOne -> Compare (dirOne, dirTwo));
 }
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  L I S T  K E Y  C O M P A R E                                                                                     *
+ *  =============================                                                                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Function called to compare the keys of two directory items.
+ *  \param item1 First item to compare.
+ *  \param item2 Second item to compare with.
+ *  \result Less than, equal to or greater than 0 as memcmp.
+ */
+static int listKeyCompare (const void **item1, const void **item2)
+{
+	DIR_ENTRY *dirOne = (DIR_ENTRY *)*item1;
+	DIR_ENTRY *dirTwo = (DIR_ENTRY *)*item2;
+	unsigned int keyLen = (dirOne -> sortKeyLen < dirTwo -> sortKeyLen ? dirOne -> sortKeyLen : dirTwo -> sortKeyLen);
+	int retn = memcmp (dirOne -> sortKey, dirTwo -> sortKey, keyLen);
+
+	if (retn == 0)
+	{
+		retn = (dirOne -> sortKeyLen < dirTwo -> sortKeyLen ? -1 : dirOne -> sortKeyLen > dirTwo -> sortKeyLen ? 1 : 0);
+	}
+	return retn;
+}
+
 #ifdef USE_STATX
 /**********************************************************************************************************************
  *                                                                                                                    *
@@ -109,7 +109,7 @@
 
 /** 
  *  @def HIDEVERCTL
- *  @brief Tide the version control subdirectories.
+ *  @brief Hide the version control subdirectories, CVS, .git and .svn, using the exclude rules.
  */
 #define HIDEVERCTL				0x0800
 
@@ -119,6 +119,31 @@
  */
 #define RECULINK				0x1000
 
+/**
+ *  @def SKIPSTAT
+ *  @brief Only the file type is needed, do not stat if the directory gives it.
+ */
+#define SKIPSTAT				0x2000
+
+/**
+ *  @def COMPACTSTAT
+ *  @brief Only keep the common stat fields (type, mode, size, times, owner, inode and links) in each entry.
+ */
+#define COMPACTSTAT				0x4000
+
+/**
+ *  @def SAMEDEVICE
+ *  @brief With RECUDIR only read sub-directories on the same device as the directory given.
+ */
+#define SAMEDEVICE				0x8000
+
+/**
+ *  @def STREAMWHOLE
+ *  @brief With directoryStream read all of each directory before its entries are handed over, for call backs that
+ *  rename files.
+ */
+#define STREAMWHOLE				0x10000
+
 /** 
  *  @def COL_ALIGN_RIGHT
  *  @brief Flag set if the column should be right aligned.
@@ -155,12 +180,41 @@
 #define DISPLAY_ENCODE_HEX		0	// Default
 #define DISPLAY_ENCODE_BASE64	1
 
+/** 
+ *  @def CRC_READ_MMAP
+ *  @brief Flag set if large files should be mapped rather than read when making check sums.
+ *
+ *  Used in crcSetReadFlags, the others ask for the access time not to be changed and for the
+ *  file to be dropped from the page cache once it has been read.
+ */
+#define CRC_READ_MMAP			0x0001
+#define CRC_READ_NOATIME		0x0002
+#define CRC_READ_DONTNEED		0x0004
+
+/**
+ *  @def CRC_DIGEST_MD5
+ *  @brief Flag set to make an MD5 check sum.
+ *
+ *  Used in crcDigestFile and crcFileDigests, the output buffers are in the same order as the flags.
+ */
+#define CRC_DIGEST_MD5			0x0001
+#define CRC_DIGEST_SHA1			0x0002
+#define CRC_DIGEST_SHA256		0x0004
+#define CRC_DIGEST_SHA512		0x0008
+#define CRC_DIGEST_COUNT		4
+
 /**
  *  @typedef comparePtr
  *  @brief Function pointer for comparing objects of unknown type.
  */
 typedef int (comparePtr)(const void *first, const void *second);
 
+/**
+ *  @typedef sortKeyPtr
+ *  @brief Function pointer for getting a number to sort objects of unknown type on.
+ */
+typedef unsigned long long (sortKeyPtr)(const void *item);
+
 /**
  *  @struct columnDesc dircmd.h
  *  @brief Used when calling displayColumnInit.
@@ -209,9 +263,9 @@ struct dirEntry
 {
 	/** Name of the file */
 	char *fileName;
-	/** Path to the file */
+	/** Path to the file, read only as it may be shared with entries from the same directory */
 	char *fullPath;
-	/** Path as it goes into sub directories */
+	/** Path as it goes into sub directories, read only like fullPath */
 	char *partPath;
 	/** MD5 checksum if needed */
 	unsigned char *md5Sum;
@@ -219,16 +273,26 @@ struct dirEntry
 	unsigned char *sha256Sum;
 	/** Version extracted from the name */
 	struct dirFileVerInfo *fileVer;
-	/** Directory information */
+	/** Key made by directorySortBytes, the files sort in the order of their keys */
+	unsigned char *sortKey;
+	/** Number of bytes in sortKey */
+	unsigned int sortKeyLen;
+	/** Was a match found, or free for other counts */
+	unsigned int match;
+	/** Pointer to function used to compare the files */
+	comparePtr *Compare;
+	/** List the entry was allocated from, NULL if it was not */
+	void *entryArena;
+	/** Bytes of fileStat that are kept, less than its size when loaded with COMPACTSTAT */
+	unsigned int statSize;
+	/** CRC_DIGEST flags of the check sums already tried, a file that cannot be read is only tried once */
+	unsigned int digestsTried;
+	/** Directory information, must be last as COMPACTSTAT entries only hold the start of it */
 #ifdef USE_STATX
 	struct statx fileStat;
 #else
 	struct stat fileStat;
 #endif
-	/** Was a match found, or free for other counts */
-	unsigned int match;
-	/** Pointer to function used to compare the files */
-	comparePtr *Compare;
 };
 
 /**
@@ -243,6 +307,17 @@ typedef struct dirEntry DIR_ENTRY;
  */
 typedef int (compareFile)(DIR_ENTRY *first, DIR_ENTRY *second);
 
+/**
+ *  @typedef sortKeyFile
+ *  @brief Function pointer for getting a number to sort a file on.
+ */
+typedef unsigned long long (sortKeyFile)(DIR_ENTRY *file);
+/**
+ *  @typedef sortBytesFile
+ *  @brief Function pointer for making a key to sort a file on, returns the number of bytes used.
+ */
+typedef int (sortBytesFile)(DIR_ENTRY *file, unsigned char *keyBuff, int buffSize);
+
 #ifdef __cplusplus
 #define EXTERNC extern "C"
 #else
@@ -254,11 +329,34 @@ typedef int (compareFile)(DIR_ENTRY *first, DIR_ENTRY *second);
  */
 EXTERNC char *directoryVersion(void);
 EXTERNC int directoryLoad (char *inPath, int findFlags, compareFile Compare, void **fileList);
+EXTERNC int directoryLoadTop (char *inPath, int findFlags, compareFile Compare, int(*KeepFile)(DIR_ENTRY *f1),
+		int topCount, void **fileList);
+EXTERNC int directoryStream (char *inPath, int findFlags, int(*ProcFile)(DIR_ENTRY *f1), int lookAhead);
+EXTERNC void directorySetThreads (int threads);
+EXTERNC void directorySetMaxDepth (int maxDepth);
+EXTERNC void directorySetStatMask (unsigned int statMask);
+EXTERNC int directoryExcludeAdd (char *excludeRule);
+EXTERNC void directorySetExcludeFile (char *fileName);
+EXTERNC int directoryCacheOpen (char *cacheFile);
+EXTERNC int directoryCacheClose (void);
+EXTERNC void *directoryWatchOpen (char *inPath, int findFlags, compareFile Compare);
+EXTERNC int directoryWatchWait (void *watchHandle, int waitTime);
+EXTERNC int directoryWatchList (void *watchHandle, void **fileList);
+EXTERNC void directoryWatchClose (void *watchHandle);
 EXTERNC int directoryRead (int(*ReadFile)(DIR_ENTRY *f1), void **fileList);
 EXTERNC int directoryDefCompare (DIR_ENTRY *fileOne, DIR_ENTRY *fileTwo);
 EXTERNC int directorySort (void **fileList);
+EXTERNC int directorySortKey (void **fileList, sortKeyFile SortKey, int threads);
+EXTERNC int directorySortBytes (void **fileList, sortBytesFile MakeKey, int threads);
 EXTERNC int directoryProcess (int(*ProcFile)(DIR_ENTRY *f1), void **fileList);
 EXTERNC mode_t directoryTrueLinkType (DIR_ENTRY *f1);
+#ifdef USE_STATX
+EXTERNC int directoryStatFull (DIR_ENTRY *f1, struct statx *fileStat);
+#else
+EXTERNC int directoryStatFull (DIR_ENTRY *f1, struct stat *fileStat);
+#endif
+EXTERNC void *directoryAlloc (DIR_ENTRY *dirEntry, size_t size);
+EXTERNC void directoryFree (DIR_ENTRY *dirEntry, void *memory);
 
 /*
  *  crc.c
@@ -266,6 +364,9 @@ EXTERNC mode_t directoryTrueLinkType (DIR_ENTRY *f1);
 EXTERNC int CRCFile (char *filename);
 EXTERNC int MD5File (char *filename, unsigned char *md5Buffer);
 EXTERNC int SHA256File (char *filename, unsigned char *md5Buffer);
+EXTERNC void crcSetReadFlags (int flags);
+EXTERNC int crcDigestFile (char *filename, int digests, unsigned char *outBuffers[]);
+EXTERNC int crcFileDigests (DIR_ENTRY *file, int digests);
 
 /*
  *  display.c
@@ -284,6 +385,7 @@ EXTERNC char *displayGroupString (int groupID, char *outString);
 EXTERNC char *displayContextString (char *fullpath, char *outString);
 EXTERNC char *displayMD5String (DIR_ENTRY *file, char *outString, int encode);
 EXTERNC char *displaySHA256String (DIR_ENTRY *file, char *outString, int encode);
+EXTERNC void displaySetDigests (int digests);
 EXTERNC char *displayVerString (DIR_ENTRY *file, char *outString);
 EXTERNC void displayGetWindowSize (void);
 EXTERNC void displayForceSize (int cols, int rows);
@@ -319,13 +421,45 @@ EXTERNC void *queueReadNext (void *queueHandle, void **queueCurrent);
 EXTERNC void queueSetFreeData (void *queueHandle, unsigned long setData);
 EXTERNC unsigned long queueGetFreeData (void *queueHandle);
 EXTERNC unsigned long queueGetItemCount (void *queueHandle);
+EXTERNC void queueReverse (void *queueHandle);
 EXTERNC void queueSort (void *queueHandle, comparePtr Compare);
+EXTERNC void queueSortKey (void *queueHandle, comparePtr Compare, sortKeyPtr SortKey, int threads);
+EXTERNC void *queueAlloc (void *queueHandle, size_t size);
+EXTERNC void queueMoveArena (void *queueHandle, void *fromHandle);
+EXTERNC void *hashCreate (void);
+EXTERNC void hashDelete (void *hashHandle);
+EXTERNC void *hashAlloc (void *hashHandle, size_t size);
+EXTERNC bool hashPutString (void *hashHandle, const char *hashKey, void *putData);
+EXTERNC void *hashGetString (void *hashHandle, const char *hashKey);
+EXTERNC void *hashRemoveString (void *hashHandle, const char *hashKey);
+EXTERNC bool hashPutNumber (void *hashHandle, unsigned long long hashKey, void *putData);
+EXTERNC void *hashGetNumber (void *hashHandle, unsigned long long hashKey);
+EXTERNC void *hashRemoveNumber (void *hashHandle, unsigned long long hashKey);
+EXTERNC void *hashReadNext (void *hashHandle, void **hashCurrent);
+EXTERNC unsigned long hashGetItemCount (void *hashHandle);
+
+/*
+ *  ring.c
+ */
+EXTERNC void *ringCreate (unsigned long ringSize);
+EXTERNC void ringDelete (void *ringHandle);
+EXTERNC bool ringPut (void *ringHandle, void *putData);
+EXTERNC void *ringGet (void *ringHandle);
+EXTERNC unsigned long ringGetItemCount (void *ringHandle);
+EXTERNC void *chainCreate (void);
+EXTERNC void chainDelete (void *chainHandle);
+EXTERNC bool chainPut (void *chainHandle, void *putData);
+EXTERNC void *chainGet (void *chainHandle);
+EXTERNC unsigned long chainGetItemCount (void *chainHandle);
 
 /*
  *  match.c
  */
 EXTERNC int matchLogic (char *str, char *ptn, int flags);
 EXTERNC int matchPattern (char *str, char *ptn, int flags);
+EXTERNC void *matchCompile (char *ptn, int flags);
+EXTERNC int matchExec (void *compiled, char *str);
+EXTERNC void matchFree (void *compiled);
 
 /*
  * config.c
@@ -75,6 +75,7 @@ static int ncols = -1, nrows = -1;
 static int displayStartLine = 0;
 static int displayEndLine = MAXINT;
 static int displayLines = 0;
+static int displayDigests = 0;
 static time_t timeNow;
 static time_t timeDay;
 static time_t timeWeek;
@@ -670,18 +671,7 @@ char *displayMD5String (DIR_ENTRY *file, char *outString, int encode)
 {
 	if (file -> md5Sum == NULL)
 	{
-		if ((file -> md5Sum = malloc (17)) != NULL)
-		{
-			char fullName[1024];
-
-			strcpy (fullName, file -> fullPath);
-			strcat (fullName, file -> fileName);
-			if (!MD5File (fullName, file -> md5Sum))
-			{
-				free (file -> md5Sum);
-				file -> md5Sum = NULL;
-			}
-		}
+		crcFileDigests (file, displayDigests | CRC_DIGEST_MD5);
 	}
 	outString[0] = 0;
 	if (file -> md5Sum)
@@ -717,18 +707,7 @@ char *displaySHA256String (DIR_ENTRY *file, char *outString, int encode)
 {
 	if (file -> sha256Sum == NULL)
 	{
-		if ((file -> sha256Sum = malloc (33)) != NULL)
-		{
-			char fullName[1024];
-
-			strcpy (fullName, file -> fullPath);
-			strcat (fullName, file -> fileName);
-			if (!SHA256File (fullName, file -> sha256Sum))
-			{
-				free (file -> sha256Sum);
-				file -> sha256Sum = NULL;
-			}
-		}
+		crcFileDigests (file, displayDigests | CRC_DIGEST_SHA256);
 	}
 	outString[0] = 0;
 	if (file -> sha256Sum != NULL)
@@ -747,6 +726,22 @@ char *displaySHA256String (DIR_ENTRY *file, char *outString, int encode)
 	return outString;
 }
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  D I S P L A Y  S E T  D I G E S T S                                                                               *
+ *  ===================================                                                                               *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Set the check sums that will be wanted for each file, so they are all made from one read.
+ *  \param digests CRC_DIGEST flags of the check sums.
+ *  \result None.
+ */
+void displaySetDigests (int digests)
+{
+	displayDigests = digests;
+}
+
 /**********************************************************************************************************************
  *                                                                                                                    *
  *  D I S P L A Y  V E R  S T R I N G                                                                                 *
@@ -1851,6 +1846,7 @@ void displayTidy (void)
 		if (currentRow -> colString) free (currentRow -> colString);
 		if (currentRow -> colColour) free (currentRow -> colColour);
 		free (currentRow);
+		currentRow = NULL;
 	}
 
 	while ((displayRow = (ROW_DESC *)queueGet (rowQueue)) != NULL)
@@ -1893,5 +1889,8 @@ void displayTidy (void)
 	columnCount = 0;
 	queueDelete (rowQueue);
 	rowQueue = NULL;
+	displayStartLine = 0;
+	displayEndLine = MAXINT;
+	displayLines = 0;
 }
 
@@ -19,7 +19,7 @@
  **********************************************************************************************************************/
 /**
  *  \file
- *  \brief Functions to a generic linked list.
+ *  \brief Functions for a generic queue, the items are kept in blocks so any of them can be read directly.
  */
 #include "config.h"
 #define _GNU_SOURCE
@@ -39,6 +39,7 @@
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <linux/fcntl.h>
+#include <pthread.h>
 #ifdef HAVE_VALUES_H
 #include <values.h>
 #else
@@ -47,31 +48,50 @@
 
 #include "dircmd.h"
 
+#define ARENA_BLOCK_SIZE	(256 * 1024)
+#define ARENA_ALIGN			16
+#define ARENA_HEADER		((sizeof (QUEUE_ARENA) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+#define QUEUE_BLOCK_SHIFT	9
+#define QUEUE_BLOCK_ITEMS	(1 << QUEUE_BLOCK_SHIFT)
+#define QUEUE_BLOCK_MASK	(QUEUE_BLOCK_ITEMS - 1)
+#define QUEUE_SEQ_START		(~0UL >> 2)
+#define QUEUE_INDEX_MIN		8
+#define QUEUE_SLOT(q, i)	((q) -> blockIndex[((q) -> firstItem + (i)) >> QUEUE_BLOCK_SHIFT] \
+							[((q) -> firstItem + (i)) & QUEUE_BLOCK_MASK])
+#define HASH_MIN_SIZE		64
+#define HASH_INDEX(k, m)	(((k) ^ ((k) >> 32)) & (m))
+#define SORT_INSERT_RUN		16
+#define SORT_THREAD_MIN		16384
+#define SORT_MAX_DEPTH		6
+
 /**********************************************************************************************************************
  *                                                                                                                    *
- * Structure to hold an item on the queue                                                                             *
+ * Structure to hold a block of memory that queue allocations are taken from                                          *
  *                                                                                                                    *
  **********************************************************************************************************************/
-typedef struct _queueItem
+typedef struct _queueArena
 {
-	void *myNextPtr;
-	void *myPrevPtr;
-	void *myData;
+	struct _queueArena *nextBlock;
+	size_t blockSize;
+	size_t blockUsed;
 }
-QUEUE_ITEM;
+QUEUE_ARENA;
 
 /**********************************************************************************************************************
  *                                                                                                                    *
- * Structure to hold the queue header                                                                                 *
+ * Structure to hold the queue header, the items are kept in blocks found through an index                            *
  *                                                                                                                    *
  **********************************************************************************************************************/
 typedef struct _queueHeader
 {
-	QUEUE_ITEM *firstInQueue;
-	QUEUE_ITEM *lastInQueue;
-	QUEUE_ITEM *currentItem;
+	void ***blockIndex;
+	unsigned long indexSize;
+	unsigned long firstItem;
 	unsigned long itemCount;
+	unsigned long headSeq;
 	unsigned long freeData;
+	QUEUE_ARENA *arenaBlock;
+	void **spareBlock;
 
 #ifdef MULTI_THREAD
 	pthread_mutex_t queueMutex;
@@ -79,6 +99,63 @@ typedef struct _queueHeader
 }
 QUEUE_HEADER;
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold a key and its data in a hash, an empty slot has a hash of 0                                      *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _hashEntry
+{
+	unsigned long long keyHash;
+	unsigned long long keyNumber;
+	char *keyString;
+	void *entryData;
+}
+HASH_ENTRY;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold the hash header, the queue is only used for its arena and its lock                               *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _hashHeader
+{
+	QUEUE_HEADER hashQueue;
+	HASH_ENTRY *hashTable;
+	unsigned long hashSize;
+	unsigned long itemCount;
+}
+HASH_HEADER;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold a key and the item it was taken from while radix sorting                                         *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _queueSortKey
+{
+	unsigned long long sortKey;
+	void *sortItem;
+}
+QUEUE_SORT_KEY;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold the part of a sort or merge given to a thread                                                    *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _queueSortTask
+{
+	void **sortItems;
+	void **tempItems;
+	unsigned long itemCount;
+	void **rightItems;
+	unsigned long rightCount;
+	comparePtr *Compare;
+	int sortDepth;
+}
+QUEUE_SORT_TASK;
+
 /**********************************************************************************************************************
  *                                                                                                                    *
  *  Q U E U E  L O C K                                                                                                *
@@ -115,6 +192,167 @@ static void queueUnLock (QUEUE_HEADER *myQueue)
 #endif
 }
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  Q U E U E  A R E N A  A L L O C                                                                                   *
+ *  ===============================                                                                                   *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to take memory from the queue's arena, the queue must be locked.
+ *  \param myQueue Queue that owns the arena.
+ *  \param size Number of bytes needed.
+ *  \result Pointer to the memory, NULL if out of memory.
+ */
+static void *queueArenaAlloc (QUEUE_HEADER *myQueue, size_t size)
+{
+	QUEUE_ARENA *arenaBlock = myQueue -> arenaBlock;
+
+	size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+	if (arenaBlock == NULL || arenaBlock -> blockUsed + size > arenaBlock -> blockSize)
+	{
+		QUEUE_ARENA *newBlock;
+		size_t blockSize = (size > ARENA_BLOCK_SIZE / 4 ? size : ARENA_BLOCK_SIZE);
+
+		if ((newBlock = malloc (ARENA_HEADER + blockSize)) == NULL)
+			return NULL;
+
+		newBlock -> blockSize = blockSize;
+		newBlock -> blockUsed = 0;
+
+		/*--------------------------------------------------------------------*
+         * A large request gets a block of its own, behind the current one so *
+         * the space left there is still used                                 *
+         *--------------------------------------------------------------------*/
+		if (arenaBlock != NULL && blockSize != ARENA_BLOCK_SIZE)
+		{
+			newBlock -> nextBlock = arenaBlock -> nextBlock;
+			arenaBlock -> nextBlock = newBlock;
+		}
+		else
+		{
+			newBlock -> nextBlock = arenaBlock;
+			myQueue -> arenaBlock = newBlock;
+		}
+		arenaBlock = newBlock;
+	}
+	arenaBlock -> blockUsed += size;
+	return (char *)arenaBlock + ARENA_HEADER + arenaBlock -> blockUsed - size;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  Q U E U E  B L O C K  N E W                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to get a block for items, the spare block is used first, the queue must be locked.
+ *  \param myQueue Queue the block is for.
+ *  \result Pointer to the block, NULL if out of memory.
+ */
+static void **queueBlockNew (QUEUE_HEADER *myQueue)
+{
+	void **newBlock = myQueue -> spareBlock;
+
+	if (newBlock != NULL)
+	{
+		myQueue -> spareBlock = NULL;
+		return newBlock;
+	}
+	return malloc (QUEUE_BLOCK_ITEMS * sizeof (void *));
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  Q U E U E  B L O C K  F R E E                                                                                     *
+ *  =============================                                                                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to free a block, one is kept so a queue that is filled and emptied does not keep
+ *  allocating, the queue must be locked.
+ *  \param myQueue Queue the block came from.
+ *  \param oldBlock Block no longer used.
+ *  \result None.
+ */
+static void queueBlockFree (QUEUE_HEADER *myQueue, void **oldBlock)
+{
+	if (myQueue -> spareBlock == NULL)
+		myQueue -> spareBlock = oldBlock;
+	else
+		free (oldBlock);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  Q U E U E  A D D  S L O T                                                                                         *
+ *  =========================                                                                                         *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to add a slot at the front or the end of the queue, the queue must be locked.
+ *  \param myQueue Queue to add the slot to.
+ *  \param atFront Add the slot before the first item if true, after the last if false.
+ *  \result True if the slot was added, false if out of memory.
+ */
+static bool queueAddSlot (QUEUE_HEADER *myQueue, bool atFront)
+{
+	unsigned long firstBlock = myQueue -> firstItem >> QUEUE_BLOCK_SHIFT, i;
+	unsigned long usedBlocks = ((myQueue -> firstItem + myQueue -> itemCount + QUEUE_BLOCK_MASK) >> QUEUE_BLOCK_SHIFT) -
+			firstBlock;
+	unsigned long slotPos;
+	void ***slotBlock;
+
+	/*------------------------------------------------------------------------*
+     * With no room in the index the blocks are moved to the middle of it,    *
+     * the index is doubled first if it is more than half full                *
+     *------------------------------------------------------------------------*/
+	if (atFront ? myQueue -> firstItem == 0 :
+			((myQueue -> firstItem + myQueue -> itemCount) >> QUEUE_BLOCK_SHIFT) >= myQueue -> indexSize)
+	{
+		unsigned long newSize = myQueue -> indexSize, newFirst;
+		void ***newIndex = myQueue -> blockIndex;
+
+		if (usedBlocks + 1 > newSize / 2)
+		{
+			newSize = (newSize == 0 ? QUEUE_INDEX_MIN : newSize * 2);
+			if ((newIndex = malloc (newSize * sizeof (void **))) == NULL)
+				return false;
+		}
+		newFirst = (newSize - usedBlocks) / 2;
+		if (usedBlocks)
+		{
+			memmove (&newIndex[newFirst], &myQueue -> blockIndex[firstBlock], usedBlocks * sizeof (void **));
+		}
+		for (i = 0; i < newSize; ++i)
+		{
+			if (i < newFirst || i >= newFirst + usedBlocks)
+				newIndex[i] = NULL;
+		}
+		if (newIndex != myQueue -> blockIndex)
+		{
+			free (myQueue -> blockIndex);
+			myQueue -> blockIndex = newIndex;
+			myQueue -> indexSize = newSize;
+		}
+		myQueue -> firstItem = (newFirst << QUEUE_BLOCK_SHIFT) + (myQueue -> firstItem & QUEUE_BLOCK_MASK);
+	}
+
+	slotPos = (atFront ? myQueue -> firstItem - 1 : myQueue -> firstItem + myQueue -> itemCount);
+	slotBlock = &myQueue -> blockIndex[slotPos >> QUEUE_BLOCK_SHIFT];
+	if (*slotBlock == NULL && (*slotBlock = queueBlockNew (myQueue)) == NULL)
+		return false;
+
+	if (atFront)
+	{
+		myQueue -> firstItem = slotPos;
+		myQueue -> headSeq --;
+	}
+	myQueue -> itemCount ++;
+	return true;
+}
+
 /**********************************************************************************************************************
  *                                                                                                                    *
  *  Q U E U E  C R E A T E                                                                                            *
@@ -132,11 +370,14 @@ void *queueCreate ()
 	if ((newQueue = malloc (sizeof (QUEUE_HEADER))) == NULL)
 		return NULL;
 
-	newQueue -> firstInQueue = NULL;
-	newQueue -> lastInQueue = NULL;
-	newQueue -> currentItem = NULL;
+	newQueue -> blockIndex = NULL;
+	newQueue -> indexSize = 0;
+	newQueue -> firstItem = 0;
 	newQueue -> itemCount = 0;
+	newQueue -> headSeq = QUEUE_SEQ_START;
 	newQueue -> freeData = 0;
+	newQueue -> arenaBlock = NULL;
+	newQueue -> spareBlock = NULL;
 
 #ifdef MULTI_THREAD
 	pthread_mutex_init(&newQueue -> queueMutex, NULL);
@@ -151,7 +392,7 @@ void *queueCreate ()
  *                                                                                                                    *
  **********************************************************************************************************************/
 /**
- *  \brief Delete a queue.
+ *  \brief Delete a queue, anything taken from its arena is freed with it.
  *  \param queueHandle Handle of the queue to delete, returned from create.
  *  \result None.
  */
@@ -159,14 +400,99 @@ void queueDelete (void *queueHandle)
 {
 	if (queueHandle)
 	{
-#ifdef MULTI_THREAD
 		QUEUE_HEADER *myQueue = (QUEUE_HEADER *)queueHandle;
+		QUEUE_ARENA *arenaBlock;
+		unsigned long i;
+
+		while ((arenaBlock = myQueue -> arenaBlock) != NULL)
+		{
+			myQueue -> arenaBlock = arenaBlock -> nextBlock;
+			free (arenaBlock);
+		}
+		for (i = 0; i < myQueue -> indexSize; ++i)
+		{
+			free (myQueue -> blockIndex[i]);
+		}
+		free (myQueue -> blockIndex);
+		free (myQueue -> spareBlock);
+#ifdef MULTI_THREAD
 		pthread_mutex_destroy(&myQueue -> queueMutex);
 #endif
 		free (queueHandle);
 	}
 }
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  Q U E U E  A L L O C                                                                                              *
+ *  ====================                                                                                              *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Allocate memory that belongs to the queue, it is all freed in one go by queueDelete.
+ *  \param queueHandle Handle of the queue, returned from create.
+ *  \param size Number of bytes needed.
+ *  \result Pointer to the memory, NULL if out of memory.
+ */
+void *queueAlloc (void *queueHandle, size_t size)
+{
+	void *retn = NULL;
+
+	if (queueHandle)
+	{
+		QUEUE_HEADER *myQueue = (QUEUE_HEADER *)queueHandle;
+
+		queueLock (myQueue);
+		retn = queueArenaAlloc (myQueue, size);
+		queueUnLock (myQueue);
+	}
+	return retn;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  Q U E U E  M O V E  A R E N A                                                                                     *
+ *  =============================                                                                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Move the memory allocated from one queue on to another, so it lives as long as that queue.
+ *  \param queueHandle Handle of the queue to move the memory to.
+ *  \param fromHandle Handle of the queue to move the memory from.
+ *  \result None.
+ */
+void queueMoveArena (void *queueHandle, void *fromHandle)
+{
+	if (queueHandle && fromHandle)
+	{
+		QUEUE_HEADER *myQueue = (QUEUE_HEADER *)queueHandle;
+		QUEUE_HEADER *fromQueue = (QUEUE_HEADER *)fromHandle;
+		QUEUE_ARENA *lastBlock;
+
+		queueLock (fromQueue);
+		if ((lastBlock = fromQueue -> arenaBlock) != NULL)
+		{
+			while (lastBlock -> nextBlock != NULL)
+				lastBlock = lastBlock -> nextBlock;
+
+			queueLock (myQueue);
+			if (myQueue -> arenaBlock != NULL)
+			{
+				lastBlock -> nextBlock = myQueue -> arenaBlock -> nextBlock;
+				myQueue -> arenaBlock -> nextBlock = fromQueue -> arenaBlock;
+			}
+			else
+			{
+				myQueue -> arenaBlock = fromQueue -> arenaBlock;
+			}
+			queueUnLock (myQueue);
+
+			fromQueue -> arenaBlock = NULL;
+		}
+		queueUnLock (fromQueue);
+	}
+}
+
 /**********************************************************************************************************************
  *                                                                                                                    *
  *  Q U E U E  G E T                                                                                                  *
@@ -185,22 +511,30 @@ void *queueGet (void *queueHandle)
 	if (queueHandle)
 	{
 		QUEUE_HEADER *myQueue = (QUEUE_HEADER *)queueHandle;
-		QUEUE_ITEM *oldQueueItem;
 
 		queueLock (myQueue);
-		if (myQueue -> firstInQueue)
+		if (myQueue -> itemCount)
 		{
-			oldQueueItem = myQueue -> firstInQueue;
-			retn = oldQueueItem -> myData;
-			myQueue -> firstInQueue = oldQueueItem -> myNextPtr;
-			free (oldQueueItem);
+			retn = QUEUE_SLOT (myQueue, 0);
+			myQueue -> firstItem ++;
+			myQueue -> itemCount --;
+			myQueue -> headSeq ++;
 
-			if (myQueue -> firstInQueue)
-				myQueue -> firstInQueue -> myPrevPtr = NULL;
-			else
-				myQueue -> lastInQueue = NULL;
+			/*----------------------------------------------------------------*
+             * Free a block once it has been read, an empty queue starts      *
+             * again in the middle of the index                               *
+             *----------------------------------------------------------------*/
+			if (myQueue -> itemCount == 0 || (myQueue -> firstItem & QUEUE_BLOCK_MASK) == 0)
+			{
+				unsigned long oldBlock = (myQueue -> firstItem - 1) >> QUEUE_BLOCK_SHIFT;
 
-			myQueue -> itemCount --;
+				queueBlockFree (myQueue, myQueue -> blockIndex[oldBlock]);
+				myQueue -> blockIndex[oldBlock] = NULL;
+				if (myQueue -> itemCount == 0)
+				{
+					myQueue -> firstItem = (myQueue -> indexSize / 2) << QUEUE_BLOCK_SHIFT;
+				}
+			}
 		}
 		queueUnLock (myQueue);
 	}
@@ -224,25 +558,12 @@ void queuePut (void *queueHandle, void *putData)
 	if (queueHandle)
 	{
 		QUEUE_HEADER *myQueue = (QUEUE_HEADER *)queueHandle;
-		QUEUE_ITEM *newQueueItem;
-
-		if ((newQueueItem = malloc (sizeof (QUEUE_ITEM))) == NULL)
-			return;
-
-		newQueueItem -> myNextPtr = newQueueItem -> myPrevPtr = NULL;
-		newQueueItem -> myData = putData;
 
 		queueLock (myQueue);
-		if (myQueue -> lastInQueue)
+		if (queueAddSlot (myQueue, false))
 		{
-			myQueue -> lastInQueue -> myNextPtr = newQueueItem;
-			newQueueItem -> myPrevPtr = myQueue -> lastInQueue;
-			myQueue -> lastInQueue = newQueueItem;
+			QUEUE_SLOT (myQueue, myQueue -> itemCount - 1) = putData;
 		}
-		else
-			myQueue -> firstInQueue = myQueue -> lastInQueue = newQueueItem;
-
-		myQueue -> itemCount ++;
 		queueUnLock (myQueue);
 	}
 }
@@ -264,25 +585,12 @@ void queuePush (void *queueHandle, void *putData)
 	if (queueHandle)
 	{
 		QUEUE_HEADER *myQueue = (QUEUE_HEADER *)queueHandle;
-		QUEUE_ITEM *newQueueItem;
-
-		if ((newQueueItem = malloc (sizeof (QUEUE_ITEM))) == NULL)
-			return;
-
-		newQueueItem -> myNextPtr = newQueueItem -> myPrevPtr = NULL;
-		newQueueItem -> myData = putData;
 
 		queueLock (myQueue);
-		if (myQueue -> firstInQueue)
+		if (queueAddSlot (myQueue, true))
 		{
-			myQueue -> firstInQueue -> myPrevPtr = newQueueItem;
-			newQueueItem -> myNextPtr = myQueue -> firstInQueue;
-			myQueue -> firstInQueue = newQueueItem;
+			QUEUE_SLOT (myQueue, 0) = putData;
 		}
-		else
-			myQueue -> firstInQueue = myQueue -> lastInQueue = newQueueItem;
-
-		myQueue -> itemCount ++;
 		queueUnLock (myQueue);
 	}
 }
@@ -305,52 +613,36 @@ void queuePutSort (void *queueHandle, void *putData, comparePtr *Compare)
 	if (queueHandle)
 	{
 		QUEUE_HEADER *myQueue = (QUEUE_HEADER *)queueHandle;
-		QUEUE_ITEM *newQueueItem;
-
-		if ((newQueueItem = malloc (sizeof (QUEUE_ITEM))) == NULL)
-			return;
-
-		newQueueItem -> myNextPtr = newQueueItem -> myPrevPtr = NULL;
-		newQueueItem -> myData = putData;
+		unsigned long putPos = 0, i;
 
 		queueLock (myQueue);
-		if (myQueue -> firstInQueue)
+		while (putPos < myQueue -> itemCount && Compare (putData, QUEUE_SLOT (myQueue, putPos)) >= 0)
 		{
-			QUEUE_ITEM *currentItem = myQueue -> firstInQueue;
+			putPos ++;
+		}
 
-			while (currentItem)
+		/*--------------------------------------------------------------------*
+         * Make room by moving the items on the shorter side of the new one   *
+         *--------------------------------------------------------------------*/
+		if (putPos < myQueue -> itemCount / 2)
+		{
+			if (queueAddSlot (myQueue, true))
 			{
-				int comp = Compare (putData, currentItem -> myData);
-
-				if (comp < 0)
+				for (i = 0; i < putPos; ++i)
 				{
-					newQueueItem -> myPrevPtr = currentItem -> myPrevPtr;
-					newQueueItem -> myNextPtr = currentItem;
-
-					if (newQueueItem -> myPrevPtr)
-					{
-						QUEUE_ITEM *tempItem = newQueueItem -> myPrevPtr;
-						tempItem -> myNextPtr = newQueueItem;
-					}
-					else
-						myQueue -> firstInQueue = newQueueItem;
-
-					currentItem -> myPrevPtr = newQueueItem;
-					break;
+					QUEUE_SLOT (myQueue, i) = QUEUE_SLOT (myQueue, i + 1);
 				}
-				currentItem = currentItem -> myNextPtr;
+				QUEUE_SLOT (myQueue, putPos) = putData;
 			}
-			if (!currentItem)
+		}
+		else if (queueAddSlot (myQueue, false))
+		{
+			for (i = myQueue -> itemCount - 1; i > putPos; --i)
 			{
-				myQueue -> lastInQueue -> myNextPtr = newQueueItem;
-				newQueueItem -> myPrevPtr = myQueue -> lastInQueue;
-				myQueue -> lastInQueue = newQueueItem;
+				QUEUE_SLOT (myQueue, i) = QUEUE_SLOT (myQueue, i - 1);
 			}
+			QUEUE_SLOT (myQueue, putPos) = putData;
 		}
-		else
-			myQueue -> firstInQueue = myQueue -> lastInQueue = newQueueItem;
-
-		myQueue -> itemCount ++;
 		queueUnLock (myQueue);
 	}
 }
@@ -374,17 +666,12 @@ void *queueRead (void *queueHandle, int item)
 	if (queueHandle)
 	{
 		QUEUE_HEADER *myQueue = (QUEUE_HEADER *)queueHandle;
-		QUEUE_ITEM *currentItem = myQueue -> firstInQueue;
 
 		queueLock (myQueue);
-		while (currentItem && item > 0)
+		if (item >= 0 && (unsigned long)item < myQueue -> itemCount)
 		{
-			currentItem = currentItem -> myNextPtr;
-			item --;
+			retn = QUEUE_SLOT (myQueue, item);
 		}
-		if (currentItem)
-			retn = currentItem -> myData;
-
 		queueUnLock (myQueue);
 	}
 	return retn;
@@ -397,9 +684,9 @@ void *queueRead (void *queueHandle, int item)
  *                                                                                                                    *
  **********************************************************************************************************************/
 /**
- *  \brief Allows quick iteration over the queue, use with care.
+ *  \brief Allows quick iteration over the queue, the place survives gets and pushes but not sorts.
  *  \param queueHandle Handle of the queue, returned from create.
- *  \param queueCurrent The pointer to the last item returned.
+ *  \param queueCurrent Set to NULL to read the first item, it then holds the place of the last item returned.
  *  \result A pointer to the item or NULL if none found.
  */
 void *queueReadNext (void *queueHandle, void **queueCurrent)
@@ -409,21 +696,22 @@ void *queueReadNext (void *queueHandle, void **queueCurrent)
 	if (queueHandle)
 	{
 		QUEUE_HEADER *myQueue = (QUEUE_HEADER *)queueHandle;
-		QUEUE_ITEM *currentItem = *queueCurrent;
+		unsigned long readPos = 0;
 
 		queueLock (myQueue);
-		if (currentItem == NULL)
+		if (*queueCurrent != NULL)
 		{
-			currentItem = myQueue -> firstInQueue;
+			/*----------------------------------------------------------------*
+             * If the next item has been got carry on from the front          *
+             *----------------------------------------------------------------*/
+			readPos = (unsigned long)*queueCurrent - myQueue -> headSeq;
+			if ((long)readPos < 0)
+				readPos = 0;
 		}
-		else
-		{
-			currentItem = currentItem -> myNextPtr;
-		}
-		if (currentItem)
+		if (readPos < myQueue -> itemCount)
 		{
-			retn = currentItem -> myData;
-			*queueCurrent = currentItem;
+			retn = QUEUE_SLOT (myQueue, readPos);
+			*queueCurrent = (void *)(myQueue -> headSeq + readPos + 1);
 		}
 		queueUnLock (myQueue);
 	}
@@ -507,69 +795,923 @@ unsigned long queueGetItemCount (void *queueHandle)
 
 /**********************************************************************************************************************
  *                                                                                                                    *
- *  Q U E U E  S O R T                                                                                                *
- *  ==================                                                                                                *
+ *  Q U E U E  R E V E R S E                                                                                          *
+ *  ========================                                                                                          *
  *                                                                                                                    *
  **********************************************************************************************************************/
 /**
- *  \brief Sort the list.
+ *  \brief Reverse the order of the items in the queue.
  *  \param queueHandle Handle of the queue, returned from create.
- *  \param Compare Function to cpmpare two list items.
  *  \result None.
  */
-void queueSort (void *queueHandle, comparePtr *Compare)
+void queueReverse (void *queueHandle)
 {
 	if (queueHandle)
 	{
-		char *tempArray, **tempPtr;
 		QUEUE_HEADER *myQueue = (QUEUE_HEADER *)queueHandle;
-		QUEUE_ITEM *queueItem, *queueItemNext;
-		int itemCount, i = 0;
+		unsigned long first, last;
+		void *saveItem;
 
 		queueLock (myQueue);
-		itemCount = myQueue -> itemCount;
-		if (itemCount == 0)
+		for (first = 0, last = myQueue -> itemCount; first + 1 < last; ++first)
 		{
-			queueUnLock (myQueue);
-			return;
+			--last;
+			saveItem = QUEUE_SLOT (myQueue, first);
+			QUEUE_SLOT (myQueue, first) = QUEUE_SLOT (myQueue, last);
+			QUEUE_SLOT (myQueue, last) = saveItem;
+		}
+		queueUnLock (myQueue);
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  Q U E U E  S O R T  I T E M S                                                                                     *
+ *  =============================                                                                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to merge sort an array, short runs are binary insertion sorted.
+ *  \param sortItems Items to sort, they are sorted in place.
+ *  \param tempItems Space for as many items to merge into.
+ *  \param itemCount Number of items.
+ *  \param Compare Function to compare two items, it is passed pointers to the array slots.
+ *  \result None.
+ */
+static void queueSortItems (void **sortItems, void **tempItems, unsigned long itemCount, comparePtr *Compare)
+{
+	unsigned long i, halfCount = itemCount / 2, leftPos = 0, rightPos = halfCount, outPos = 0;
+
+	if (itemCount <= SORT_INSERT_RUN)
+	{
+		for (i = 1; i < itemCount; ++i)
+		{
+			void *saveItem = sortItems[i];
+			unsigned long lowPos = 0, highPos = i;
+
+			while (lowPos < highPos)
+			{
+				unsigned long midPos = lowPos + (highPos - lowPos) / 2;
+
+				if (Compare (&sortItems[midPos], &saveItem) > 0)
+					highPos = midPos;
+				else
+					lowPos = midPos + 1;
+			}
+			memmove (&sortItems[lowPos + 1], &sortItems[lowPos], (i - lowPos) * sizeof (void *));
+			sortItems[lowPos] = saveItem;
 		}
-		if ((tempArray = malloc (sizeof (char *) * itemCount)) != NULL)
+		return;
+	}
+
+	/*------------------------------------------------------------------------*
+     * Sort each half while it is still in the cache, they need no merge if   *
+     * they are already in order                                              *
+     *------------------------------------------------------------------------*/
+	queueSortItems (sortItems, tempItems, halfCount, Compare);
+	queueSortItems (&sortItems[halfCount], &tempItems[halfCount], itemCount - halfCount, Compare);
+	if (Compare (&sortItems[halfCount - 1], &sortItems[halfCount]) <= 0)
+		return;
+
+	while (leftPos < halfCount && rightPos < itemCount)
+	{
+		if (Compare (&sortItems[leftPos], &sortItems[rightPos]) <= 0)
+			tempItems[outPos++] = sortItems[leftPos++];
+		else
+			tempItems[outPos++] = sortItems[rightPos++];
+	}
+	while (leftPos < halfCount)
+		tempItems[outPos++] = sortItems[leftPos++];
+
+	memcpy (sortItems, tempItems, outPos * sizeof (void *));
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  Q U E U E  M E R G E  I T E M S                                                                                   *
+ *  ===============================                                                                                   *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to merge two sorted arrays, splitting the work between threads.
+ *  \param sortTask The two arrays (sortItems and rightItems), where to put them (tempItems) and how deep to split.
+ *  \result Always NULL, so it can be run as a thread.
+ */
+static void *queueMergeItems (void *sortTask)
+{
+	QUEUE_SORT_TASK *mergeTask = (QUEUE_SORT_TASK *)sortTask;
+	void **leftItems = mergeTask -> sortItems, **rightItems = mergeTask -> rightItems;
+	void **outItems = mergeTask -> tempItems;
+	unsigned long leftCount = mergeTask -> itemCount, rightCount = mergeTask -> rightCount;
+	unsigned long leftPos = 0, rightPos = 0, outPos = 0;
+	comparePtr *Compare = mergeTask -> Compare;
+
+	/*------------------------------------------------------------------------*
+     * Split at the middle of the longer array, what is before it in the      *
+     * other array goes in the first half, equal items keep their order       *
+     *------------------------------------------------------------------------*/
+	if (mergeTask -> sortDepth > 0 && leftCount + rightCount >= SORT_THREAD_MIN)
+	{
+		QUEUE_SORT_TASK firstTask, secondTask;
+		unsigned long leftSplit, rightSplit, lowPos, highPos;
+		pthread_t threadID;
+
+		if (leftCount >= rightCount)
 		{
-			i = 0;
-			tempPtr = (char **)tempArray;
-			queueItem = myQueue -> firstInQueue;
-			while (queueItem && i < itemCount)
+			leftSplit = leftCount / 2;
+			for (lowPos = 0, highPos = rightCount; lowPos < highPos; )
 			{
-				tempPtr[i++] = queueItem -> myData;
-				queueItemNext = queueItem -> myNextPtr;
-				free (queueItem);
-				queueItem = queueItemNext;
+				unsigned long midPos = lowPos + (highPos - lowPos) / 2;
+
+				if (Compare (&rightItems[midPos], &leftItems[leftSplit]) < 0)
+					lowPos = midPos + 1;
+				else
+					highPos = midPos;
 			}
-			myQueue -> firstInQueue = myQueue -> lastInQueue = NULL;
-			qsort (&tempPtr[0], itemCount, sizeof (char *), Compare);
-			for (i = 0; i < itemCount; i++)
+			rightSplit = lowPos;
+		}
+		else
+		{
+			rightSplit = rightCount / 2;
+			for (lowPos = 0, highPos = leftCount; lowPos < highPos; )
 			{
-				if ((queueItem = malloc (sizeof (QUEUE_ITEM))) == NULL)
-				{
-					myQueue -> itemCount = i;
-					break;
-				}
-				queueItem -> myNextPtr = queueItem -> myPrevPtr = NULL;
-				queueItem -> myData = tempPtr[i];
-				if (myQueue -> lastInQueue)
-				{
-					myQueue -> lastInQueue -> myNextPtr = queueItem;
-					queueItem -> myPrevPtr = myQueue -> lastInQueue;
-					myQueue -> lastInQueue = queueItem;
-				}
+				unsigned long midPos = lowPos + (highPos - lowPos) / 2;
+
+				if (Compare (&leftItems[midPos], &rightItems[rightSplit]) <= 0)
+					lowPos = midPos + 1;
 				else
-				{
-					myQueue -> firstInQueue = myQueue -> lastInQueue = queueItem;
-				}
+					highPos = midPos;
 			}
-			free (tempArray);
+			leftSplit = lowPos;
 		}
-		queueUnLock (myQueue);
+
+		firstTask = secondTask = *mergeTask;
+		firstTask.itemCount = leftSplit;
+		firstTask.rightCount = rightSplit;
+		firstTask.sortDepth = secondTask.sortDepth = mergeTask -> sortDepth - 1;
+		secondTask.sortItems = &leftItems[leftSplit];
+		secondTask.itemCount = leftCount - leftSplit;
+		secondTask.rightItems = &rightItems[rightSplit];
+		secondTask.rightCount = rightCount - rightSplit;
+		secondTask.tempItems = &outItems[leftSplit + rightSplit];
+
+		if (pthread_create (&threadID, NULL, queueMergeItems, &firstTask) == 0)
+		{
+			queueMergeItems (&secondTask);
+			pthread_join (threadID, NULL);
+		}
+		else
+		{
+			queueMergeItems (&firstTask);
+			queueMergeItems (&secondTask);
+		}
+		return NULL;
 	}
-}
 
+	while (leftPos < leftCount && rightPos < rightCount)
+	{
+		if (Compare (&leftItems[leftPos], &rightItems[rightPos]) <= 0)
+			outItems[outPos++] = leftItems[leftPos++];
+		else
+			outItems[outPos++] = rightItems[rightPos++];
+	}
+	while (leftPos < leftCount)
+		outItems[outPos++] = leftItems[leftPos++];
+	while (rightPos < rightCount)
+		outItems[outPos++] = rightItems[rightPos++];
+
+	return NULL;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  Q U E U E  S O R T  P A R A L L E L                                                                               *
+ *  ===================================                                                                               *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to sort an array, each half is sorted by its own thread then they are merged.
+ *  \param sortTask The array to sort (sortItems), space to merge into (tempItems) and how deep to split.
+ *  \result Always NULL, so it can be run as a thread.
+ */
+static void *queueSortParallel (void *sortTask)
+{
+	QUEUE_SORT_TASK *mainTask = (QUEUE_SORT_TASK *)sortTask;
+	QUEUE_SORT_TASK firstTask, secondTask, mergeTask;
+	unsigned long halfCount = mainTask -> itemCount / 2;
+	pthread_t threadID;
+
+	if (mainTask -> sortDepth <= 0 || mainTask -> itemCount < SORT_THREAD_MIN * 2)
+	{
+		queueSortItems (mainTask -> sortItems, mainTask -> tempItems, mainTask -> itemCount, mainTask -> Compare);
+		return NULL;
+	}
+
+	firstTask = secondTask = *mainTask;
+	firstTask.itemCount = halfCount;
+	firstTask.sortDepth = secondTask.sortDepth = mainTask -> sortDepth - 1;
+	secondTask.sortItems = &mainTask -> sortItems[halfCount];
+	secondTask.tempItems = &mainTask -> tempItems[halfCount];
+	secondTask.itemCount = mainTask -> itemCount - halfCount;
+
+	if (pthread_create (&threadID, NULL, queueSortParallel, &firstTask) == 0)
+	{
+		queueSortParallel (&secondTask);
+		pthread_join (threadID, NULL);
+	}
+	else
+	{
+		queueSortParallel (&firstTask);
+		queueSortParallel (&secondTask);
+	}
+
+	/*------------------------------------------------------------------------*
+     * Merge the two halves into the spare array, then copy them back         *
+     *------------------------------------------------------------------------*/
+	mergeTask = *mainTask;
+	mergeTask.itemCount = halfCount;
+	mergeTask.rightItems = secondTask.sortItems;
+	mergeTask.rightCount = secondTask.itemCount;
+	queueMergeItems (&mergeTask);
+	memcpy (mainTask -> sortItems, mainTask -> tempItems, mainTask -> itemCount * sizeof (void *));
+	return NULL;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  Q U E U E  R A D I X  S O R T                                                                                     *
+ *  =============================                                                                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to sort on a number taken from each item, items with the same number are then compared.
+ *  \param sortItems Items to sort, they are sorted in place.
+ *  \param tempItems Space for as many items, used to sort items with the same number.
+ *  \param itemCount Number of items.
+ *  \param SortKey Function to get the number, it must not go down as the items go up in the sort order.
+ *  \param Compare Function to compare two items, it is passed pointers to the array slots.
+ *  \result True if sorted, false if out of memory.
+ */
+static bool queueRadixSort (void **sortItems, void **tempItems, unsigned long itemCount, sortKeyPtr *SortKey,
+		comparePtr *Compare)
+{
+	QUEUE_SORT_KEY *sortKeys, *fromKeys, *toKeys, *swapKeys;
+	unsigned long (*keyCounts)[256], i, runStart;
+	int keyByte;
+
+	if ((sortKeys = malloc (itemCount * 2 * sizeof (QUEUE_SORT_KEY))) == NULL)
+		return false;
+
+	if ((keyCounts = calloc (8, sizeof (*keyCounts))) == NULL)
+	{
+		free (sortKeys);
+		return false;
+	}
+
+	/*------------------------------------------------------------------------*
+     * Get all the keys and count every byte of them in one pass              *
+     *------------------------------------------------------------------------*/
+	for (i = 0; i < itemCount; ++i)
+	{
+		unsigned long long sortKey = SortKey (sortItems[i]);
+
+		sortKeys[i].sortKey = sortKey;
+		sortKeys[i].sortItem = sortItems[i];
+		for (keyByte = 0; keyByte < 8; ++keyByte)
+		{
+			++keyCounts[keyByte][(sortKey >> (keyByte * 8)) & 0xFF];
+		}
+	}
+
+	/*------------------------------------------------------------------------*
+     * Least significant byte first, a byte that is the same in every key     *
+     * does not need a pass                                                   *
+     *------------------------------------------------------------------------*/
+	fromKeys = sortKeys;
+	toKeys = &sortKeys[itemCount];
+	for (keyByte = 0; keyByte < 8; ++keyByte)
+	{
+		unsigned long *byteCounts = keyCounts[keyByte], bytePos = 0;
+		int shift = keyByte * 8;
+
+		if (byteCounts[(fromKeys[0].sortKey >> shift) & 0xFF] == itemCount)
+			continue;
+
+		for (i = 0; i < 256; ++i)
+		{
+			unsigned long count = byteCounts[i];
+
+			byteCounts[i] = bytePos;
+			bytePos += count;
+		}
+		for (i = 0; i < itemCount; ++i)
+		{
+			toKeys[byteCounts[(fromKeys[i].sortKey >> shift) & 0xFF]++] = fromKeys[i];
+		}
+		swapKeys = fromKeys;
+		fromKeys = toKeys;
+		toKeys = swapKeys;
+	}
+
+	/*------------------------------------------------------------------------*
+     * Copy the items back, those with the same key are then compared         *
+     *------------------------------------------------------------------------*/
+	for (i = 0; i < itemCount; ++i)
+	{
+		sortItems[i] = fromKeys[i].sortItem;
+	}
+	for (runStart = 0, i = 1; i <= itemCount; ++i)
+	{
+		if (i == itemCount || fromKeys[i].sortKey != fromKeys[runStart].sortKey)
+		{
+			if (i - runStart > 1)
+			{
+				queueSortItems (&sortItems[runStart], tempItems, i - runStart, Compare);
+			}
+			runStart = i;
+		}
+	}
+	free (keyCounts);
+	free (sortKeys);
+	return true;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  Q U E U E  S O R T                                                                                                *
+ *  ==================                                                                                                *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Sort the list.
+ *  \param queueHandle Handle of the queue, returned from create.
+ *  \param Compare Function to cpmpare two list items.
+ *  \result None.
+ */
+void queueSort (void *queueHandle, comparePtr *Compare)
+{
+	queueSortKey (queueHandle, Compare, NULL, 1);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  Q U E U E  S O R T  K E Y                                                                                         *
+ *  =========================                                                                                         *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Sort the list.
+ *  \param queueHandle Handle of the queue, returned from create.
+ *  \param Compare Function to compare two list items, it is passed pointers to the items.
+ *  \param SortKey Function to get a number from an item to radix sort on, NULL to only compare.
+ *  \param threads Number of threads to merge sort with, 0 for one per CPU, only use more than 1 if Compare can be
+ *  called by more than one thread at once.
+ *  \result None.
+ */
+void queueSortKey (void *queueHandle, comparePtr *Compare, sortKeyPtr *SortKey, int threads)
+{
+	if (queueHandle)
+	{
+		QUEUE_HEADER *myQueue = (QUEUE_HEADER *)queueHandle;
+		void **sortItems, **tempItems;
+		unsigned long itemCount, i;
+
+		queueLock (myQueue);
+		itemCount = myQueue -> itemCount;
+		if (itemCount == 0 || (sortItems = malloc (sizeof (void *) * itemCount)) == NULL)
+		{
+			queueUnLock (myQueue);
+			return;
+		}
+
+		/*--------------------------------------------------------------------*
+         * The items are copied out of the blocks to be sorted in one array,  *
+         * then copied back in their new order                                *
+         *--------------------------------------------------------------------*/
+		for (i = 0; i < itemCount; ++i)
+		{
+			sortItems[i] = QUEUE_SLOT (myQueue, i);
+		}
+		if ((tempItems = malloc (sizeof (void *) * itemCount)) == NULL)
+		{
+			qsort (sortItems, itemCount, sizeof (void *), Compare);
+		}
+		else if (SortKey == NULL || !queueRadixSort (sortItems, tempItems, itemCount, SortKey, Compare))
+		{
+			QUEUE_SORT_TASK sortTask;
+
+			if (threads <= 0)
+			{
+				threads = sysconf (_SC_NPROCESSORS_ONLN);
+			}
+			memset (&sortTask, 0, sizeof (QUEUE_SORT_TASK));
+			sortTask.sortItems = sortItems;
+			sortTask.tempItems = tempItems;
+			sortTask.itemCount = itemCount;
+			sortTask.Compare = Compare;
+			while (sortTask.sortDepth < SORT_MAX_DEPTH && (2 << sortTask.sortDepth) <= threads)
+			{
+				++sortTask.sortDepth;
+			}
+			queueSortParallel (&sortTask);
+		}
+		for (i = 0; i < itemCount; ++i)
+		{
+			QUEUE_SLOT (myQueue, i) = sortItems[i];
+		}
+		free (tempItems);
+		free (sortItems);
+		queueUnLock (myQueue);
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  S T R I N G                                                                                              *
+ *  ====================                                                                                              *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to hash a string key, never returns 0 as that marks an empty slot.
+ *  \param hashKey String to hash.
+ *  \result The hash of the string.
+ */
+static unsigned long long hashString (const char *hashKey)
+{
+	unsigned long long hashVal = 14695981039346656037ULL;
+
+	while (*hashKey)
+	{
+		hashVal = (hashVal ^ (unsigned char)*hashKey++) * 1099511628211ULL;
+	}
+	return (hashVal ? hashVal : 1);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  N U M B E R                                                                                              *
+ *  ====================                                                                                              *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to hash a number key, never returns 0 as that marks an empty slot.
+ *  \param hashKey Number to hash.
+ *  \result The hash of the number.
+ */
+static unsigned long long hashNumber (unsigned long long hashKey)
+{
+	unsigned long long hashVal = hashKey * 0x9E3779B97F4A7C15ULL;
+
+	hashVal ^= hashVal >> 29;
+	return (hashVal ? hashVal : 1);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  F I N D                                                                                                  *
+ *  ================                                                                                                  *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to find the slot for a key, the hash must be locked.
+ *  \param myHash Hash to look in.
+ *  \param keyHash Hash of the key.
+ *  \param keyString String key, NULL for a number key.
+ *  \param keyNumber Number key, not used for a string key.
+ *  \result The slot holding the key, or the empty slot where it would go, NULL if the table is empty.
+ */
+static HASH_ENTRY *hashFind (HASH_HEADER *myHash, unsigned long long keyHash, const char *keyString,
+		unsigned long long keyNumber)
+{
+	unsigned long hashIdx;
+
+	if (myHash -> hashSize == 0)
+		return NULL;
+
+	hashIdx = HASH_INDEX (keyHash, myHash -> hashSize - 1);
+	while (myHash -> hashTable[hashIdx].keyHash)
+	{
+		HASH_ENTRY *hashEntry = &myHash -> hashTable[hashIdx];
+
+		if (hashEntry -> keyHash == keyHash)
+		{
+			if (keyString == NULL ? hashEntry -> keyString == NULL && hashEntry -> keyNumber == keyNumber :
+					hashEntry -> keyString != NULL && strcmp (hashEntry -> keyString, keyString) == 0)
+			{
+				return hashEntry;
+			}
+		}
+		hashIdx = (hashIdx + 1) & (myHash -> hashSize - 1);
+	}
+	return &myHash -> hashTable[hashIdx];
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  G R O W                                                                                                  *
+ *  ================                                                                                                  *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to double the size of the table when it is half full, the hash must be locked.
+ *  \param myHash Hash to grow.
+ *  \result True if there is room for another key, false if out of memory.
+ */
+static bool hashGrow (HASH_HEADER *myHash)
+{
+	HASH_ENTRY *newTable, *oldTable = myHash -> hashTable;
+	unsigned long i, oldSize = myHash -> hashSize;
+
+	if ((myHash -> itemCount + 1) * 2 <= myHash -> hashSize)
+		return true;
+
+	if ((newTable = calloc (oldSize == 0 ? HASH_MIN_SIZE : oldSize * 2, sizeof (HASH_ENTRY))) == NULL)
+		return false;
+
+	myHash -> hashTable = newTable;
+	myHash -> hashSize = (oldSize == 0 ? HASH_MIN_SIZE : oldSize * 2);
+	for (i = 0; i < oldSize; ++i)
+	{
+		if (oldTable[i].keyHash)
+		{
+			*hashFind (myHash, oldTable[i].keyHash, oldTable[i].keyString, oldTable[i].keyNumber) = oldTable[i];
+		}
+	}
+	free (oldTable);
+	return true;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  P U T  K E Y                                                                                             *
+ *  =====================                                                                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to add or replace a key, a string key is copied in to the hash's arena.
+ *  \param myHash Hash to add to.
+ *  \param keyHash Hash of the key.
+ *  \param keyString String key, NULL for a number key.
+ *  \param keyNumber Number key, not used for a string key.
+ *  \param putData Data to save with the key.
+ *  \result True if saved, false if out of memory.
+ */
+static bool hashPutKey (HASH_HEADER *myHash, unsigned long long keyHash, const char *keyString,
+		unsigned long long keyNumber, void *putData)
+{
+	HASH_ENTRY *hashEntry;
+	bool retn = false;
+
+	queueLock (&myHash -> hashQueue);
+	if (hashGrow (myHash))
+	{
+		hashEntry = hashFind (myHash, keyHash, keyString, keyNumber);
+		if (hashEntry -> keyHash)
+		{
+			hashEntry -> entryData = putData;
+			retn = true;
+		}
+		else
+		{
+			hashEntry -> keyString = NULL;
+			if (keyString == NULL || (hashEntry -> keyString = queueArenaAlloc (&myHash -> hashQueue,
+					strlen (keyString) + 1)) != NULL)
+			{
+				if (keyString != NULL)
+				{
+					strcpy (hashEntry -> keyString, keyString);
+				}
+				hashEntry -> keyHash = keyHash;
+				hashEntry -> keyNumber = keyNumber;
+				hashEntry -> entryData = putData;
+				++myHash -> itemCount;
+				retn = true;
+			}
+		}
+	}
+	queueUnLock (&myHash -> hashQueue);
+	return retn;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  G E T  K E Y                                                                                             *
+ *  =====================                                                                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to read or remove the data saved with a key.
+ *  \param myHash Hash to look in.
+ *  \param keyHash Hash of the key.
+ *  \param keyString String key, NULL for a number key.
+ *  \param keyNumber Number key, not used for a string key.
+ *  \param removeKey Remove the key if it is found.
+ *  \result The data saved with the key, NULL if not found.
+ */
+static void *hashGetKey (HASH_HEADER *myHash, unsigned long long keyHash, const char *keyString,
+		unsigned long long keyNumber, bool removeKey)
+{
+	HASH_ENTRY *hashEntry;
+	void *retn = NULL;
+
+	queueLock (&myHash -> hashQueue);
+	if ((hashEntry = hashFind (myHash, keyHash, keyString, keyNumber)) != NULL && hashEntry -> keyHash)
+	{
+		retn = hashEntry -> entryData;
+		if (removeKey)
+		{
+			unsigned long hashMask = myHash -> hashSize - 1;
+			unsigned long emptyIdx = hashEntry - myHash -> hashTable, hashIdx = emptyIdx;
+
+			/*----------------------------------------------------------------*
+             * Move back any key after the gap that could not be found        *
+             * through it, so the table needs no markers for removed keys     *
+             *----------------------------------------------------------------*/
+			while (1)
+			{
+				unsigned long homeIdx;
+
+				hashIdx = (hashIdx + 1) & hashMask;
+				if (myHash -> hashTable[hashIdx].keyHash == 0)
+					break;
+
+				homeIdx = HASH_INDEX (myHash -> hashTable[hashIdx].keyHash, hashMask);
+				if (((hashIdx - homeIdx) & hashMask) >= ((hashIdx - emptyIdx) & hashMask))
+				{
+					myHash -> hashTable[emptyIdx] = myHash -> hashTable[hashIdx];
+					emptyIdx = hashIdx;
+				}
+			}
+			memset (&myHash -> hashTable[emptyIdx], 0, sizeof (HASH_ENTRY));
+			--myHash -> itemCount;
+		}
+	}
+	queueUnLock (&myHash -> hashQueue);
+	return retn;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  C R E A T E                                                                                              *
+ *  ====================                                                                                              *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Create a hash, it can hold keys that are strings and keys that are numbers.
+ *  \result Returns a pointer to a hash header to be used in future calls.
+ */
+void *hashCreate (void)
+{
+	HASH_HEADER *newHash;
+
+	if ((newHash = malloc (sizeof (HASH_HEADER))) == NULL)
+		return NULL;
+
+	memset (newHash, 0, sizeof (HASH_HEADER));
+#ifdef MULTI_THREAD
+	pthread_mutex_init(&newHash -> hashQueue.queueMutex, NULL);
+#endif
+	return newHash;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  D E L E T E                                                                                              *
+ *  ====================                                                                                              *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Delete a hash, the saved data is not freed but anything from hashAlloc is.
+ *  \param hashHandle Handle of the hash, returned from create.
+ *  \result None.
+ */
+void hashDelete (void *hashHandle)
+{
+	if (hashHandle)
+	{
+		HASH_HEADER *myHash = (HASH_HEADER *)hashHandle;
+		QUEUE_ARENA *arenaBlock;
+
+		while ((arenaBlock = myHash -> hashQueue.arenaBlock) != NULL)
+		{
+			myHash -> hashQueue.arenaBlock = arenaBlock -> nextBlock;
+			free (arenaBlock);
+		}
+		free (myHash -> hashTable);
+#ifdef MULTI_THREAD
+		pthread_mutex_destroy(&myHash -> hashQueue.queueMutex);
+#endif
+		free (myHash);
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  A L L O C                                                                                                *
+ *  ==================                                                                                                *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Allocate memory that belongs to the hash, it is all freed in one go by hashDelete.
+ *  \param hashHandle Handle of the hash, returned from create.
+ *  \param size Number of bytes needed.
+ *  \result Pointer to the memory, NULL if out of memory.
+ */
+void *hashAlloc (void *hashHandle, size_t size)
+{
+	void *retn = NULL;
+
+	if (hashHandle)
+	{
+		HASH_HEADER *myHash = (HASH_HEADER *)hashHandle;
+
+		queueLock (&myHash -> hashQueue);
+		retn = queueArenaAlloc (&myHash -> hashQueue, size);
+		queueUnLock (&myHash -> hashQueue);
+	}
+	return retn;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  P U T  S T R I N G                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Save data with a string key, replacing any data already saved with it.
+ *  \param hashHandle Handle of the hash, returned from create.
+ *  \param hashKey Key to save the data with, it is copied.
+ *  \param putData Data to save, normally a pointer.
+ *  \result True if saved, false if out of memory.
+ */
+bool hashPutString (void *hashHandle, const char *hashKey, void *putData)
+{
+	if (hashHandle == NULL || hashKey == NULL)
+		return false;
+
+	return hashPutKey ((HASH_HEADER *)hashHandle, hashString (hashKey), hashKey, 0, putData);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  G E T  S T R I N G                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Read the data saved with a string key.
+ *  \param hashHandle Handle of the hash, returned from create.
+ *  \param hashKey Key to look for.
+ *  \result The data saved with the key, NULL if not found.
+ */
+void *hashGetString (void *hashHandle, const char *hashKey)
+{
+	if (hashHandle == NULL || hashKey == NULL)
+		return NULL;
+
+	return hashGetKey ((HASH_HEADER *)hashHandle, hashString (hashKey), hashKey, 0, false);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  R E M O V E  S T R I N G                                                                                 *
+ *  =================================                                                                                 *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Remove a string key, the copy of the key stays in the arena until the hash is deleted.
+ *  \param hashHandle Handle of the hash, returned from create.
+ *  \param hashKey Key to remove.
+ *  \result The data that was saved with the key, NULL if not found.
+ */
+void *hashRemoveString (void *hashHandle, const char *hashKey)
+{
+	if (hashHandle == NULL || hashKey == NULL)
+		return NULL;
+
+	return hashGetKey ((HASH_HEADER *)hashHandle, hashString (hashKey), hashKey, 0, true);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  P U T  N U M B E R                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Save data with a number key, replacing any data already saved with it.
+ *  \param hashHandle Handle of the hash, returned from create.
+ *  \param hashKey Key to save the data with.
+ *  \param putData Data to save, normally a pointer.
+ *  \result True if saved, false if out of memory.
+ */
+bool hashPutNumber (void *hashHandle, unsigned long long hashKey, void *putData)
+{
+	if (hashHandle == NULL)
+		return false;
+
+	return hashPutKey ((HASH_HEADER *)hashHandle, hashNumber (hashKey), NULL, hashKey, putData);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  G E T  N U M B E R                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Read the data saved with a number key.
+ *  \param hashHandle Handle of the hash, returned from create.
+ *  \param hashKey Key to look for.
+ *  \result The data saved with the key, NULL if not found.
+ */
+void *hashGetNumber (void *hashHandle, unsigned long long hashKey)
+{
+	if (hashHandle == NULL)
+		return NULL;
+
+	return hashGetKey ((HASH_HEADER *)hashHandle, hashNumber (hashKey), NULL, hashKey, false);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  R E M O V E  N U M B E R                                                                                 *
+ *  =================================                                                                                 *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Remove a number key.
+ *  \param hashHandle Handle of the hash, returned from create.
+ *  \param hashKey Key to remove.
+ *  \result The data that was saved with the key, NULL if not found.
+ */
+void *hashRemoveNumber (void *hashHandle, unsigned long long hashKey)
+{
+	if (hashHandle == NULL)
+		return NULL;
+
+	return hashGetKey ((HASH_HEADER *)hashHandle, hashNumber (hashKey), NULL, hashKey, true);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  R E A D  N E X T                                                                                         *
+ *  =========================                                                                                         *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Allows iteration over the data in the hash, in no order, do not change the hash while doing it.
+ *  \param hashHandle Handle of the hash, returned from create.
+ *  \param hashCurrent Set to NULL to read the first item, it then holds the place of the last item returned.
+ *  \result A pointer to the data or NULL when there is no more.
+ */
+void *hashReadNext (void *hashHandle, void **hashCurrent)
+{
+	void *retn = NULL;
+
+	if (hashHandle)
+	{
+		HASH_HEADER *myHash = (HASH_HEADER *)hashHandle;
+		unsigned long readPos = (unsigned long)*hashCurrent;
+
+		queueLock (&myHash -> hashQueue);
+		while (readPos < myHash -> hashSize)
+		{
+			if (myHash -> hashTable[readPos++].keyHash)
+			{
+				retn = myHash -> hashTable[readPos - 1].entryData;
+				*hashCurrent = (void *)readPos;
+				break;
+			}
+		}
+		queueUnLock (&myHash -> hashQueue);
+	}
+	return retn;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  H A S H  G E T  I T E M  C O U N T                                                                                *
+ *  ==================================                                                                                *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Get the number of keys in the hash.
+ *  \param hashHandle Handle of the hash, returned from create.
+ *  \result The number of keys in the hash.
+ */
+unsigned long hashGetItemCount (void *hashHandle)
+{
+	unsigned long retn = 0;
+
+	if (hashHandle)
+	{
+		HASH_HEADER *myHash = (HASH_HEADER *)hashHandle;
+
+		queueLock (&myHash -> hashQueue);
+		retn = myHash -> itemCount;
+		queueUnLock (&myHash -> hashQueue);
+	}
+	return retn;
+}
@@ -42,6 +42,7 @@
 #include <sys/types.h>
 #include <linux/fcntl.h>
 #include <ctype.h>
+#include <stdint.h>
 #include <fnmatch.h>
 #ifdef HAVE_VALUES_H
 #include <values.h>
@@ -60,6 +61,42 @@
 #define TRUE_STATE	1
 #define STOP_STATE	2
 
+#define MATCH_FNMATCH	0
+#define MATCH_LITERAL	1
+#define MATCH_PREFIX	2
+#define MATCH_SUFFIX	3
+#define MATCH_ANY		4
+
+#define WORD_ONES		0x0101010101010101ULL
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold one pattern from the expression and how it is to be matched                                      *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _matchTerm
+{
+	int matchCmd;
+	int matchType;
+	int textLen;
+	char *matchText;
+}
+MATCH_TERM;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold an expression that has been compiled by matchCompile                                             *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _matchProgram
+{
+	int matchFlags;
+	int fnFlags;
+	int termCount;
+	MATCH_TERM *matchTerms;
+}
+MATCH_PROGRAM;
+
 /*----------------------------------------------------------------------------*
  * Local Prototypes                                                           *
  *----------------------------------------------------------------------------*/
@@ -80,48 +117,289 @@ static int evalCmd (int newLogic, int oldLogic, int cmd);
  */
 int matchLogic (char *str, char *ptn, int flags)
 {
-	int lastCmd = NO_CMD, curLogic = TRUE_STATE, i = 0;
-	char *curPtn;
+	void *compiled;
+	int retn;
 
-	if ((curPtn = (char *)malloc (strlen (ptn) + 1)) == 0)
+	if ((compiled = matchCompile (ptn, flags)) == NULL)
 		return 0;
 
-	while (*ptn && !(curLogic & STOP_STATE))
+	retn = matchExec (compiled, str);
+	matchFree (compiled);
+	return retn;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  M A T C H  A D D  T E R M                                                                                         *
+ *  =========================                                                                                         *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Add a pattern to a program, simple patterns are marked so they can be matched without fnmatch.
+ *  \param program Program being compiled.
+ *  \param text The pattern, already in lower case if the match ignores case.
+ *  \param cmd The AND, OR and NOT before the pattern.
+ *  \result None.
+ */
+static void matchAddTerm (MATCH_PROGRAM *program, char *text, int cmd)
+{
+	MATCH_TERM *newTerm = &program -> matchTerms[program -> termCount++];
+	int textLen = strlen (text);
+	char *wildPtr = strpbrk (text, "*?[\\");
+
+	newTerm -> matchCmd = cmd;
+	newTerm -> matchText = text;
+	newTerm -> textLen = textLen;
+	newTerm -> matchType = MATCH_FNMATCH;
+
+	if (wildPtr == NULL)
+	{
+		newTerm -> matchType = MATCH_LITERAL;
+	}
+	else if (textLen == 1 && *wildPtr == '*')
+	{
+		newTerm -> matchType = MATCH_ANY;
+	}
+	else if (wildPtr == &text[textLen - 1] && *wildPtr == '*')
 	{
-		if (*ptn == '&')
+		newTerm -> matchType = MATCH_PREFIX;
+		newTerm -> textLen = textLen - 1;
+	}
+	else if (wildPtr == text && *wildPtr == '*' && strpbrk (&text[1], "*?[\\") == NULL)
+	{
+		newTerm -> matchType = MATCH_SUFFIX;
+		newTerm -> matchText = &text[1];
+		newTerm -> textLen = textLen - 1;
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  M A T C H  C O M P I L E                                                                                          *
+ *  ========================                                                                                          *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Parse a pattern with AND, OR and NOT once, so it can be matched against many names.
+ *  \param ptn The pattern, as used by matchLogic.
+ *  \param flags Passed to pattern match.
+ *  \result Compiled pattern for matchExec, free with matchFree, NULL if out of memory.
+ */
+void *matchCompile (char *ptn, int flags)
+{
+	MATCH_PROGRAM *program;
+	int ptnLen = strlen (ptn), lastCmd = NO_CMD, i = 0;
+	char *textPtr, *lastText = "";
+
+	if ((program = (MATCH_PROGRAM *)malloc (sizeof (MATCH_PROGRAM) + (ptnLen + 1) * sizeof (MATCH_TERM) +
+			(ptnLen + 1) * 2)) == NULL)
+		return NULL;
+
+	program -> matchFlags = flags;
+	program -> fnFlags = FNM_PATHNAME | (flags & SHOWALL ? 0 : FNM_PERIOD) | (flags & USECASE ? 0 : FNM_CASEFOLD);
+	program -> termCount = 0;
+	program -> matchTerms = (MATCH_TERM *)&program[1];
+	textPtr = (char *)&program -> matchTerms[ptnLen + 1];
+
+	/*------------------------------------------------------------------------*
+     * An empty pattern between two commands repeats the one before it        *
+     *------------------------------------------------------------------------*/
+	while (*ptn || i)
+	{
+		if (*ptn == '&' || *ptn == '|' || *ptn == 0)
 		{
-			curLogic = evalCmd (matchPattern (str, curPtn, flags), curLogic, lastCmd);
-			lastCmd = AND_CMD;
+			if (i)
+			{
+				textPtr[i] = 0;
+				lastText = textPtr;
+				textPtr += i + 1;
+			}
+			matchAddTerm (program, lastText, lastCmd);
+			lastCmd = (*ptn == '&' ? AND_CMD : OR_CMD);
 			i = 0;
-			if (curLogic == FALSE_STATE)
+			if (*ptn == 0)
 				break;
 		}
-		else if (*ptn == '|')
-		{
-			curLogic = evalCmd (matchPattern (str, curPtn, flags), curLogic, lastCmd);
-			lastCmd = OR_CMD;
-			i = 0;
-		}
 		else if (*ptn == '^' && i == 0)
 		{
 			lastCmd |= NOT_CMD;
 		}
 		else
 		{
-			curPtn[i++] = *ptn;
-			curPtn[i] = 0;
+			textPtr[i++] = (flags & USECASE ? *ptn : tolower (*ptn));
 		}
 		ptn ++;
 	}
-	if (i && !(curLogic & STOP_STATE))
+	return program;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  M A T C H  F O L D  C O M P A R E                                                                                 *
+ *  =================================                                                                                 *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Compare part of a name with lower case pattern text, ignoring the case of the name.
+ *  \param str Part of the name to compare, in any case.
+ *  \param text Pattern text, already in lower case.
+ *  \param len Number of bytes to compare.
+ *  \result True if they are the same.
+ */
+static bool matchFoldCompare (char *str, char *text, int len)
+{
+	/*------------------------------------------------------------------------*
+     * Eight ASCII bytes at a time, 'A' to 'Z' found and folded in one go     *
+     *------------------------------------------------------------------------*/
+	while (len >= 8)
 	{
-		curLogic = evalCmd (matchPattern (str, curPtn, flags), curLogic, lastCmd);
+		uint64_t strWord, textWord, upperBits;
+
+		memcpy (&strWord, str, 8);
+		memcpy (&textWord, text, 8);
+		if (strWord & (WORD_ONES * 0x80))
+			break;
+
+		upperBits = (strWord + WORD_ONES * (0x80 - 'A')) & ~(strWord + WORD_ONES * (0x80 - 'Z' - 1)) &
+				(WORD_ONES * 0x80);
+		if ((strWord | (upperBits >> 2)) != textWord)
+			return false;
+
+		str += 8;
+		text += 8;
+		len -= 8;
 	}
-	free (curPtn);
+	while (len-- > 0)
+	{
+		if (tolower (*str++) != *text++)
+			return false;
+	}
+	return true;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  M A T C H  C O M P A R E                                                                                          *
+ *  ========================                                                                                          *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Compare part of a name with pattern text, case is ignored unless the program uses it.
+ *  \param program Compiled program.
+ *  \param str Part of the name to compare.
+ *  \param text Pattern text.
+ *  \param len Number of bytes to compare.
+ *  \result True if they are the same.
+ */
+static bool matchCompare (MATCH_PROGRAM *program, char *str, char *text, int len)
+{
+	if (program -> matchFlags & USECASE)
+		return (memcmp (str, text, len) == 0);
+
+	return matchFoldCompare (str, text, len);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  M A T C H  T E R M                                                                                                *
+ *  ==================                                                                                                *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Match a name against one pattern of a program.
+ *  \param program Compiled program.
+ *  \param term The pattern to match.
+ *  \param str Name to match.
+ *  \param strLen Length of the name.
+ *  \param hasSlash True if the name has a '/', then only literals avoid fnmatch.
+ *  \result True or False.
+ */
+static int matchTerm (MATCH_PROGRAM *program, MATCH_TERM *term, char *str, int strLen, bool hasSlash)
+{
+	bool hidden = (!(program -> matchFlags & SHOWALL) && str[0] == '.');
+
+	if (term -> matchType == MATCH_LITERAL)
+		return (strLen == term -> textLen && matchCompare (program, str, term -> matchText, strLen));
+
+	if (!hasSlash)
+	{
+		switch (term -> matchType)
+		{
+		case MATCH_ANY:
+			return !hidden;
+
+		case MATCH_PREFIX:
+			return (strLen >= term -> textLen && matchCompare (program, str, term -> matchText, term -> textLen));
+
+		case MATCH_SUFFIX:
+			return (!hidden && strLen >= term -> textLen &&
+					matchCompare (program, &str[strLen - term -> textLen], term -> matchText, term -> textLen));
+		}
+	}
+	/*------------------------------------------------------------------------*
+     * Prefix and suffix patterns are kept whole, fnmatch gets the full text  *
+     *------------------------------------------------------------------------*/
+	return fnmatch (term -> matchType == MATCH_SUFFIX ? &term -> matchText[-1] : term -> matchText, str,
+			program -> fnFlags) ? FALSE_STATE : TRUE_STATE;
+}
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  M A T C H  E X E C                                                                                                *
+ *  ==================                                                                                                *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Match a name against a pattern compiled with matchCompile.
+ *  \param compiled Compiled pattern.
+ *  \param str String to try and match with.
+ *  \result True if there is a match, false if not.
+ */
+int matchExec (void *compiled, char *str)
+{
+	MATCH_PROGRAM *program = (MATCH_PROGRAM *)compiled;
+	int curLogic = TRUE_STATE, strLen = strlen (str), k;
+	bool hasSlash;
+
+	/*------------------------------------------------------------------------*
+     * The name is not copied, the pattern was folded when it was compiled    *
+     *------------------------------------------------------------------------*/
+	hasSlash = (memchr (str, '/', strLen) != NULL);
+
+	for (k = 0; k < program -> termCount; ++k)
+	{
+		MATCH_TERM *term = &program -> matchTerms[k];
+
+		curLogic = evalCmd (matchTerm (program, term, str, strLen, hasSlash), curLogic, term -> matchCmd);
+		if (curLogic & STOP_STATE)
+			break;
+
+		/*--------------------------------------------------------------------*
+         * Nothing can make it true once an AND fails                         *
+         *--------------------------------------------------------------------*/
+		if (curLogic == FALSE_STATE && k + 1 < program -> termCount &&
+				(program -> matchTerms[k + 1].matchCmd & ~NOT_CMD) == AND_CMD)
+			break;
+	}
 	return (curLogic & TRUE_STATE);
 }
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  M A T C H  F R E E                                                                                                *
+ *  ==================                                                                                                *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Free a pattern compiled with matchCompile.
+ *  \param compiled Compiled pattern, may be NULL.
+ *  \result None.
+ */
+void matchFree (void *compiled)
+{
+	free (compiled);
+}
+
 /**********************************************************************************************************************
  *                                                                                                                    *
  *  E V A L  C M D                                                                                                    *
@@ -177,27 +455,8 @@ int matchPattern (char *str, char *ptn, int flags)
 	}
 	if (!(flags & USECASE))
 	{
-		char pattern[PATH_SIZE], string[PATH_SIZE];
-		int i = 0;
-
-		while (ptn[i] && i < 255)
-		{
-			pattern[i] = tolower (ptn[i]);
-			i++;
-		}
-		pattern[i] = 0;
-
-		i = 0;
-		while (str[i] && i < 255)
-		{
-			string[i] = tolower (str[i]);
-			i++;
-		}
-		string[i] = 0;
-
-		return fnmatch(pattern, string, fnFlags) ? FALSE_STATE : TRUE_STATE;
+		fnFlags |= FNM_CASEFOLD;
 	}
-
 	return fnmatch(ptn, str, fnFlags) ? FALSE_STATE : TRUE_STATE;
 }
 
@@ -0,0 +1,748 @@
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  R I N G . C                                                                                                       *
+ *  ===========                                                                                                       *
+ *                                                                                                                    *
+ *  Copyright (c) 2023 Chris Knight                                                                                   *
+ *                                                                                                                    *
+ *  File ring.c part of LibDirCmd is free software: you can redistribute it and/or modify it under the terms of the   *
+ *  GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at  *
+ *  your option) any later version.                                                                                   *
+ *                                                                                                                    *
+ *  LibDirCmd is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied   *
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more     *
+ *  details.                                                                                                          *
+ *                                                                                                                    *
+ *  You should have received a copy of the GNU General Public License along with this program. If not, see            *
+ *  <http://www.gnu.org/licenses/>.                                                                                   *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \file
+ *  \brief Queues that many threads can put to and get from at once without taking a lock.
+ */
+#include "config.h"
+#define _GNU_SOURCE
+#include <sys/stat.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#include "dircmd.h"
+
+#define RING_LINE_SIZE		64
+#define RING_MIN_SIZE		2
+#define RING_CLOSED			(1UL << (sizeof (unsigned long) * 8 - 1))
+#define CHAIN_SEGMENT_SIZE	1024
+#define CHAIN_LIVE			0
+#define CHAIN_RETIRED		1
+#define CHAIN_POOLED		2
+#define CHAIN_TABLE_SHIFT	12
+#define CHAIN_TABLE_SIZE	(1 << CHAIN_TABLE_SHIFT)
+#define CHAIN_TABLE_MASK	(CHAIN_TABLE_SIZE - 1)
+#define CHAIN_TABLE_BLOCKS	256
+#define CHAIN_POOL_INDEX	0xFFFFFFFFULL
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold a slot in a ring, the sequence says if it is ready to be put to or read from                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _ringSlot
+{
+	unsigned long slotSeq;
+	void *slotData;
+}
+RING_SLOT;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold a ring, the put and get places are kept on their own cache lines                                 *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _ringHeader
+{
+	RING_SLOT *ringSlots;
+	unsigned long ringMask;
+	char headPad[RING_LINE_SIZE - sizeof (void *) - sizeof (unsigned long)];
+	unsigned long putPos;
+	char putPad[RING_LINE_SIZE - sizeof (unsigned long)];
+	unsigned long getPos;
+	char getPad[RING_LINE_SIZE - sizeof (unsigned long)];
+}
+RING_HEADER;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold a segment of a chain, a ring with a link to the next segment                                     *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _chainSegment
+{
+	RING_HEADER segmentRing;
+	struct _chainSegment *nextSegment;
+	unsigned int segmentIndex;
+	unsigned int poolNext;
+	unsigned int segmentUsers;
+	unsigned int segmentState;
+}
+CHAIN_SEGMENT;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ * Structure to hold a chain, segments that have been read are pooled and used again. Segments are numbered so the    *
+ * pool can be a stack whose head is a segment number and a count of changes, swapped in one go without a lock       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+typedef struct _chainHeader
+{
+	CHAIN_SEGMENT *headSegment;
+	char headPad[RING_LINE_SIZE - sizeof (void *)];
+	CHAIN_SEGMENT *tailSegment;
+	char tailPad[RING_LINE_SIZE - sizeof (void *)];
+	unsigned long itemCount;
+	unsigned long long poolHead;
+	unsigned int segmentCount;
+	CHAIN_SEGMENT **segmentTable[CHAIN_TABLE_BLOCKS];
+}
+CHAIN_HEADER;
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  R I N G  I N I T                                                                                                  *
+ *  ================                                                                                                  *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to set up a ring with its slots empty.
+ *  \param ringHeader Ring to set up.
+ *  \param ringSlots Slots for the ring.
+ *  \param ringSize Number of slots, must be a power of 2.
+ *  \result None.
+ */
+static void ringInit (RING_HEADER *ringHeader, RING_SLOT *ringSlots, unsigned long ringSize)
+{
+	unsigned long i;
+
+	for (i = 0; i < ringSize; ++i)
+	{
+		ringSlots[i].slotSeq = i;
+		ringSlots[i].slotData = NULL;
+	}
+	ringHeader -> ringSlots = ringSlots;
+	ringHeader -> ringMask = ringSize - 1;
+	ringHeader -> putPos = 0;
+	ringHeader -> getPos = 0;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  R I N G  P U T  S L O T                                                                                           *
+ *  =======================                                                                                           *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to put an item in a ring, a slot is claimed by moving the put place on past it.
+ *  \param ringHeader Ring to put the item in.
+ *  \param putData Item to put in the ring.
+ *  \result True if put, false if the ring was full or closed.
+ */
+static bool ringPutSlot (RING_HEADER *ringHeader, void *putData)
+{
+	unsigned long putPos = __atomic_load_n (&ringHeader -> putPos, __ATOMIC_RELAXED);
+
+	while (!(putPos & RING_CLOSED))
+	{
+		RING_SLOT *ringSlot = &ringHeader -> ringSlots[putPos & ringHeader -> ringMask];
+		long seqDiff = (long)(__atomic_load_n (&ringSlot -> slotSeq, __ATOMIC_ACQUIRE) - putPos);
+
+		/*--------------------------------------------------------------------*
+         * The slot is free when its sequence matches the place, if it is     *
+         * behind the slot has not been read since last time round            *
+         *--------------------------------------------------------------------*/
+		if (seqDiff == 0)
+		{
+			if (__atomic_compare_exchange_n (&ringHeader -> putPos, &putPos, putPos + 1, true,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				ringSlot -> slotData = putData;
+				__atomic_store_n (&ringSlot -> slotSeq, putPos + 1, __ATOMIC_RELEASE);
+				return true;
+			}
+		}
+		else if (seqDiff < 0)
+		{
+			return false;
+		}
+		else
+		{
+			putPos = __atomic_load_n (&ringHeader -> putPos, __ATOMIC_RELAXED);
+		}
+	}
+	return false;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  R I N G  G E T  S L O T                                                                                           *
+ *  =======================                                                                                           *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to get the first item from a ring.
+ *  \param ringHeader Ring to get the item from.
+ *  \result The item, NULL if the ring was empty or the first item is still being put.
+ */
+static void *ringGetSlot (RING_HEADER *ringHeader)
+{
+	unsigned long getPos = __atomic_load_n (&ringHeader -> getPos, __ATOMIC_RELAXED);
+
+	while (1)
+	{
+		RING_SLOT *ringSlot = &ringHeader -> ringSlots[getPos & ringHeader -> ringMask];
+		long seqDiff = (long)(__atomic_load_n (&ringSlot -> slotSeq, __ATOMIC_ACQUIRE) - (getPos + 1));
+
+		if (seqDiff == 0)
+		{
+			if (__atomic_compare_exchange_n (&ringHeader -> getPos, &getPos, getPos + 1, true,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				void *retn = ringSlot -> slotData;
+
+				__atomic_store_n (&ringSlot -> slotSeq, getPos + ringHeader -> ringMask + 1, __ATOMIC_RELEASE);
+				return retn;
+			}
+		}
+		else if (seqDiff < 0)
+		{
+			return NULL;
+		}
+		else
+		{
+			getPos = __atomic_load_n (&ringHeader -> getPos, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  R I N G  C O U N T                                                                                                *
+ *  ==================                                                                                                *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to count the items in a ring, with other threads using it this is only a guide.
+ *  \param ringHeader Ring to count.
+ *  \result Number of items put and not yet got.
+ */
+static unsigned long ringCount (RING_HEADER *ringHeader)
+{
+	unsigned long getPos = __atomic_load_n (&ringHeader -> getPos, __ATOMIC_ACQUIRE);
+	unsigned long putPos = __atomic_load_n (&ringHeader -> putPos, __ATOMIC_ACQUIRE) & ~RING_CLOSED;
+
+	return (putPos > getPos ? putPos - getPos : 0);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  R I N G  C R E A T E                                                                                              *
+ *  ====================                                                                                              *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Create a ring, a queue of a fixed size that any number of threads can put to and get from at once.
+ *  \param ringSize Number of items the ring can hold, rounded up to a power of 2.
+ *  \result Handle of the ring to be used in future calls, NULL if out of memory.
+ */
+void *ringCreate (unsigned long ringSize)
+{
+	RING_HEADER *newRing;
+	RING_SLOT *ringSlots;
+	unsigned long slotCount = RING_MIN_SIZE;
+
+	while (slotCount < ringSize && slotCount < RING_CLOSED / 2)
+	{
+		slotCount <<= 1;
+	}
+	if ((newRing = malloc (sizeof (RING_HEADER))) == NULL)
+		return NULL;
+
+	if ((ringSlots = malloc (slotCount * sizeof (RING_SLOT))) == NULL)
+	{
+		free (newRing);
+		return NULL;
+	}
+	ringInit (newRing, ringSlots, slotCount);
+	return newRing;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  R I N G  D E L E T E                                                                                              *
+ *  ====================                                                                                              *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Delete a ring, no other thread may be using it, items left in it are not freed.
+ *  \param ringHandle Handle of the ring, returned from create.
+ *  \result None.
+ */
+void ringDelete (void *ringHandle)
+{
+	if (ringHandle)
+	{
+		RING_HEADER *myRing = (RING_HEADER *)ringHandle;
+
+		free (myRing -> ringSlots);
+		free (myRing);
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  R I N G  P U T                                                                                                    *
+ *  ==============                                                                                                    *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Put an item on the end of a ring.
+ *  \param ringHandle Handle of the ring, returned from create.
+ *  \param putData Data to put on the ring, it must not be NULL.
+ *  \result True if put, false if the ring was full.
+ */
+bool ringPut (void *ringHandle, void *putData)
+{
+	if (ringHandle == NULL || putData == NULL)
+		return false;
+
+	return ringPutSlot ((RING_HEADER *)ringHandle, putData);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  R I N G  G E T                                                                                                    *
+ *  ==============                                                                                                    *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Get the first item from a ring and remove it.
+ *  \param ringHandle Handle of the ring, returned from create.
+ *  \result A pointer to the item or NULL if the ring was empty.
+ */
+void *ringGet (void *ringHandle)
+{
+	if (ringHandle == NULL)
+		return NULL;
+
+	return ringGetSlot ((RING_HEADER *)ringHandle);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  R I N G  G E T  I T E M  C O U N T                                                                                *
+ *  ==================================                                                                                *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Get the number of items in a ring, other threads may change it as soon as it is read.
+ *  \param ringHandle Handle of the ring, returned from create.
+ *  \result The number of items in the ring.
+ */
+unsigned long ringGetItemCount (void *ringHandle)
+{
+	if (ringHandle == NULL)
+		return 0;
+
+	return ringCount ((RING_HEADER *)ringHandle);
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C H A I N  S E G M E N T  A D D                                                                                   *
+ *  ===============================                                                                                   *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to give a new segment a number and a place in the chain's table of segments.
+ *  \param myChain Chain the segment is for.
+ *  \result The segment, NULL if out of memory or the table is full.
+ */
+static CHAIN_SEGMENT *chainSegmentAdd (CHAIN_HEADER *myChain)
+{
+	CHAIN_SEGMENT **tableBlock, **expectBlock = NULL, *newSegment;
+	unsigned int segmentIndex = __atomic_fetch_add (&myChain -> segmentCount, 1, __ATOMIC_RELAXED);
+	unsigned int blockIndex = segmentIndex >> CHAIN_TABLE_SHIFT;
+
+	if (blockIndex >= CHAIN_TABLE_BLOCKS)
+	{
+		__atomic_sub_fetch (&myChain -> segmentCount, 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	/*------------------------------------------------------------------------*
+     * The first segment in a block of the table adds the block, if two       *
+     * threads race the one that loses frees its copy                         *
+     *------------------------------------------------------------------------*/
+	if ((tableBlock = __atomic_load_n (&myChain -> segmentTable[blockIndex], __ATOMIC_ACQUIRE)) == NULL)
+	{
+		if ((tableBlock = calloc (CHAIN_TABLE_SIZE, sizeof (CHAIN_SEGMENT *))) == NULL)
+			return NULL;
+
+		if (!__atomic_compare_exchange_n (&myChain -> segmentTable[blockIndex], &expectBlock, tableBlock, false,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		{
+			free (tableBlock);
+			tableBlock = expectBlock;
+		}
+	}
+	if ((newSegment = malloc (sizeof (CHAIN_SEGMENT) + CHAIN_SEGMENT_SIZE * sizeof (RING_SLOT))) != NULL)
+	{
+		newSegment -> segmentUsers = 0;
+		newSegment -> segmentIndex = segmentIndex;
+		__atomic_store_n (&tableBlock[segmentIndex & CHAIN_TABLE_MASK], newSegment, __ATOMIC_RELEASE);
+	}
+	return newSegment;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C H A I N  S E G M E N T  N E W                                                                                   *
+ *  ===============================                                                                                   *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to get an empty segment, a pooled one is used first.
+ *  \param myChain Chain the segment is for.
+ *  \result The segment, NULL if out of memory.
+ */
+static CHAIN_SEGMENT *chainSegmentNew (CHAIN_HEADER *myChain)
+{
+	CHAIN_SEGMENT *newSegment = NULL;
+	unsigned long long poolHead = __atomic_load_n (&myChain -> poolHead, __ATOMIC_ACQUIRE), newHead;
+
+	/*------------------------------------------------------------------------*
+     * Take the top of the pool, segments are never freed while the chain is  *
+     * in use so reading the next number is safe, the change count in the     *
+     * head stops a segment that was taken and put back in between matching   *
+     *------------------------------------------------------------------------*/
+	while ((poolHead & CHAIN_POOL_INDEX) != 0)
+	{
+		unsigned int segmentIndex = (unsigned int)(poolHead & CHAIN_POOL_INDEX) - 1;
+
+		newSegment = __atomic_load_n (&myChain -> segmentTable[segmentIndex >> CHAIN_TABLE_SHIFT]
+				[segmentIndex & CHAIN_TABLE_MASK], __ATOMIC_ACQUIRE);
+		newHead = ((poolHead & ~CHAIN_POOL_INDEX) + (CHAIN_POOL_INDEX + 1)) |
+				__atomic_load_n (&newSegment -> poolNext, __ATOMIC_RELAXED);
+		if (__atomic_compare_exchange_n (&myChain -> poolHead, &poolHead, newHead, false,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		{
+			break;
+		}
+		newSegment = NULL;
+	}
+	if (newSegment == NULL)
+	{
+		newSegment = chainSegmentAdd (myChain);
+	}
+
+	/*------------------------------------------------------------------------*
+     * The user count is left alone, a thread that read the segment before    *
+     * it was pooled may still be dropping its count                          *
+     *------------------------------------------------------------------------*/
+	if (newSegment != NULL)
+	{
+		ringInit (&newSegment -> segmentRing, (RING_SLOT *)&newSegment[1], CHAIN_SEGMENT_SIZE);
+		newSegment -> nextSegment = NULL;
+		__atomic_store_n (&newSegment -> segmentState, CHAIN_LIVE, __ATOMIC_SEQ_CST);
+	}
+	return newSegment;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C H A I N  S E G M E N T  P O O L                                                                                 *
+ *  =================================                                                                                 *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to pool a segment so it can be used again.
+ *  \param myChain Chain the segment came from.
+ *  \param oldSegment Segment no longer linked in to the chain.
+ *  \result None.
+ */
+static void chainSegmentPool (CHAIN_HEADER *myChain, CHAIN_SEGMENT *oldSegment)
+{
+	unsigned long long poolHead = __atomic_load_n (&myChain -> poolHead, __ATOMIC_RELAXED), newHead;
+
+	do
+	{
+		__atomic_store_n (&oldSegment -> poolNext, (unsigned int)(poolHead & CHAIN_POOL_INDEX), __ATOMIC_RELAXED);
+		newHead = ((poolHead & ~CHAIN_POOL_INDEX) + (CHAIN_POOL_INDEX + 1)) | (oldSegment -> segmentIndex + 1);
+	}
+	while (!__atomic_compare_exchange_n (&myChain -> poolHead, &poolHead, newHead, false,
+			__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C H A I N  E N T E R                                                                                              *
+ *  ====================                                                                                              *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to start using the head or tail segment, it is counted so it is not pooled while in use.
+ *  \param segmentPtr The head or tail of the chain.
+ *  \result The segment now counted as in use.
+ */
+static CHAIN_SEGMENT *chainEnter (CHAIN_SEGMENT **segmentPtr)
+{
+	CHAIN_SEGMENT *mySegment;
+
+	/*------------------------------------------------------------------------*
+     * Segments are only pooled not freed so the count can always be added,   *
+     * it only protects the segment if it was still linked after the add      *
+     *------------------------------------------------------------------------*/
+	while (1)
+	{
+		mySegment = __atomic_load_n (segmentPtr, __ATOMIC_SEQ_CST);
+		__atomic_add_fetch (&mySegment -> segmentUsers, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n (segmentPtr, __ATOMIC_SEQ_CST) == mySegment)
+			return mySegment;
+
+		__atomic_sub_fetch (&mySegment -> segmentUsers, 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C H A I N  L E A V E                                                                                              *
+ *  ====================                                                                                              *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Internal function to stop using a segment, the last thread to leave a retired segment pools it.
+ *  \param myChain Chain the segment is in.
+ *  \param mySegment Segment counted by chainEnter.
+ *  \result None.
+ */
+static void chainLeave (CHAIN_HEADER *myChain, CHAIN_SEGMENT *mySegment)
+{
+	if (__atomic_sub_fetch (&mySegment -> segmentUsers, 1, __ATOMIC_SEQ_CST) == 0)
+	{
+		unsigned int segmentState = CHAIN_RETIRED;
+
+		if (__atomic_compare_exchange_n (&mySegment -> segmentState, &segmentState, CHAIN_POOLED, false,
+				__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+		{
+			chainSegmentPool (myChain, mySegment);
+		}
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C H A I N  C R E A T E                                                                                            *
+ *  ======================                                                                                            *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Create a chain, a queue with no size limit that any number of threads can put to and get from at once.
+ *  \result Handle of the chain to be used in future calls, NULL if out of memory.
+ */
+void *chainCreate (void)
+{
+	CHAIN_HEADER *newChain;
+
+	if ((newChain = calloc (1, sizeof (CHAIN_HEADER))) == NULL)
+		return NULL;
+
+	if ((newChain -> headSegment = chainSegmentNew (newChain)) == NULL)
+	{
+		chainDelete (newChain);
+		return NULL;
+	}
+	newChain -> tailSegment = newChain -> headSegment;
+	return newChain;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C H A I N  D E L E T E                                                                                            *
+ *  ======================                                                                                            *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Delete a chain, no other thread may be using it, items left in it are not freed.
+ *  \param chainHandle Handle of the chain, returned from create.
+ *  \result None.
+ */
+void chainDelete (void *chainHandle)
+{
+	if (chainHandle)
+	{
+		CHAIN_HEADER *myChain = (CHAIN_HEADER *)chainHandle;
+		unsigned int i, j;
+
+		for (i = 0; i < CHAIN_TABLE_BLOCKS; ++i)
+		{
+			if (myChain -> segmentTable[i] != NULL)
+			{
+				for (j = 0; j < CHAIN_TABLE_SIZE; ++j)
+				{
+					free (myChain -> segmentTable[i][j]);
+				}
+				free (myChain -> segmentTable[i]);
+			}
+		}
+		free (myChain);
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C H A I N  P U T                                                                                                  *
+ *  ================                                                                                                  *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Put an item on the end of a chain, when the last segment is full a new one is linked on.
+ *  \param chainHandle Handle of the chain, returned from create.
+ *  \param putData Data to put on the chain, it must not be NULL.
+ *  \result True if put, false if out of memory.
+ */
+bool chainPut (void *chainHandle, void *putData)
+{
+	CHAIN_HEADER *myChain = (CHAIN_HEADER *)chainHandle;
+
+	if (chainHandle == NULL || putData == NULL)
+		return false;
+
+	__atomic_add_fetch (&myChain -> itemCount, 1, __ATOMIC_RELAXED);
+	while (1)
+	{
+		CHAIN_SEGMENT *tailSegment = chainEnter (&myChain -> tailSegment), *nextSegment, *expectSegment;
+
+		if (ringPutSlot (&tailSegment -> segmentRing, putData))
+		{
+			chainLeave (myChain, tailSegment);
+			return true;
+		}
+
+		/*--------------------------------------------------------------------*
+         * Close the full segment so nothing else is put in it, then link on  *
+         * a new one with this item already in it                             *
+         *--------------------------------------------------------------------*/
+		__atomic_fetch_or (&tailSegment -> segmentRing.putPos, RING_CLOSED, __ATOMIC_SEQ_CST);
+		if ((nextSegment = __atomic_load_n (&tailSegment -> nextSegment, __ATOMIC_ACQUIRE)) == NULL)
+		{
+			CHAIN_SEGMENT *newSegment;
+
+			if ((newSegment = chainSegmentNew (myChain)) == NULL)
+			{
+				__atomic_sub_fetch (&myChain -> itemCount, 1, __ATOMIC_RELAXED);
+				chainLeave (myChain, tailSegment);
+				return false;
+			}
+			ringPutSlot (&newSegment -> segmentRing, putData);
+			if (__atomic_compare_exchange_n (&tailSegment -> nextSegment, &nextSegment, newSegment, false,
+					__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			{
+				expectSegment = tailSegment;
+				__atomic_compare_exchange_n (&myChain -> tailSegment, &expectSegment, newSegment, false,
+						__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+				chainLeave (myChain, tailSegment);
+				return true;
+			}
+			chainSegmentPool (myChain, newSegment);
+		}
+
+		/*--------------------------------------------------------------------*
+         * Another thread linked a segment, help move the tail on and retry   *
+         *--------------------------------------------------------------------*/
+		expectSegment = tailSegment;
+		__atomic_compare_exchange_n (&myChain -> tailSegment, &expectSegment, nextSegment, false,
+				__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+		chainLeave (myChain, tailSegment);
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C H A I N  G E T                                                                                                  *
+ *  ================                                                                                                  *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Get the first item from a chain and remove it, segments that have been read are pooled.
+ *  \param chainHandle Handle of the chain, returned from create.
+ *  \result A pointer to the item or NULL if the chain was empty.
+ */
+void *chainGet (void *chainHandle)
+{
+	CHAIN_HEADER *myChain = (CHAIN_HEADER *)chainHandle;
+
+	if (chainHandle == NULL)
+		return NULL;
+
+	while (1)
+	{
+		CHAIN_SEGMENT *headSegment = chainEnter (&myChain -> headSegment), *nextSegment, *expectSegment;
+		void *retn;
+
+		if ((retn = ringGetSlot (&headSegment -> segmentRing)) != NULL)
+		{
+			__atomic_sub_fetch (&myChain -> itemCount, 1, __ATOMIC_RELAXED);
+			chainLeave (myChain, headSegment);
+			return retn;
+		}
+		if ((nextSegment = __atomic_load_n (&headSegment -> nextSegment, __ATOMIC_ACQUIRE)) == NULL)
+		{
+			chainLeave (myChain, headSegment);
+			return NULL;
+		}
+
+		/*--------------------------------------------------------------------*
+         * A segment with a next one is closed, it is finished when every     *
+         * slot put to has been read, then the tail and head are moved past   *
+         * it and it is retired                                               *
+         *--------------------------------------------------------------------*/
+		if (ringCount (&headSegment -> segmentRing) == 0)
+		{
+			expectSegment = headSegment;
+			__atomic_compare_exchange_n (&myChain -> tailSegment, &expectSegment, nextSegment, false,
+					__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+			expectSegment = headSegment;
+			if (__atomic_compare_exchange_n (&myChain -> headSegment, &expectSegment, nextSegment, false,
+					__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			{
+				__atomic_store_n (&headSegment -> segmentState, CHAIN_RETIRED, __ATOMIC_SEQ_CST);
+			}
+		}
+		chainLeave (myChain, headSegment);
+	}
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C H A I N  G E T  I T E M  C O U N T                                                                              *
+ *  ====================================                                                                              *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Get the number of items in a chain, other threads may change it as soon as it is read.
+ *  \param chainHandle Handle of the chain, returned from create.
+ *  \result The number of items in the chain.
+ */
+unsigned long chainGetItemCount (void *chainHandle)
+{
+	if (chainHandle == NULL)
+		return 0;
+
+	return __atomic_load_n (&((CHAIN_HEADER *)chainHandle) -> itemCount, __ATOMIC_RELAXED);
+}
@@ -110,7 +110,6 @@ void version (void)
  */
 int main (int argc, char *argv[])
 {
-	void *fileList = NULL;
 	int i = 1, found =0;
 	char fullVersion[81];
 
@@ -155,27 +154,20 @@ int main (int argc, char *argv[])
 		}
 	}
 
+	if (!displayColumnInit (2, ptrChangeColumn, DISPLAY_HEADINGS))
+	{
+		fprintf (stderr, "ERROR in: displayColumnInit\n");
+		return 1;
+	}
 	for (; optind < argc; ++optind)
 	{
-		found += directoryLoad (argv[optind], ONLYFILES, NULL, &fileList);
+		found += directoryStream (argv[optind], ONLYFILES | STREAMWHOLE, showDir, 0);
 	}
 
-	/*------------------------------------------------------------------------*
-     * Now we can sort the directory.                                         *
-     *------------------------------------------------------------------------*/
-	directorySort (&fileList);
-
 	if (found)
 	{
 		char numBuff[15];
 
-		if (!displayColumnInit (2, ptrChangeColumn, DISPLAY_HEADINGS))
-		{
-			fprintf (stderr, "ERROR in: displayColumnInit\n");
-			return 1;
-		}
-		directoryProcess (showDir, &fileList);
-
 		if (filesFound)
 			displayDrawLine (0);
 
@@ -191,6 +183,7 @@ int main (int argc, char *argv[])
 	}
 	else
 	{
+		displayTidy ();
 		version ();
 		printf ("No files found\n");
 	}
@@ -54,6 +54,8 @@
  *----------------------------------------------------------------------------*/
 int showDir (DIR_ENTRY *file);
 
+#define STREAM_AHEAD	1024
+
 /*----------------------------------------------------------------------------*
  * Globals                                                                    *
  *----------------------------------------------------------------------------*/
@@ -104,7 +106,6 @@ void version (void)
  */
 int main (int argc, char *argv[])
 {
-	void *fileList = NULL;
 	int i = 1, found = 0;
 	char fullVersion[81];
 
@@ -132,25 +133,21 @@ int main (int argc, char *argv[])
      * If we got a path then split it into a path and a file pattern to match *
      * files with.                                                            *
      *------------------------------------------------------------------------*/
+#ifdef USE_STATX
+	directorySetStatMask (STATX_TYPE | STATX_MODE);
+#endif
+	if (!displayColumnInit (3, ptrLinesColumn, DISPLAY_HEADINGS))
+	{
+		fprintf (stderr, "ERROR in: displayColumnInit\n");
+		return 1;
+	}
 	while (i < argc)
-		found += directoryLoad (argv[i++], ONLYFILES|ONLYLINKS, NULL, &fileList);
-
-	/*------------------------------------------------------------------------*
-     * Now we can sort the directory.                                         *
-     *------------------------------------------------------------------------*/
-	directorySort (&fileList);
+		found += directoryStream (argv[i++], ONLYFILES|ONLYLINKS, showDir, STREAM_AHEAD);
 
 	if (found)
 	{
 		char numBuff[15];
 
-		if (!displayColumnInit (3, ptrLinesColumn, DISPLAY_HEADINGS))
-		{
-			fprintf (stderr, "ERROR in: displayColumnInit\n");
-			return 1;
-		}
-		directoryProcess (showDir, &fileList);
-
 		displayDrawLine (0);
 		displayInColumn (1, displayCommaNumber (totalFunny, numBuff));
 		displayInColumn (2, "Funnies");
@@ -164,6 +161,7 @@ int main (int argc, char *argv[])
 	}
 	else
 	{
+		displayTidy ();
 		version ();
 		printf ("No files found\n");
 	}
@@ -300,6 +300,9 @@ int main (int argc, char *argv[])
 	}
 	else
 	{
+#ifdef USE_STATX
+		directorySetStatMask (STATX_TYPE | STATX_MODE | STATX_SIZE);
+#endif
 		for (; optind < argc; ++optind)
 		{
 			found += directoryLoad (argv[optind], ONLYFILES|ONLYLINKS, NULL, &fileList);
@@ -40,12 +40,6 @@
 #include <sys/types.h>
 #include <linux/fcntl.h>
 #include <getopt.h>
-#ifdef HAVE_OPENSSL_EVP_H
-#include <openssl/evp.h>
-#define CRC_BUFF_SIZE EVP_MAX_MD_SIZE
-#else
-#define CRC_BUFF_SIZE 64
-#endif
 #ifdef HAVE_VALUES_H
 #include <values.h>
 #else
@@ -69,9 +63,19 @@ extern int errno;
  * Prototypes															      *
  *---------------------------------------------------------------------------**/
 int showDir (DIR_ENTRY *file);
+int filterDir (DIR_ENTRY *file);
+int countDir (DIR_ENTRY *file);
 int fileCompare (DIR_ENTRY *fileOne, DIR_ENTRY *fileTwo);
+int fileTypeOrder (DIR_ENTRY *file);
+unsigned long long fileSortKey (DIR_ENTRY *file);
+int keyAddString (unsigned char *keyBuff, int keyLen, int buffSize, char *addStr, int useCase);
+int fileSortBytes (DIR_ENTRY *file, unsigned char *keyBuff, int buffSize);
+void sortDir (void **fileList);
 char *quoteCopy (char *dst, char *src);
 void getFileVersion (DIR_ENTRY *fileOne);
+int setupColumns (unsigned long longestName);
+void showTotals (void);
+int watchDir (char *dirPath);
 
 /*----------------------------------------------------------------------------*
  * Defines   															      *
@@ -118,6 +122,7 @@ void getFileVersion (DIR_ENTRY *fileOne);
 #define SHOW_IN_AGE		(1 << 22)
 #define SHOW_VERSION	(1 << 23)
 #define SHOW_EXTRA		(1 << 24)
+#define SHOW_WATCH		(1 << 25)
 
 #define DATE_MOD		0
 #define DATE_ACC		1
@@ -154,6 +159,8 @@ int			currentCol		=	0;
 int			maxCol			=	4;
 int			showDate		=	DATE_MOD;
 int			showFound		=	MAXINT;
+int			sortThreads		=	1;
+int			fileDigests		=	0;
 int			sizeFormat		=	1;
 int			dateFormat		=	1;
 int			wordNumber		=	0;
@@ -273,12 +280,17 @@ static struct option longOptions[] =
 	{	"age",			no_argument,		0,	'A' },
 	{	"backup",		no_argument,		0,	'b' },
 	{	"base64",		no_argument,		0,	'B' },
+	{	"cache",		required_argument,	0,	'K' },
 	{	"case",			no_argument,		0,	'c' },
 	{	"colour",		no_argument,		0,	'C' },
 	{	"date",			required_argument,	0,	'd' },
+	{	"depth",		required_argument,	0,	'L' },
 	{	"number",		required_argument,	0,	'n' },
+	{	"onefs",		no_argument,		0,	'O' },
 	{	"display",		required_argument,	0,	'D' },
 	{	"epoch",		no_argument,		0,	'e' },
+	{	"exclude",		required_argument,	0,	'I' },
+	{	"gitignore",	no_argument,		0,	'G' },
 	{	"matching",		no_argument,		0,	'm' },
 	{	"unique",		no_argument,		0,	'M' },
 	{	"order",		required_argument,	0,	'o' },
@@ -291,9 +303,11 @@ static struct option longOptions[] =
 	{	"show",			required_argument,	0,	's' },
 	{	"size",			no_argument,		0,	'S' },
 	{	"thousep",		no_argument,		0,	't' },
+	{	"threads",		required_argument,	0,	'j' },
 	{	"time",			required_argument,	0,	'T' },
 	{	"version",		no_argument,		0,	'v' },
 	{	"nocvs",		no_argument,		0,	'V' },
+	{	"watch",		no_argument,		0,	'F' },
 	{	"wide",			no_argument,		0,	'w' },
 	{	"width",		required_argument,	0,	'W' },
 	{	"word",			required_argument,	0,	'x' },
@@ -458,8 +472,10 @@ void helpThem (char *progName, int flags)
 		printf ("     --age . . . . . . . . . -A  . . . . . Show the age of the file.\n");
 		printf ("     --backup  . . . . . . . -b  . . . . . Show backup files ending with ~.\n");
 		printf ("     --base64  . . . . . . . -B  . . . . . Encode checksums in base64.\n");
+		printf ("     --cache file  . . . . . -Kfile  . . . Keep directory listings in file, reuse if unchanged.\n");
 		printf ("     --case  . . . . . . . . -c  . . . . . Should the sort be case sensitive.\n");
 		printf ("     --colour  . . . . . . . -C  . . . . . Toggle colour display, defined in dirrc.\n");
+		printf ("     --depth # . . . . . . . -L# . . . . . Only read # levels of sub-directories.\n");
 	}
 	if (flags == 0 || flags == HELP_DATE)	/* Date */
 	{
@@ -490,9 +506,12 @@ void helpThem (char *progName, int flags)
 	if (flags == 0)
 	{
 		printf ("     --epoch . . . . . . . . -e  . . . . . Show date in epoch with milli seconds.\n");
+		printf ("     --exclude rule  . . . . -Irule  . . . Do not show or read names matching a .gitignore rule.\n");
+		printf ("     --gitignore . . . . . . -G  . . . . . Do not show or read names listed in .gitignore files.\n");
 		printf ("     --matching  . . . . . . -m  . . . . . Show only duplicated files.\n");
 		printf ("     --unique  . . . . . . . -M  . . . . . Show only files with no duplicate.\n");
 		printf ("     --number #  . . . . . . -n# . . . . . Display some, # > 0 first #, # < 0 last n.\n");
+		printf ("     --onefs . . . . . . . . -O  . . . . . Do not read directories on other file systems.\n");
 	}
 	if (flags == 0 || flags == HELP_ORDER)	/* Order */
 	{
@@ -536,6 +555,7 @@ void helpThem (char *progName, int flags)
 	{
 		printf ("     --size  . . . . . . . . -S  . . . . . Show the file size in full.\n");
 		printf ("     --thousep . . . . . . . -t  . . . . . Do not display the thousand seperator.\n");
+		printf ("     --threads # . . . . . . -j# . . . . . Read sub-directories using # threads, 0 for all CPUs.\n");
 	}
 	if (flags == 0 || flags == HELP_TIME)	/* Time */
 	{
@@ -546,6 +566,7 @@ void helpThem (char *progName, int flags)
 	{
 		printf ("     --version . . . . . . . -v  . . . . . Show version information.\n");
 		printf ("     --nocvs . . . . . . . . -V  . . . . . Do not show version control directories.\n");
+		printf ("     --watch . . . . . . . . -F  . . . . . Show the directory again each time it changes.\n");
 		printf ("     --wide  . . . . . . . . -w  . . . . . Show directory in wide format.\n");
 		printf ("     --width # . . . . . . . -W# . . . . . Ignore screen width default to 255.\n");
 		printf ("     --word #  . . . . . . . -x# . . . . . Which word to start word sort from.\n");
@@ -984,6 +1005,69 @@ void commandOption (char option, char *optionVal, char *progName)
 		showType ^= SHOW_AGE;
 		break;
 
+	case 'F':
+		showType ^= SHOW_WATCH;
+		break;
+
+	case 'K':
+		if (optionVal != NULL)
+		{
+			directoryCacheOpen (optionVal);
+		}
+		break;
+
+	case 'G':
+		directorySetExcludeFile (".gitignore");
+		break;
+
+	case 'I':
+		if (optionVal != NULL)
+		{
+			directoryExcludeAdd (optionVal);
+		}
+		break;
+
+	case 'L':
+		if (optionVal != NULL)
+		{
+			int depth = 0, k = 0;
+			while (optionVal[k] >= '0' && optionVal[k] <= '9')
+			{
+				depth = (depth * 10) + (optionVal[k] - '0');
+				++k;
+			}
+			if (k == 0 || optionVal[k] != 0)
+			{
+				helpThem (progName, HELP_ALL);
+				exit (1);
+			}
+			directorySetMaxDepth (depth);
+		}
+		break;
+
+	case 'O':
+		dirType ^= SAMEDEVICE;
+		break;
+
+	case 'j':
+		if (optionVal != NULL)
+		{
+			int threads = 0, k = 0;
+			while (optionVal[k] >= '0' && optionVal[k] <= '9')
+			{
+				threads = (threads * 10) + (optionVal[k] - '0');
+				++k;
+			}
+			if (k == 0 || optionVal[k] != 0)
+			{
+				helpThem (progName, HELP_ALL);
+				exit (1);
+			}
+			directorySetThreads (threads);
+			sortThreads = threads;
+		}
+		break;
+
 	case 'n':
 		if (optionVal != NULL)
 		{
@@ -1162,143 +1246,73 @@ void loadSettings (char *progName)
 
 /**********************************************************************************************************************
  *                                                                                                                    *
- *  M A I N                                                                                                           *
- *  =======                                                                                                           *
+ *  S E T U P  C O L U M N S                                                                                          *
+ *  ========================                                                                                          *
  *                                                                                                                    *
  **********************************************************************************************************************/
 /**
- *  \brief The program starts here.
- *  \param argc The number of arguments passed to the program.
- *  \param argv Pointers to the arguments passed to the program.
- *  \result 0 (zero) if all process OK.
+ *  \brief Set up the display columns for the way the files are to be shown.
+ *  \param longestName Length of the longest file name, only used for the wide display.
+ *  \result 1 if the display is ready, 0 on error.
  */
-int main (int argc, char *argv[])
+int setupColumns (unsigned long longestName)
 {
-	int found = 0, foundDir = 0, opt;
-	void *fileList = NULL;
-	char defaultDir[PATH_SIZE], fullVersion[81];
-
-	strcpy (fullVersion, VERSION);
-#ifdef USE_STATX
-	strcat (fullVersion, ".1");
-#else
-	strcat (fullVersion, ".0");
-#endif
-	if (strcmp (directoryVersion(), fullVersion) != 0)
-	{
-		fprintf (stderr, "Library (%s) does not match Utility (%s).\n", directoryVersion(), fullVersion);
-		exit (1);
-	}
-
-	timeNow = time (NULL);
-	displayInit ();
-	loadSettings (basename (argv[0]));
-
-	while (1)
+	if (showType & SHOW_WIDE)
 	{
-		/*--------------------------------------------------------------------*
-		 * getopt_long stores the option index here.                          *
-	     *--------------------------------------------------------------------*/
-		int optionIndex = 0;
-
-		opt = getopt_long (argc, argv, "aAbBcCd:D:emMn:o:pPqQrRs:StT:vVwW:x:X?", longOptions, &optionIndex);
+		if (longestName > 160)
+			longestName = 160;
 
-		/*--------------------------------------------------------------------*
-		 * Detect the end of the options.                                     *
-	     *--------------------------------------------------------------------*/
-		if (opt == -1) break;
+		if ((maxCol = (displayGetWidth () - 1) / (longestName + 2)) < 4)
+			maxCol = 4;
+		if (maxCol > 10)
+			maxCol = 10;
+		maxCol *= 3;
 
-		switch (opt)
+		if (!displayColumnInit (maxCol, ptrAllColumns, dirDisplayFlags))
 		{
-		case 'd':
-		case 'D':
-		case 'o':
-		case 's':
-		case 'n':
-		case 'T':
-		case 'W':
-		case 'x':
-		case 'X':
-			commandOption (opt, optarg, basename (argv[0]));
-			break;
-
-		default:
-			commandOption (opt, NULL, basename (argv[0]));
-			break;
-
+			fprintf (stderr, "ERROR in: displayColumnInit\n");
+			return 0;
 		}
 	}
-
-	/*------------------------------------------------------------------------*
-	 * Print any remaining command line arguments (not options).              *
-     *------------------------------------------------------------------------*/
-	while (optind < argc)
-	{
-		found += directoryLoad (argv[optind++], dirType, fileCompare, &fileList);
-		foundDir = 1;
-	}
-	if (!foundDir)
+	else if (showType & SHOW_QUIET)
 	{
-		if (getcwd (defaultDir, 500) == NULL)
+		ptrAllColumns[0] = &allColumnDescs [COL_FILENAME];
+		if (!displayColumnInit (1, ptrAllColumns, 0))
 		{
-			strcpy (defaultDir, ".");
+			fprintf (stderr, "ERROR in: displayColumnInit\n");
+			return 0;
 		}
-		strcat (defaultDir, DIRDEF);
-		found = directoryLoad (defaultDir, dirType, fileCompare, &fileList);
 	}
-	directorySort (&fileList);
-
-	/*------------------------------------------------------------------------*
-	 * We now have the directory loaded into memory.                          *
-     *------------------------------------------------------------------------*/
-	if (found)
+	else
 	{
-		if (showType & SHOW_WIDE)
-		{
-			unsigned long longestName = queueGetFreeData (fileList);
-
-			if (longestName > 160)
-				longestName = 160;
+		int colNum, flags = (showType & SHOW_EXTRA) ? DISPLAY_HEADINGS : 0;
 
-			if ((maxCol = (displayGetWidth () - 1) / (longestName + 2)) < 4)
-				maxCol = 4;
-			if (maxCol > 10)
-				maxCol = 10;
-			maxCol *= 3;
-
-			if (!displayColumnInit (maxCol, ptrAllColumns, dirDisplayFlags))
-			{
-				fprintf (stderr, "ERROR in: displayColumnInit\n");
-				return 1;
-			}
-		}
-		else if (showType & SHOW_QUIET)
+		for (colNum = 0; colNum < MAX_COL_DESC; colNum++)
 		{
-			ptrAllColumns[0] = &allColumnDescs [COL_FILENAME];
-			if (!displayColumnInit (1, ptrAllColumns, 0))
-			{
-				fprintf (stderr, "ERROR in: displayColumnInit\n");
-				return 1;
-			}
+			ptrAllColumns[colNum] = &allColumnDescs [columnTranslate[colNum]];
 		}
-		else
-		{
-			int colNum, flags = (showType & SHOW_EXTRA) ? DISPLAY_HEADINGS : 0;
-
-			for (colNum = 0; colNum < MAX_COL_DESC; colNum++)
-			{
-				ptrAllColumns[colNum] = &allColumnDescs [columnTranslate[colNum]];
-			}
 
-			if (!displayColumnInit (colNum, ptrAllColumns, flags | dirDisplayFlags))
-			{
-				fprintf (stderr, "ERROR in: displayColumnInit\n");
-				return 1;
-			}
+		if (!displayColumnInit (colNum, ptrAllColumns, flags | dirDisplayFlags))
+		{
+			fprintf (stderr, "ERROR in: displayColumnInit\n");
+			return 0;
 		}
-		directoryProcess (showDir, &fileList);
 	}
+	return 1;
+}
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  S H O W  T O T A L S                                                                                              *
+ *  ====================                                                                                              *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Show the lines held by the display, then the totals of what was found.
+ *  \result None.
+ */
+void showTotals (void)
+{
 	if (showType & SHOW_QUIET)
 	{
 		if (filesFound || linksFound || dirsFound || devsFound || socksFound || pipesFound)
@@ -1448,121 +1462,367 @@ int main (int argc, char *argv[])
 			printf ("     No matches found\n");
 		}
 	}
-	return 0;
 }
 
 /**********************************************************************************************************************
  *                                                                                                                    *
- *  F I L E  E X I S T S                                                                                              *
- *  ====================                                                                                              *
+ *  W A T C H  D I R                                                                                                  *
+ *  ================                                                                                                  *
  *                                                                                                                    *
  **********************************************************************************************************************/
 /**
- *  \brief Test to see if a file exists, used for checking links.
- *  \param fileName Files name to look for.
- *  \param extraPath If the file does not include a path use this.
- *  \result 1 if the file exists and 0 if not.
+ *  \brief Keep a directory loaded and show it again each time it changes.
+ *  \param dirPath The path to the directory to be watched.
+ *  \result 0 (zero) if it was watched until stopped, 1 on an error.
  */
-int fileExists (char *fileName, char *extraPath)
+int watchDir (char *dirPath)
 {
-	FILE *temp;
-	int fileExists = 1;
-	char tempBuff[1025];
+	void *watchHandle, *fileList = NULL;
+	int changeCount = 0;
 
-	if (fileName[0] == DIRCHAR)
-	{
-		strcpy (tempBuff, fileName);
-	}
-	else
+	if ((watchHandle = directoryWatchOpen (dirPath, dirType, fileCompare)) == NULL)
 	{
-		strcpy (tempBuff, extraPath);
-		strcat (tempBuff, fileName);
+		fprintf (stderr, "ERROR in: directoryWatchOpen\n");
+		return 1;
 	}
-	if ((temp = fopen (tempBuff, "r")) == NULL)
+	do
 	{
-		if (errno == 2)
-			fileExists = 0;
-	}
-	else
-		fclose (temp);
-
-	return fileExists;
-}
+		/*--------------------------------------------------------------------*
+		 * Start each redraw with a clear screen and no totals.               *
+	     *--------------------------------------------------------------------*/
+		filesFound = linksFound = dirsFound = devsFound = socksFound = pipesFound = 0;
+		totalSize = 0;
+		timeNow = time (NULL);
+		printf ("\033[H\033[2J");
 
-/**********************************************************************************************************************
- *                                                                                                                    *
- *  F I N D  E X T N                                                                                                  *
- *  ================                                                                                                  *
- *                                                                                                                    *
- **********************************************************************************************************************/
-/**
- *  \brief Function to find the .
- *  \param fileName Name of the file to search for the extension.
- *  \result NULL if no .
- */
-char *findExtn (char *fileName)
-{
-	int i = strlen (fileName);
-	char *extn = NULL;
+		if (directoryWatchList (watchHandle, &fileList))
+		{
+			sortDir (&fileList);
+			if (!setupColumns (queueGetFreeData (fileList)))
+			{
+				queueDelete (fileList);
+				directoryWatchClose (watchHandle);
+				return 1;
+			}
+			directoryRead (showDir, &fileList);
+		}
+		queueDelete (fileList);
+		fileList = NULL;
+		showTotals ();
+		displayTidy ();
+		fflush (stdout);
 
-	while (i > 1)
-	{
-		i --;
-		if (fileName[i] == DIRCHAR)
-			break;
-		if (fileName[i] == '.')
+		while ((changeCount = directoryWatchWait (watchHandle, -1)) == 0)
 		{
-			extn = &fileName[i];
-			break;
+			;
 		}
 	}
-	return extn;
+	while (changeCount > 0);
+
+	directoryWatchClose (watchHandle);
+	return changeCount < 0;
 }
 
 /**********************************************************************************************************************
  *                                                                                                                    *
- *  S H O W  D I R                                                                                                    *
- *  ==============                                                                                                    *
+ *  M A I N                                                                                                           *
+ *  =======                                                                                                           *
  *                                                                                                                    *
  **********************************************************************************************************************/
 /**
- *  \brief Called back by process dir to show the directory.
- *  \param file Information about the file to show.
- *  \result 1 if the file was shown.
+ *  \brief The program starts here.
+ *  \param argc The number of arguments passed to the program.
+ *  \param argv Pointers to the arguments passed to the program.
+ *  \result 0 (zero) if all process OK.
  */
-int showDir (DIR_ENTRY *file)
+int main (int argc, char *argv[])
 {
-	long fileAge = 0, fileAgeMS = 0;
+	int found = 0, foundDir = 0, opt, topDir;
+	void *fileList = NULL;
+	char defaultDir[PATH_SIZE], fullVersion[81];
+
+	strcpy (fullVersion, VERSION);
 #ifdef USE_STATX
-	mode_t stMode = file -> fileStat.stx_mode;
-	uid_t stUId = file -> fileStat.stx_uid;
-	gid_t stGId = file -> fileStat.stx_gid;
-	ino_t stINo = file -> fileStat.stx_ino;
-	nlink_t stNLink = file -> fileStat.stx_nlink;
-	off_t stSize = file -> fileStat.stx_size;
+	strcat (fullVersion, ".1");
 #else
-	mode_t stMode = file -> fileStat.st_mode;
-	uid_t stUId = file -> fileStat.st_uid;
-	gid_t stGId = file -> fileStat.st_gid;
-	ino_t stINo = file -> fileStat.st_ino;
-	nlink_t stNLink = file -> fileStat.st_nlink;
-	off_t stSize = file -> fileStat.st_size;
+	strcat (fullVersion, ".0");
 #endif
-	if (!dot[0])
+	if (strcmp (directoryVersion(), fullVersion) != 0)
 	{
-#ifdef RADIXCHAR
-		strncpy (dot, nl_langinfo(RADIXCHAR), 2);
-#else
-		strcpy (dot, ".");
-#endif
+		fprintf (stderr, "Library (%s) does not match Utility (%s).\n", directoryVersion(), fullVersion);
+		exit (1);
 	}
 
-	/*------------------------------------------------------------------------*
-	 * Only show files that have matches, or only show files with no match.   *
-	 *------------------------------------------------------------------------*/
-	if (showType & SHOW_MATCH)
+	timeNow = time (NULL);
+	displayInit ();
+	loadSettings (basename (argv[0]));
+
+	while (1)
 	{
-		if (showType & SHOW_NO_MATCH)
+		/*--------------------------------------------------------------------*
+		 * getopt_long stores the option index here.                          *
+	     *--------------------------------------------------------------------*/
+		int optionIndex = 0;
+
+		opt = getopt_long (argc, argv, "aAbBcCd:D:eFGI:j:K:L:mMn:o:OpPqQrRs:StT:vVwW:x:X?", longOptions, &optionIndex);
+
+		/*--------------------------------------------------------------------*
+		 * Detect the end of the options.                                     *
+	     *--------------------------------------------------------------------*/
+		if (opt == -1) break;
+
+		switch (opt)
+		{
+		case 'd':
+		case 'D':
+		case 'I':
+		case 'j':
+		case 'K':
+		case 'L':
+		case 'o':
+		case 's':
+		case 'n':
+		case 'T':
+		case 'W':
+		case 'x':
+		case 'X':
+			commandOption (opt, optarg, basename (argv[0]));
+			break;
+
+		default:
+			commandOption (opt, NULL, basename (argv[0]));
+			break;
+
+		}
+	}
+
+	/*------------------------------------------------------------------------*
+	 * Only the common stat fields are ever shown, keep the entries small.    *
+     *------------------------------------------------------------------------*/
+	dirType |= COMPACTSTAT;
+
+	/*------------------------------------------------------------------------*
+	 * Quiet mode sorted by name only needs the file type, so skip the stats. *
+     *------------------------------------------------------------------------*/
+	if (showType & SHOW_QUIET && !(showType & (SHOW_MATCH | SHOW_IN_AGE)) &&
+			(orderType == ORDER_NAME || orderType == ORDER_EXTN || orderType == ORDER_NONE))
+	{
+		dirType |= SKIPSTAT;
+	}
+#ifdef USE_STATX
+	else
+	{
+		/*--------------------------------------------------------------------*
+		 * Only ask for the fields the columns and ordering are going to use. *
+		 *--------------------------------------------------------------------*/
+		unsigned int statMask = STATX_TYPE | STATX_MODE | STATX_SIZE;
+
+		if (showType & (SHOW_DATE | SHOW_IN_AGE) || orderType == ORDER_DATE)
+		{
+			statMask |= (showDate == DATE_ACC ? STATX_ATIME : showDate == DATE_CHG ? STATX_CTIME :
+					showDate == DATE_BTH ? STATX_BTIME : STATX_MTIME);
+		}
+		if (showType & (SHOW_OWNER | SHOW_GROUP) || orderType == ORDER_OWNR)
+			statMask |= STATX_UID;
+		if (showType & SHOW_GROUP || orderType == ORDER_GRUP)
+			statMask |= STATX_GID;
+		if (showType & SHOW_NUM_LINKS || orderType == ORDER_LINK)
+			statMask |= STATX_NLINK;
+		if (showType & SHOW_INODE || orderType == ORDER_INOD)
+			statMask |= STATX_INO;
+
+		directorySetStatMask (statMask);
+	}
+#endif
+
+	/*------------------------------------------------------------------------*
+	 * Check sums shown or ordered by are all made from one read of the file. *
+     *------------------------------------------------------------------------*/
+	if (showType & SHOW_MD5 || orderType == ORDER_MD5S)
+		fileDigests |= CRC_DIGEST_MD5;
+	if (showType & SHOW_SHA256 || orderType == ORDER_SHAS)
+		fileDigests |= CRC_DIGEST_SHA256;
+	displaySetDigests (fileDigests);
+
+	/*------------------------------------------------------------------------*
+	 * Watch the first directory, show it again each time something changes.  *
+     *------------------------------------------------------------------------*/
+	if (showType & SHOW_WATCH)
+	{
+		int watchRetn;
+
+		if (optind < argc)
+		{
+			watchRetn = watchDir (argv[optind]);
+		}
+		else
+		{
+			if (getcwd (defaultDir, 500) == NULL)
+			{
+				strcpy (defaultDir, ".");
+			}
+			strcat (defaultDir, DIRDEF);
+			watchRetn = watchDir (defaultDir);
+		}
+		directoryCacheClose ();
+		return watchRetn;
+	}
+
+	/*------------------------------------------------------------------------*
+     * Ordered lists that only show some lines only need to hold those lines. *
+     *------------------------------------------------------------------------*/
+	topDir = (orderType != ORDER_NONE && showFound != MAXINT && showFound != 0 &&
+			!(showType & (SHOW_WIDE | SHOW_MATCH)));
+
+	/*------------------------------------------------------------------------*
+	 * Print any remaining command line arguments (not options).              *
+     *------------------------------------------------------------------------*/
+	while (optind < argc)
+	{
+		if (topDir)
+			found += directoryLoadTop (argv[optind++], dirType, fileCompare, countDir, showFound, &fileList);
+		else
+			found += directoryLoad (argv[optind++], dirType, fileCompare, &fileList);
+		foundDir = 1;
+	}
+	if (!foundDir)
+	{
+		if (getcwd (defaultDir, 500) == NULL)
+		{
+			strcpy (defaultDir, ".");
+		}
+		strcat (defaultDir, DIRDEF);
+		if (topDir)
+			found = directoryLoadTop (defaultDir, dirType, fileCompare, countDir, showFound, &fileList);
+		else
+			found = directoryLoad (defaultDir, dirType, fileCompare, &fileList);
+	}
+	directoryCacheClose ();
+
+	/*------------------------------------------------------------------------*
+	 * We now have the directory loaded into memory.                          *
+     *------------------------------------------------------------------------*/
+	sortDir (&fileList);
+	if (found)
+	{
+		if (!setupColumns (queueGetFreeData (fileList)))
+		{
+			return 1;
+		}
+		if (topDir)
+		{
+			long keptFound[6] = { filesFound, linksFound, dirsFound, devsFound, socksFound, pipesFound };
+			long long keptSize = totalSize;
+
+			/*----------------------------------------------------------------*
+             * Keep the totals counted as the files were found.               *
+             *----------------------------------------------------------------*/
+			directoryProcess (showDir, &fileList);
+			filesFound = keptFound[0];
+			linksFound = keptFound[1];
+			dirsFound = keptFound[2];
+			devsFound = keptFound[3];
+			socksFound = keptFound[4];
+			pipesFound = keptFound[5];
+			totalSize = keptSize;
+		}
+		else
+		{
+			directoryProcess (showDir, &fileList);
+		}
+	}
+
+	showTotals ();
+	return 0;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  F I L E  E X I S T S                                                                                              *
+ *  ====================                                                                                              *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Test to see if a file exists, used for checking links.
+ *  \param fileName Files name to look for.
+ *  \param extraPath If the file does not include a path use this.
+ *  \result 1 if the file exists and 0 if not.
+ */
+int fileExists (char *fileName, char *extraPath)
+{
+	FILE *temp;
+	int fileExists = 1;
+	char tempBuff[1025];
+
+	if (fileName[0] == DIRCHAR)
+	{
+		strcpy (tempBuff, fileName);
+	}
+	else
+	{
+		strcpy (tempBuff, extraPath);
+		strcat (tempBuff, fileName);
+	}
+	if ((temp = fopen (tempBuff, "r")) == NULL)
+	{
+		if (errno == 2)
+			fileExists = 0;
+	}
+	else
+		fclose (temp);
+
+	return fileExists;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  F I N D  E X T N                                                                                                  *
+ *  ================                                                                                                  *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Function to find the .
+ *  \param fileName Name of the file to search for the extension.
+ *  \result NULL if no .
+ */
+char *findExtn (char *fileName)
+{
+	int i = strlen (fileName);
+	char *extn = NULL;
+
+	while (i > 1)
+	{
+		i --;
+		if (fileName[i] == DIRCHAR)
+			break;
+		if (fileName[i] == '.')
+		{
+			extn = &fileName[i];
+			break;
+		}
+	}
+	return extn;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  F I L T E R  D I R                                                                                                *
+ *  ==================                                                                                                *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Check the file is one that should be shown.
+ *  \param file Information about the file to check.
+ *  \result 1 if the file should be shown, 0 if not.
+ */
+int filterDir (DIR_ENTRY *file)
+{
+	/*------------------------------------------------------------------------*
+	 * Only show files that have matches, or only show files with no match.   *
+	 *------------------------------------------------------------------------*/
+	if (showType & SHOW_MATCH)
+	{
+		if (showType & SHOW_NO_MATCH)
 		{
 			if (file -> match)
 				return 0;
@@ -1585,17 +1845,147 @@ int showDir (DIR_ENTRY *file)
 	}
 
 	/*------------------------------------------------------------------------*
-     * Don't show files or directories that are used for version control.     *
+	 * Don't show files or directories that are outside time values.          *
+     *------------------------------------------------------------------------*/
+	if (showType & SHOW_IN_AGE)
+	{
+		long fileAge = 0;
+
+		switch (showDate)
+		{
+#ifdef USE_STATX
+		case DATE_MOD:
+			fileAge = file -> fileStat.stx_mtime.tv_sec;
+			break;
+		case DATE_ACC:
+			fileAge = file -> fileStat.stx_atime.tv_sec;
+			break;
+		case DATE_CHG:
+			fileAge = file -> fileStat.stx_ctime.tv_sec;
+			break;
+		case DATE_BTH:
+			fileAge = file -> fileStat.stx_btime.tv_sec;
+			break;
+#else
+		case DATE_MOD:
+			fileAge = file -> fileStat.st_mtim.tv_sec;
+			break;
+		case DATE_ACC:
+			fileAge = file -> fileStat.st_atim.tv_sec;
+			break;
+		case DATE_CHG:
+			fileAge = file -> fileStat.st_ctim.tv_sec;
+			break;
+#endif
+		}
+		if (maxFileAge != -1 && fileAge < maxFileAge)		/* Too old */
+			return 0;
+		if (minFileAge != -1 && fileAge > minFileAge)		/* Too young */
+			return 0;
+	}
+	return 1;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  C O U N T  D I R                                                                                                  *
+ *  ================                                                                                                  *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Called back while only the first lines are loaded, count every file for the totals.
+ *  \param file Information about the file found.
+ *  \result 1 if the file would be shown, 0 if it is dropped.
+ */
+int countDir (DIR_ENTRY *file)
+{
+#ifdef USE_STATX
+	mode_t stMode = file -> fileStat.stx_mode;
+	off_t stSize = file -> fileStat.stx_size;
+#else
+	mode_t stMode = file -> fileStat.st_mode;
+	off_t stSize = file -> fileStat.st_size;
+#endif
+
+	if (!filterDir (file))
+		return 0;
+
+	/*------------------------------------------------------------------------*
+     * Count them as showDir would, it does not see the files not kept.       *
+     *------------------------------------------------------------------------*/
+	if (showType & SHOW_QUIET)
+	{
+		filesFound ++;
+	}
+	else if (S_ISLNK (stMode))
+	{
+		linksFound ++;
+	}
+	else if (S_ISDIR (stMode))
+	{
+		dirsFound ++;
+	}
+	else if (S_ISBLK(stMode) || S_ISCHR(stMode) || S_ISSOCK(stMode) || S_ISFIFO(stMode))
+	{
+		if (showType & SHOW_TYPE)
+		{
+			if (S_ISBLK(stMode) || S_ISCHR(stMode))
+				devsFound ++;
+			else
+				socksFound ++;
+		}
+	}
+	else if (!stMode || stMode & S_IFREG)
+	{
+		totalSize += stSize;
+		filesFound ++;
+	}
+	return 1;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  S H O W  D I R                                                                                                    *
+ *  ==============                                                                                                    *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Called back by process dir to show the directory.
+ *  \param file Information about the file to show.
+ *  \result 1 if the file was shown.
+ */
+int showDir (DIR_ENTRY *file)
+{
+	long fileAge = 0, fileAgeMS = 0;
+#ifdef USE_STATX
+	mode_t stMode = file -> fileStat.stx_mode;
+	uid_t stUId = file -> fileStat.stx_uid;
+	gid_t stGId = file -> fileStat.stx_gid;
+	ino_t stINo = file -> fileStat.stx_ino;
+	nlink_t stNLink = file -> fileStat.stx_nlink;
+	off_t stSize = file -> fileStat.stx_size;
+#else
+	mode_t stMode = file -> fileStat.st_mode;
+	uid_t stUId = file -> fileStat.st_uid;
+	gid_t stGId = file -> fileStat.st_gid;
+	ino_t stINo = file -> fileStat.st_ino;
+	nlink_t stNLink = file -> fileStat.st_nlink;
+	off_t stSize = file -> fileStat.st_size;
+#endif
+	if (!dot[0])
+	{
+#ifdef RADIXCHAR
+		strncpy (dot, nl_langinfo(RADIXCHAR), 2);
+#else
+		strcpy (dot, ".");
+#endif
+	}
+
+	/*------------------------------------------------------------------------*
+	 * Skip the files that are filtered out, see filterDir.                   *
 	 *------------------------------------------------------------------------*/
-	if (dirType & HIDEVERCTL)
-	{
-		if (strcmp (file -> fileName, "CVS") == 0)
-			return 0;
-		if (strcmp (file -> fileName, ".git") == 0)
-			return 0;
-		if (strcmp (file -> fileName, ".svn") == 0)
-			return 0;
-	}
+	if (!filterDir (file))
+		return 0;
 
 	switch (showDate)
 	{
@@ -1632,17 +2022,6 @@ int showDir (DIR_ENTRY *file)
 #endif
 	}
 
-	/*------------------------------------------------------------------------*
-	 * Don't show files or directories that are outside time values.          *
-     *------------------------------------------------------------------------*/
-	if (showType & SHOW_IN_AGE)
-	{
-		if (maxFileAge != -1 && fileAge < maxFileAge)		/* Too old */
-			return 0;
-		if (minFileAge != -1 && fileAge > minFileAge)		/* Too young */
-			return 0;
-	}
-
 	/*------------------------------------------------------------------------*
      * Show the directory in wide format.                                     *
      *------------------------------------------------------------------------*/
@@ -2271,7 +2650,7 @@ void getFileVersion (DIR_ENTRY *fileOne)
 {
 	if (fileOne -> fileVer == NULL)
 	{
-		fileOne -> fileVer = (struct dirFileVerInfo *)malloc (sizeof (struct dirFileVerInfo));
+		fileOne -> fileVer = (struct dirFileVerInfo *)directoryAlloc (fileOne, sizeof (struct dirFileVerInfo));
 
 		if (fileOne -> fileVer != NULL)
 		{
@@ -2314,7 +2693,7 @@ void getFileVersion (DIR_ENTRY *fileOne)
 				}
 				lastChar = filePtr[j++];
 			}
-			fileOne -> fileVer -> fileStart = (char *)malloc (strlen (fileStart) + 1);
+			fileOne -> fileVer -> fileStart = (char *)directoryAlloc (fileOne, strlen (fileStart) + 1);
 			if (fileOne -> fileVer -> fileStart != NULL)
 			{
 				strcpy (fileOne -> fileVer -> fileStart, fileStart);
@@ -2535,6 +2914,346 @@ int compareFileVersion (DIR_ENTRY *fileOne, DIR_ENTRY *fileTwo, int useCase)
 	return retn;
 }
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  F I L E  T Y P E  O R D E R                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Get where the type of the file puts it in the list, directories, links, devices, sockets and pipes come
+ *  before the other files, as in fileCompare.
+ *  \param file File to get the type of.
+ *  \result 0 for a directory up to 6 for a file.
+ */
+int fileTypeOrder (DIR_ENTRY *file)
+{
+#ifdef USE_STATX
+	mode_t stMode = file -> fileStat.stx_mode;
+#else
+	mode_t stMode = file -> fileStat.st_mode;
+#endif
+
+	if (S_ISDIR (stMode))
+		return 0;
+	if (S_ISLNK (stMode))
+		return 1;
+	if (S_ISBLK (stMode))
+		return 2;
+	if (S_ISCHR (stMode))
+		return 3;
+	if (S_ISSOCK (stMode))
+		return 4;
+	if (S_ISFIFO (stMode))
+		return 5;
+	return 6;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  F I L E  S O R T  K E Y                                                                                           *
+ *  =======================                                                                                           *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Called back by sort dir to get a number that sorts the file as fileCompare would, before the names.
+ *  \param file File to get the number for.
+ *  \result The type of the file in the top bits, then the size, date, inode or links, reversed by -or.
+ */
+unsigned long long fileSortKey (DIR_ENTRY *file)
+{
+	unsigned long long sortKey = 0, keyMask = (1ULL << 61) - 1, keyType = fileTypeOrder (file), timeKey;
+	long long fileTime = 0;
+
+	/*------------------------------------------------------------------------*
+     * Numbers too big for the key are cut down, the names still sort them.   *
+     *------------------------------------------------------------------------*/
+	switch (orderType)
+	{
+	case ORDER_SIZE:
+#ifdef USE_STATX
+		sortKey = file -> fileStat.stx_size;
+#else
+		sortKey = file -> fileStat.st_size;
+#endif
+		if (sortKey > keyMask)
+			sortKey = keyMask;
+		break;
+
+	case ORDER_DATE:
+		switch (showDate)
+		{
+#ifdef USE_STATX
+		case DATE_MOD:
+			fileTime = file -> fileStat.stx_mtime.tv_sec;
+			break;
+		case DATE_ACC:
+			fileTime = file -> fileStat.stx_atime.tv_sec;
+			break;
+		case DATE_CHG:
+			fileTime = file -> fileStat.stx_ctime.tv_sec;
+			break;
+		case DATE_BTH:
+			fileTime = file -> fileStat.stx_btime.tv_sec;
+			break;
+#else
+		case DATE_MOD:
+			fileTime = file -> fileStat.st_mtim.tv_sec;
+			break;
+		case DATE_ACC:
+			fileTime = file -> fileStat.st_atim.tv_sec;
+			break;
+		case DATE_CHG:
+			fileTime = file -> fileStat.st_ctim.tv_sec;
+			break;
+#endif
+		}
+		fileTime += (1LL << 60);
+		timeKey = fileTime < 0 ? 0 : (unsigned long long)fileTime;
+		sortKey = keyMask - (timeKey > keyMask ? keyMask : timeKey);
+		break;
+
+	case ORDER_INOD:
+#ifdef USE_STATX
+		sortKey = ~(unsigned long long)file -> fileStat.stx_ino >> 3;
+#else
+		sortKey = ~(unsigned long long)file -> fileStat.st_ino >> 3;
+#endif
+		break;
+
+	case ORDER_LINK:
+#ifdef USE_STATX
+		sortKey = keyMask - file -> fileStat.stx_nlink;
+#else
+		sortKey = keyMask - file -> fileStat.st_nlink;
+#endif
+		break;
+	}
+	if (showType & SHOW_RORDER)
+	{
+		sortKey = keyMask - sortKey;
+	}
+	return (keyType << 61) | sortKey;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  K E Y  A D D  S T R I N G                                                                                         *
+ *  =========================                                                                                         *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Add a string to a sort key, with its end so a shorter string sorts first as it would with strcmp.
+ *  \param keyBuff Key being made.
+ *  \param keyLen Bytes already in the key, 0 if it has already run out of space.
+ *  \param buffSize Size of the key buffer.
+ *  \param addStr String to add.
+ *  \param useCase If not set the string is added in lower case to sort as strcasecmp would.
+ *  \result Bytes now in the key, 0 if the string did not fit.
+ */
+int keyAddString (unsigned char *keyBuff, int keyLen, int buffSize, char *addStr, int useCase)
+{
+	int i = 0;
+
+	if (keyLen == 0)
+		return 0;
+
+	do
+	{
+		if (keyLen >= buffSize)
+			return 0;
+
+		keyBuff[keyLen++] = (useCase ? (unsigned char)addStr[i] : tolower ((unsigned char)addStr[i]));
+	}
+	while (addStr[i++] != 0);
+
+	return keyLen;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  F I L E  S O R T  B Y T E S                                                                                       *
+ *  ===========================                                                                                       *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Called back by sort dir to make a key that sorts the file as fileCompare would when compared with memcmp.
+ *  \param file File to make the key for.
+ *  \param keyBuff Buffer to make the key in.
+ *  \param buffSize Size of the buffer.
+ *  \result Bytes in the key, 0 if it could not be made.
+ */
+int fileSortBytes (DIR_ENTRY *file, unsigned char *keyBuff, int buffSize)
+{
+	int keyLen = 0, useCase = dirType & USECASE, i;
+	char fileName[PATH_SIZE], nameString[81], *keyString;
+#ifdef USE_STATX
+	uid_t stUId = file -> fileStat.stx_uid;
+	gid_t stGId = file -> fileStat.stx_gid;
+#else
+	uid_t stUId = file -> fileStat.st_uid;
+	gid_t stGId = file -> fileStat.st_gid;
+#endif
+
+	if (buffSize < 2)
+		return 0;
+
+	keyBuff[keyLen++] = (unsigned char)fileTypeOrder (file);
+
+	switch (orderType)
+	{
+	case ORDER_EXTN:
+	case ORDER_WORD:
+		keyString = (orderType == ORDER_EXTN ? findExtn (file -> fileName) : findFileWord (file -> fileName));
+		keyBuff[keyLen++] = (keyString != NULL);
+		if (keyString != NULL)
+		{
+			keyLen = keyAddString (keyBuff, keyLen, buffSize, keyString, useCase);
+		}
+		break;
+
+	case ORDER_OWNR:
+		keyLen = keyAddString (keyBuff, keyLen, buffSize, displayOwnerString (stUId, nameString), 0);
+		break;
+
+	case ORDER_GRUP:
+		keyLen = keyAddString (keyBuff, keyLen, buffSize, displayGroupString (stGId, nameString), 0);
+		break;
+
+	case ORDER_CNXT:
+		strcpy (fileName, file -> fullPath);
+		strcat (fileName, file -> fileName);
+		keyLen = keyAddString (keyBuff, keyLen, buffSize, displayContextString (fileName, nameString), 0);
+		break;
+
+	case ORDER_NAVE:
+	case ORDER_VERS:
+		getFileVersion (file);
+		if (file -> fileVer == NULL || file -> fileVer -> fileStart == NULL)
+			return 0;
+
+		if (orderType == ORDER_NAVE)
+		{
+			keyLen = keyAddString (keyBuff, keyLen, buffSize, file -> fileVer -> fileStart, useCase);
+		}
+		/*--------------------------------------------------------------------*
+         * Each part of the version goes in high byte first with the sign bit *
+         * flipped so they compare as compareVersions does                    *
+         *--------------------------------------------------------------------*/
+
+		if (keyLen == 0 || keyLen + 80 > buffSize)
+			return 0;
+
+		for (i = 1; i < 21; ++i)
+		{
+			unsigned int verVal = (unsigned int)file -> fileVer -> verVals[i] ^ 0x80000000;
+
+			keyBuff[keyLen++] = (unsigned char)(verVal >> 24);
+			keyBuff[keyLen++] = (unsigned char)(verVal >> 16);
+			keyBuff[keyLen++] = (unsigned char)(verVal >> 8);
+			keyBuff[keyLen++] = (unsigned char)verVal;
+		}
+		if (orderType == ORDER_VERS)
+		{
+			keyLen = keyAddString (keyBuff, keyLen, buffSize, file -> fileVer -> fileStart, useCase);
+		}
+		keyLen = keyAddString (keyBuff, keyLen, buffSize, file -> fileName, useCase);
+		break;
+	}
+
+	/*------------------------------------------------------------------------*
+     * Files that are the same so far are sorted on the name that is shown    *
+     *------------------------------------------------------------------------*/
+
+	if (showType & SHOW_PATH)
+	{
+		strcpy (fileName, file -> fullPath);
+		strcat (fileName, file -> fileName);
+	}
+	else if (file -> partPath[0])
+	{
+		strcpy (fileName, file -> partPath);
+		strcat (fileName, file -> fileName);
+	}
+	else
+		strcpy (fileName, file -> fileName);
+
+	keyLen = keyAddString (keyBuff, keyLen, buffSize, fileName, useCase);
+
+	/*------------------------------------------------------------------------*
+     * The type order is not reversed, flipping the rest of the bits reverses *
+     * the order as the end of every string is kept                           *
+     *------------------------------------------------------------------------*/
+
+	if (keyLen > 0 && showType & SHOW_RORDER)
+	{
+		for (i = 1; i < keyLen; ++i)
+		{
+			keyBuff[i] = ~keyBuff[i];
+		}
+	}
+	return keyLen;
+}
+
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  S O R T  D I R                                                                                                    *
+ *  ==============                                                                                                    *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Sort the files, on a number or a key made once for each file where it can, using more threads when asked to.
+ *  \param fileList List of files to sort.
+ *  \result None.
+ */
+void sortDir (void **fileList)
+{
+	sortKeyFile *SortKey = NULL;
+	int threads = 1;
+
+	/*------------------------------------------------------------------------*
+     * Orders by a number are radix sorted and orders by a name use a key     *
+     * made before the sort, both can use threads. Sums are still worked out  *
+     * as the files are compared so those sort on one thread                  *
+     *------------------------------------------------------------------------*/
+	switch (orderType)
+	{
+	case ORDER_SIZE:
+		if (!(showType & SHOW_MATCH))
+		{
+			SortKey = fileSortKey;
+			threads = sortThreads;
+		}
+		break;
+
+	case ORDER_DATE:
+	case ORDER_INOD:
+	case ORDER_LINK:
+		SortKey = fileSortKey;
+		threads = sortThreads;
+		break;
+
+	case ORDER_NAME:
+	case ORDER_EXTN:
+	case ORDER_WORD:
+	case ORDER_OWNR:
+	case ORDER_GRUP:
+	case ORDER_CNXT:
+	case ORDER_VERS:
+	case ORDER_NAVE:
+		directorySortBytes (fileList, fileSortBytes, sortThreads);
+		return;
+
+	case ORDER_NONE:
+		if (showType & SHOW_RORDER)
+		{
+			queueReverse (*fileList);
+		}
+		return;
+	}
+	directorySortKey (fileList, SortKey, threads);
+}
+
 /**********************************************************************************************************************
  *                                                                                                                    *
  *  F I L E  C O M P A R E                                                                                            *
@@ -2550,7 +3269,6 @@ int compareFileVersion (DIR_ENTRY *fileOne, DIR_ENTRY *fileTwo, int useCase)
 int fileCompare (DIR_ENTRY *fileOne, DIR_ENTRY *fileTwo)
 {
 	int retn = 0;
-	char fullName[1024];
 #ifdef USE_STATX
 	mode_t stModeOne = fileOne -> fileStat.stx_mode;
 	mode_t stModeTwo = fileTwo -> fileStat.stx_mode;
@@ -2579,9 +3297,6 @@ int fileCompare (DIR_ENTRY *fileOne, DIR_ENTRY *fileTwo)
 	off_t stSizeTwo = fileTwo -> fileStat.st_size;
 #endif
 
-	if (orderType == ORDER_NONE)
-		return showType & SHOW_RORDER ? -1 : 1;
-
 	/*------------------------------------------------------------------------*
      * Force the directories to the begining of the list                      *
      *------------------------------------------------------------------------*/
@@ -2673,35 +3388,9 @@ int fileCompare (DIR_ENTRY *fileOne, DIR_ENTRY *fileTwo)
 		{
 			if (stSizeOne == stSizeTwo)
 			{
-				int i;
-
-				if (fileOne -> sha256Sum == NULL)
-				{
-					if ((fileOne -> sha256Sum = malloc (CRC_BUFF_SIZE)) != NULL)
-					{
-						strcpy (fullName, fileOne -> fullPath);
-						strcat (fullName, fileOne -> fileName);
-						SHA256File (fullName, fileOne -> sha256Sum);
-					}
-				}
-				if (fileTwo -> sha256Sum == NULL)
-				{
-					if ((fileTwo -> sha256Sum = malloc (CRC_BUFF_SIZE)) != NULL)
-					{
-						strcpy (fullName, fileTwo -> fullPath);
-						strcat (fullName, fileTwo -> fileName);
-						SHA256File (fullName, fileTwo -> sha256Sum);
-					}
-				}
-				for (i = 0; i < 32; ++i)
-				{
-					if (fileOne -> sha256Sum != NULL && fileTwo -> sha256Sum != NULL)
-					{
-						if (fileOne -> sha256Sum[i] != fileTwo -> sha256Sum[i])
-							break;
-					}
-				}
-				if (i == 32)
+				if (crcFileDigests (fileOne, fileDigests | CRC_DIGEST_SHA256) &&
+						crcFileDigests (fileTwo, fileDigests | CRC_DIGEST_SHA256) &&
+						memcmp (fileOne -> sha256Sum, fileTwo -> sha256Sum, 32) == 0)
 				{
 					fileOne -> match = 1;
 					fileTwo -> match = 1;
@@ -2827,24 +3516,8 @@ int fileCompare (DIR_ENTRY *fileOne, DIR_ENTRY *fileTwo)
 		break;
 
 	case ORDER_MD5S:
-		if (fileOne -> md5Sum == NULL)
-		{
-			if ((fileOne -> md5Sum = malloc (CRC_BUFF_SIZE)) != NULL)
-			{
-				strcpy (fullName, fileOne -> fullPath);
-				strcat (fullName, fileOne -> fileName);
-				MD5File (fullName, fileOne -> md5Sum);
-			}
-		}
-		if (fileTwo -> md5Sum == NULL)
-		{
-			if ((fileTwo -> md5Sum = malloc (CRC_BUFF_SIZE)) != NULL)
-			{
-				strcpy (fullName, fileTwo -> fullPath);
-				strcat (fullName, fileTwo -> fileName);
-				MD5File (fullName, fileTwo -> md5Sum);
-			}
-		}
+		crcFileDigests (fileOne, fileDigests);
+		crcFileDigests (fileTwo, fileDigests);
 		if (fileOne -> md5Sum != NULL && fileTwo -> md5Sum != NULL)
 		{
 			int i;
@@ -2857,24 +3530,8 @@ int fileCompare (DIR_ENTRY *fileOne, DIR_ENTRY *fileTwo)
 		break;
 
 	case ORDER_SHAS:
-		if (fileOne -> sha256Sum == NULL)
-		{
-			if ((fileOne -> sha256Sum = malloc (CRC_BUFF_SIZE)) != NULL)
-			{
-				strcpy (fullName, fileOne -> fullPath);
-				strcat (fullName, fileOne -> fileName);
-				SHA256File (fullName, fileOne -> sha256Sum);
-			}
-		}
-		if (fileTwo -> sha256Sum == NULL)
-		{
-			if ((fileTwo -> sha256Sum = malloc (CRC_BUFF_SIZE)) != NULL)
-			{
-				strcpy (fullName, fileTwo -> fullPath);
-				strcat (fullName, fileTwo -> fileName);
-				SHA256File (fullName, fileTwo -> sha256Sum);
-			}
-		}
+		crcFileDigests (fileOne, fileDigests);
+		crcFileDigests (fileTwo, fileDigests);
 		if (fileOne -> sha256Sum != NULL && fileTwo -> sha256Sum != NULL)
 		{
 			int i;
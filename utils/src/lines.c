@@ -54,6 +54,7 @@
  *----------------------------------------------------------------------------*/
 int showDir (DIR_ENTRY *file);
 int readDir (DIR_ENTRY *file);
+int streamDir (DIR_ENTRY *file);
 
 /*----------------------------------------------------------------------------*
  * Globals                                                                    *
@@ -75,6 +76,9 @@ COLUMN_DESC *ptrLinesColumn[3] =
 
 #define ORDER_NAMES		0
 #define ORDER_LINES		1
+#define ORDER_NONE		2
+
+#define STREAM_AHEAD	1024
 
 int showFlags = 0;
 int showOrder = ORDER_NAMES;
@@ -110,12 +114,17 @@ void version (void)
  */
 void helpThem(char *progName)
 {
-	printf ("Enter the command: %s [-Ccpr] <filename>\n", basename (progName));
+	printf ("Enter the command: %s [-CcGOpr] [-I rule] [-L depth] <filename>\n", basename (progName));
 	printf ("    -C . . . . . Display output in colour.\n");
 	printf ("    -c . . . . . Directory case sensitive.\n");
+	printf ("    -G . . . . . Skip names listed in .gitignore files.\n");
+	printf ("    -Irule . . . Skip names matching a .gitignore style rule.\n");
+	printf ("    -L#  . . . . Only search # levels of subdirectories.\n");
 	printf ("    -on  . . . . Order results by file name.\n");
 	printf ("    -ol  . . . . Order by number of lines.\n");
 	printf ("    -or  . . . . Reverse the current order.\n");
+	printf ("    -ou  . . . . Unordered, show files as they are found.\n");
+	printf ("    -O . . . . . Do not search other file systems.\n");
 	printf ("    -p . . . . . Show the path and filename.\n");
 	printf ("    -r . . . . . Search in subdirectories.\n");
 	printf ("    -R . . . . . Search links to directories.\n");
@@ -191,7 +200,7 @@ int main (int argc, char *argv[])
 
 	displayInit ();
 
-	while ((i = getopt(argc, argv, "Cco:prR?")) != -1)
+	while ((i = getopt(argc, argv, "CcGI:L:o:OprR?")) != -1)
 	{
 		switch (i)
 		{
@@ -203,6 +212,35 @@ int main (int argc, char *argv[])
 			dirType ^= USECASE;
 			break;
 
+		case 'G':
+			directorySetExcludeFile (".gitignore");
+			break;
+
+		case 'I':
+			directoryExcludeAdd (optarg);
+			break;
+
+		case 'L':
+		{
+			int depth = 0, k = 0;
+			while (optarg[k] >= '0' && optarg[k] <= '9')
+			{
+				depth = (depth * 10) + (optarg[k] - '0');
+				++k;
+			}
+			if (k == 0 || optarg[k] != 0)
+			{
+				helpThem (argv[0]);
+				exit (1);
+			}
+			directorySetMaxDepth (depth);
+			break;
+		}
+
+		case 'O':
+			dirType ^= SAMEDEVICE;
+			break;
+
 		case 'r':
 			dirType ^= RECUDIR;
 			break;
@@ -232,6 +270,10 @@ int main (int argc, char *argv[])
 				{
 					showFlags ^= SHOW_RORDER;
 				}
+				else if (optarg[i] == 'u')
+				{
+					showOrder = ORDER_NONE;
+				}
 				else
 				{
 					helpThem (argv[0]);
@@ -247,9 +289,30 @@ int main (int argc, char *argv[])
 		}
 	}
 
-	for (; optind < argc; ++optind)
+#ifdef USE_STATX
+	directorySetStatMask (STATX_TYPE | STATX_MODE);
+#endif
+	if (showOrder == ORDER_NONE)
+	{
+		/*--------------------------------------------------------------------*
+         * No order so count each file as it is found, nothing is kept.       *
+         *--------------------------------------------------------------------*/
+		if (!displayColumnInit (2, ptrLinesColumn, DISPLAY_HEADINGS | displayColour))
+		{
+			fprintf (stderr, "ERROR in: displayColumnInit\n");
+			return 1;
+		}
+		for (; optind < argc; ++optind)
+		{
+			found += directoryStream (argv[optind], dirType, streamDir, STREAM_AHEAD);
+		}
+	}
+	else
 	{
-		found += directoryLoad (argv[optind], dirType, directoryCompare, &fileList);
+		for (; optind < argc; ++optind)
+		{
+			found += directoryLoad (argv[optind], dirType, directoryCompare, &fileList);
+		}
 	}
 
 	/*------------------------------------------------------------------------*
@@ -259,14 +322,17 @@ int main (int argc, char *argv[])
 	{
 		char numBuff[15];
 
-		directoryRead (readDir, &fileList);
-		directorySort (&fileList);
-		if (!displayColumnInit (2, ptrLinesColumn, DISPLAY_HEADINGS | displayColour))
+		if (showOrder != ORDER_NONE)
 		{
-			fprintf (stderr, "ERROR in: displayColumnInit\n");
-			return 1;
+			directoryRead (readDir, &fileList);
+			directorySort (&fileList);
+			if (!displayColumnInit (2, ptrLinesColumn, DISPLAY_HEADINGS | displayColour))
+			{
+				fprintf (stderr, "ERROR in: displayColumnInit\n");
+				return 1;
+			}
+			directoryProcess (showDir, &fileList);
 		}
-		directoryProcess (showDir, &fileList);
 
 		displayDrawLine (0);
 		displayInColumn (0, displayCommaNumber (totalLines, numBuff));
@@ -281,6 +347,10 @@ int main (int argc, char *argv[])
 	}
 	else
 	{
+		if (showOrder == ORDER_NONE)
+		{
+			displayTidy ();
+		}
 		version ();
 		printf ("No files found\n");
 	}
@@ -363,3 +433,20 @@ int showDir (DIR_ENTRY *file)
 	return (linesFound ? 1 : 0);
 }
 
+/**********************************************************************************************************************
+ *                                                                                                                    *
+ *  S T R E A M  D I R                                                                                                *
+ *  ==================                                                                                                *
+ *                                                                                                                    *
+ **********************************************************************************************************************/
+/**
+ *  \brief Called back as each file is found when there is no order, count then show.
+ *  \param file File to count and show.
+ *  \result 1 if all OK.
+ */
+int streamDir (DIR_ENTRY *file)
+{
+	readDir (file);
+	return showDir (file);
+}
+
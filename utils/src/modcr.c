@@ -122,7 +122,6 @@ void helpThem (char *name)
  */
 int main (int argc, char *argv[])
 {
-	void *fileList = NULL;
 	int i, found = 0;
 	char fullVersion[81];
 
@@ -165,28 +164,24 @@ int main (int argc, char *argv[])
 			exit (1);
 	}
 
+#ifdef USE_STATX
+	directorySetStatMask (STATX_TYPE | STATX_MODE);
+#endif
+	if (!displayColumnInit (3, ptrChangeColumn, DISPLAY_HEADINGS))
+	{
+		fprintf (stderr, "ERROR in: displayColumnInit\n");
+		return 1;
+	}
 	for (; optind < argc; ++optind)
 	{
-		found += directoryLoad (argv[optind], ONLYFILES, NULL, &fileList);
+		found += directoryStream (argv[optind], ONLYFILES | STREAMWHOLE, showDir, 0);
 	}
 
-	/*------------------------------------------------------------------------*
-     * Now we can sort the directory.                                         *
-     *------------------------------------------------------------------------*/
-	directorySort (&fileList);
-
 	if (found)
 	{
 		char numBuff[15];
 		int col = changeMode - 1;
 
-		if (!displayColumnInit (3, ptrChangeColumn, DISPLAY_HEADINGS))
-		{
-			fprintf (stderr, "ERROR in: displayColumnInit\n");
-			return 1;
-		}
-		directoryProcess (showDir, &fileList);
-
 		displayDrawLine (0);
 		displayInColumn (col, displayCommaNumber (totalLines, numBuff));
 		displayInColumn (2, "CR's modified");
@@ -200,6 +195,7 @@ int main (int argc, char *argv[])
 	}
 	else
 	{
+		displayTidy ();
 		version ();
 		printf ("No files found\n");
 	}
@@ -157,6 +157,7 @@ int main (int argc, char *argv[])
 	static struct option long_options[] =
 	{
 		{ "all", no_argument, 0, 'a' },
+		{ "cache", required_argument, 0, 'K' },
 		{ "case", no_argument, 0, 'c' },
 		{ "colour", no_argument, 0, 'C' },
 		{ "full", no_argument, 0, 'f' },
@@ -196,7 +197,7 @@ int main (int argc, char *argv[])
 	     *--------------------------------------------------------------------*/
 		int option_index = 0;
 
-		c = getopt_long (argc, argv, "acCfo:qs:x?", long_options, &option_index);
+		c = getopt_long (argc, argv, "acCfK:o:qs:x?", long_options, &option_index);
 
 		/*--------------------------------------------------------------------*
 		 * Detect the end of the options.                                     *
@@ -269,6 +270,10 @@ int main (int argc, char *argv[])
 			}
 			break;
 
+		case 'K':
+			directoryCacheOpen (optarg);
+			break;
+
 		case 'q':
 			showType |= SHOW_QUIET;
 			break;
@@ -282,6 +287,7 @@ int main (int argc, char *argv[])
 			printf ("%s -[Options] [FileName] [FileName]...\n\n", basename (argv[0]));
 			printf ("Options: \n");
 			printf ("         --all  . . . . -a  . . . Include hidden files and directories\n");
+			printf ("         --cache file . -Kfile  . Keep directory listings in file, reuse if unchanged\n");
 			printf ("         --case . . . . -c  . . . Makes the directory case sensitive\n");
 			printf ("         --colour . . . -C  . . . Show in colour\n");
 			printf ("         --full . . . . -f  . . . Show full file details\n");
@@ -300,6 +306,25 @@ int main (int argc, char *argv[])
 		}
 	}
 
+	/*------------------------------------------------------------------------*
+	 * Only the common stat fields are ever shown, keep the entries small.    *
+	 *------------------------------------------------------------------------*/
+	dirType |= COMPACTSTAT;
+
+	/*------------------------------------------------------------------------*
+	 * Quiet mode with no ordering only needs the file type, skip the stats.  *
+	 *------------------------------------------------------------------------*/
+	if (showType & SHOW_QUIET && orderType == ORDER_NONE)
+	{
+		dirType |= SKIPSTAT;
+	}
+#ifdef USE_STATX
+	else if (!(showType & SHOW_FULL))
+	{
+		directorySetStatMask (STATX_TYPE | STATX_MODE | STATX_SIZE | (orderType == ORDER_DATE ? STATX_MTIME : 0));
+	}
+#endif
+
 	while (optind < argc)
 	{
 		int k = 0, j = 0;
@@ -331,6 +356,7 @@ int main (int argc, char *argv[])
 		}
 		++optind;
 	}
+	directoryCacheClose ();
 
 	if (found)
 	{